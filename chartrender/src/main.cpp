@@ -0,0 +1,401 @@
+/* -*- coding: utf-8-unix -*-
+ *
+ * File: chartrender/src/main.cpp
+ *
+ * Copyright (C) 2021 Jukka Sirkka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QOpenGLContext>
+#include <QOffscreenSurface>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLVertexArrayObject>
+#include <QOpenGLExtraFunctions>
+#include <QEventLoop>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QDir>
+#include <QTextStream>
+#include <QtPlugin>
+#include <limits>
+
+#include "chartmanager.h"
+#include "chartpainter.h"
+#include "orthocam.h"
+#include "geoprojection.h"
+#include "textmanager.h"
+#include "rastersymbolmanager.h"
+#include "vectorsymbolmanager.h"
+#include "s52presentation.h"
+#include "s57chart.h"
+#include "settings.h"
+#include "chartupdater.h"
+#include "chartdatabase.h"
+#include "platform.h"
+
+Q_IMPORT_PLUGIN(CM93ReaderFactory)
+Q_IMPORT_PLUGIN(S57ReaderFactory)
+Q_IMPORT_PLUGIN(OsencReaderFactory)
+Q_IMPORT_PLUGIN(OesencReaderFactory)
+
+namespace {
+
+struct Tile {
+  int row;
+  int col;
+  WGS84Point eye;
+};
+
+using TileVector = QVector<Tile>;
+
+struct Timing {
+  qint64 paintData = 0;
+  qint64 draw = 0;
+};
+
+enum class UpdateStatus {Ready, NoCharts, TimedOut};
+
+// ms to wait for chart updates and text
+const int updateTimeout = 60000;
+
+}
+
+static OrthoCam* CreateCamera(const QSize& size, const WGS84Point& eye, quint32 scale) {
+  const float wmm = size.width() / dots_per_mm_x();
+  const float hmm = size.height() / dots_per_mm_y();
+  auto cam = new OrthoCam(wmm, hmm, new SimpleMercator);
+  cam->reset(eye, Angle::fromDegrees(0.));
+  cam->setScale(scale);
+  return cam;
+}
+
+// Covers the box row by row from north to south. The tile height in
+// projected units grows with latitude, so each row is sized at its centre.
+static TileVector CreateTiles(const WGS84Point& sw, const WGS84Point& ne,
+                              const QSize& size, quint32 scale) {
+  SimpleMercator proj;
+  proj.setReference(sw);
+  const QPointF p0 = proj.fromWGS84(sw);
+  const QPointF p1 = proj.fromWGS84(ne);
+
+  auto tileHeight = [&proj, &size, scale] (const QPointF& p) {
+    QScopedPointer<OrthoCam> cam(CreateCamera(size, proj.toWGS84(p), scale));
+    return 2. / cam->projection()(1, 1);
+  };
+
+  TileVector tiles;
+  qreal top = p1.y();
+  for (int row = 0; top > p0.y(); row++) {
+    qreal h = tileHeight(QPointF(p0.x(), top));
+    h = tileHeight(QPointF(p0.x(), top - .5 * h));
+    const qreal w = h * size.width() / size.height();
+    const qreal y = top - .5 * h;
+    int col = 0;
+    for (qreal left = p0.x(); left < p1.x(); left += w, col++) {
+      tiles.append({row, col, proj.toWGS84(QPointF(left + .5 * w, y))});
+    }
+    top -= h;
+  }
+  return tiles;
+}
+
+// Requests paint data for the camera and waits until the chart manager is
+// done. The manager does not answer invalid viewports at all, hence the
+// timeout.
+static UpdateStatus UpdateCharts(const Camera* cam) {
+  auto mgr = ChartManager::instance();
+
+  QEventLoop loop;
+  bool done = false;
+  UpdateStatus status = UpdateStatus::Ready;
+
+  auto ready = [&loop, &done] () {
+    done = true;
+    loop.quit();
+  };
+  auto c1 = QObject::connect(mgr, &ChartManager::chartsUpdated, &loop, ready);
+  auto c2 = QObject::connect(mgr, &ChartManager::active, &loop, ready);
+  auto c3 = QObject::connect(mgr, &ChartManager::idle, &loop, [&ready, &status] () {
+    status = UpdateStatus::NoCharts;
+    ready();
+  });
+
+  QTimer timer;
+  timer.setSingleShot(true);
+  QObject::connect(&timer, &QTimer::timeout, &loop, [&loop, &status] () {
+    status = UpdateStatus::TimedOut;
+    loop.quit();
+  });
+
+  mgr->updateCharts(cam, ChartManager::Force);
+  if (!done) {
+    timer.start(updateTimeout);
+    loop.exec();
+  }
+
+  QObject::disconnect(c1);
+  QObject::disconnect(c2);
+  QObject::disconnect(c3);
+
+  return status;
+}
+
+// Text is shaped asynchronously: update the paint data until the text
+// manager has no strings in the works.
+static UpdateStatus UpdateChartsAndText(const Camera* cam) {
+  const int maxRounds = 5;
+  for (int i = 0; i < maxRounds; i++) {
+    const UpdateStatus status = UpdateCharts(cam);
+    if (status != UpdateStatus::Ready) return status;
+    if (!TextManager::instance()->busy()) break;
+
+    QEventLoop loop;
+    bool newStrings = false;
+    auto c = QObject::connect(TextManager::instance(), &TextManager::newStrings, &loop,
+                              [&loop, &newStrings] () {
+      newStrings = true;
+      loop.quit();
+    });
+    QTimer::singleShot(updateTimeout, &loop, &QEventLoop::quit);
+    loop.exec();
+    QObject::disconnect(c);
+    if (!newStrings) return UpdateStatus::TimedOut;
+  }
+  return UpdateStatus::Ready;
+}
+
+int main(int argc, char *argv[]) {
+
+  QSurfaceFormat format;
+  // llvmpipe provides 4.5, which is enough for the desktop shaders
+  format.setVersion(4, 5);
+  format.setProfile(QSurfaceFormat::CoreProfile);
+  format.setDepthBufferSize(24);
+  format.setStencilBufferSize(8);
+  QSurfaceFormat::setDefaultFormat(format);
+
+  QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
+  QGuiApplication app(argc, argv);
+  app.setOrganizationName("");
+  app.setOrganizationDomain("");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Renders charts offscreen into PNG tiles.");
+  parser.addHelpOption();
+
+  const QCommandLineOption chartSetOpt("chartset", "Chart set to render.", "name");
+  const QCommandLineOption boxOpt("box", "Box to render as south,west,north,east in degrees.",
+                                  "box");
+  const QCommandLineOption scaleOpt("scale", "Chart scale denominator.", "scale");
+  const QCommandLineOption colorOpt("color-table", "Colour table name.", "name");
+  const QCommandLineOption sizeOpt("tile-size", "Tile size in pixels (default 512).", "pixels", "512");
+  const QCommandLineOption outputOpt("output", "Output directory for the tiles.", "dir");
+  const QCommandLineOption repeatOpt("repeat",
+                                     "Update and draw each tile n times and report timings.",
+                                     "n", "0");
+
+  parser.addOptions({chartSetOpt, boxOpt, scaleOpt, colorOpt, sizeOpt, outputOpt, repeatOpt});
+  parser.process(app);
+
+  QTextStream out(stdout);
+  QTextStream err(stderr);
+
+  const QStringList box = parser.value(boxOpt).split(",");
+  if (box.size() != 4) {
+    err << "--box south,west,north,east is required\n";
+    return 1;
+  }
+  const WGS84Point sw = WGS84Point::fromLL(box[1].toDouble(), box[0].toDouble());
+  const WGS84Point ne = WGS84Point::fromLL(box[3].toDouble(), box[2].toDouble());
+  if (!sw.valid() || !ne.valid() || sw.lat() >= ne.lat()) {
+    err << "Invalid box " << parser.value(boxOpt) << "\n";
+    return 1;
+  }
+
+  const quint32 scale = parser.value(scaleOpt).toUInt();
+  const OrthoCam probe(1., 1., new SimpleMercator);
+  if (scale < probe.minScale() || scale > probe.maxScale()) {
+    err << "--scale must be between " << probe.minScale() << " and " << probe.maxScale() << "\n";
+    return 1;
+  }
+
+  const int px = parser.value(sizeOpt).toInt();
+  if (px <= 0) {
+    err << "Invalid tile size " << parser.value(sizeOpt) << "\n";
+    return 1;
+  }
+  const QSize tileSize(px, px);
+
+  const int repeat = parser.value(repeatOpt).toInt();
+  const QString outDir = parser.value(outputOpt);
+  if (outDir.isEmpty() && repeat <= 0) {
+    err << "Nothing to do: give --output and/or --repeat\n";
+    return 1;
+  }
+  if (!outDir.isEmpty() && !QDir().mkpath(outDir)) {
+    err << "Cannot create " << outDir << "\n";
+    return 1;
+  }
+
+  qRegisterMetaType<TextKey>();
+  qRegisterMetaType<GL::GlyphData>();
+  qRegisterMetaType<S57Chart*>();
+  qRegisterMetaType<WGS84Point>();
+  qRegisterMetaType<S57::InfoType>();
+  qRegisterMetaType<ChartData>();
+
+  S52::InitPresentation();
+  ChartDatabase::createTables();
+
+  if (parser.isSet(colorOpt)) {
+    const int index = Settings::instance()->colorTableNames().indexOf(parser.value(colorOpt));
+    if (index < 0) {
+      err << "Unknown colour table " << parser.value(colorOpt) << ", available: "
+          << Settings::instance()->colorTableNames().join(", ") << "\n";
+      return 1;
+    }
+    Settings::instance()->setColorTable(index);
+  }
+
+  QOpenGLContext ctx;
+  ctx.setFormat(QSurfaceFormat::defaultFormat());
+  if (!ctx.create()) {
+    err << "Cannot create an OpenGL context\n";
+    return 1;
+  }
+
+  QOffscreenSurface surface;
+  surface.setFormat(ctx.format());
+  surface.create();
+  ctx.makeCurrent(&surface);
+
+  QOpenGLVertexArrayObject vao;
+  vao.create();
+  vao.bind();
+
+  auto mgr = ChartManager::instance();
+  mgr->createThreads(&ctx);
+  TextManager::instance()->createTexture(512, 512);
+  RasterSymbolManager::instance()->createSymbols();
+  VectorSymbolManager::instance()->createSymbols();
+  RasterSymbolManager::instance()->changeSymbolAtlas();
+
+  const QString chartSet = parser.isSet(chartSetOpt) ? parser.value(chartSetOpt) : mgr->chartSet();
+  if (!mgr->chartSets().contains(chartSet)) {
+    err << "Unknown chart set " << chartSet << ", available: "
+        << mgr->chartSets().join(", ") << "\n";
+    return 1;
+  }
+  {
+    SimpleMercator proj;
+    mgr->setChartSet(chartSet, &proj);
+  }
+
+  ChartPainter painter(nullptr);
+  painter.initializeGL();
+
+  QOpenGLFramebufferObjectFormat fmt;
+  fmt.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+  QOpenGLFramebufferObject fbo(tileSize, fmt);
+
+  auto f = ctx.extraFunctions();
+
+  const TileVector tiles = CreateTiles(sw, ne, tileSize, scale);
+  out << "Rendering " << tiles.size() << " tiles of " << chartSet
+      << " at 1:" << scale << "\n";
+  out.flush();
+
+  QVector<Timing> timings;
+  for (const Tile& tile: tiles) {
+    QScopedPointer<OrthoCam> cam(CreateCamera(tileSize, tile.eye, scale));
+
+    const UpdateStatus status = UpdateChartsAndText(cam.data());
+    if (status == UpdateStatus::TimedOut) {
+      err << "Timed out updating tile " << tile.row << "," << tile.col << "\n";
+      return 1;
+    }
+    const bool hasCharts = status == UpdateStatus::Ready;
+
+    fbo.bind();
+    f->glClearStencil(0x00);
+    f->glClearDepthf(1.);
+    f->glClearColor(.4, .4, .4, 1.);
+    f->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+    if (hasCharts) {
+      painter.updateCharts(cam.data(), mgr->viewArea());
+      fbo.bind();
+      painter.paintGL(cam.data());
+    }
+
+    if (!outDir.isEmpty()) {
+      const QString path = QString("%1/%2_%3.png").arg(outDir).arg(tile.row).arg(tile.col);
+      if (!fbo.toImage().save(path)) {
+        err << "Cannot write " << path << "\n";
+        return 1;
+      }
+    }
+
+    if (!hasCharts) continue;
+
+    for (int i = 0; i < repeat; i++) {
+      Timing t;
+      QElapsedTimer timer;
+
+      timer.start();
+      if (UpdateCharts(cam.data()) == UpdateStatus::TimedOut) {
+        err << "Timed out updating tile " << tile.row << "," << tile.col << "\n";
+        return 1;
+      }
+      t.paintData = timer.nsecsElapsed();
+
+      painter.invalidate();
+      timer.restart();
+      painter.updateCharts(cam.data(), mgr->viewArea());
+      f->glFinish();
+      t.draw = timer.nsecsElapsed();
+
+      timings.append(t);
+    }
+  }
+
+  if (!timings.isEmpty()) {
+    auto report = [&out, &timings] (const QString& name, qint64 Timing::* field) {
+      qint64 total = 0;
+      qint64 low = std::numeric_limits<qint64>::max();
+      qint64 high = 0;
+      for (const Timing& t: timings) {
+        total += t.*field;
+        low = qMin(low, t.*field);
+        high = qMax(high, t.*field);
+      }
+      out << qSetFieldWidth(12) << name
+          << qSetFieldWidth(10) << total / timings.size() / 1.e6
+          << low / 1.e6 << high / 1.e6
+          << qSetFieldWidth(0) << "\n";
+    };
+    out << qSetFieldWidth(12) << "[ms]"
+        << qSetFieldWidth(10) << "mean" << "min" << "max"
+        << qSetFieldWidth(0) << "\n";
+    report("paint data", &Timing::paintData);
+    report("draw", &Timing::draw);
+  }
+
+  vao.release();
+  ctx.doneCurrent();
+
+  return 0;
+}
@@ -19,7 +19,8 @@
  */
 #include "cm93reader.h"
 #include <QFile>
-#include <QDataStream>
+#include <cstring>
+#include <algorithm>
 #include <functional>
 #include <QDate>
 #include "s52names.h"
@@ -121,7 +122,7 @@ CM93Reader::CM93Reader(const QString &name)
 {}
 
 //    CM93 Decode support table
-static quint8 Decode_Table[] = {
+static const quint8 Decode_Table[] = {
   0x61,0x5C,0x3F,0xAE,0x4C,0x4A,0x2F,0x1E,0x24,0x9E,0x1C,0xD6,0x80,0x0D,0x73,0x7E,
   0x37,0xEF,0x41,0xCB,0xED,0x93,0x57,0xF0,0xF6,0xAD,0xB8,0xBC,0x40,0xDD,0xCC,0x95,
   0x97,0x47,0xFC,0xAB,0xAA,0x99,0xF8,0x88,0xE4,0xB3,0x3E,0x84,0x21,0x98,0x83,0x20,
@@ -140,49 +141,88 @@ static quint8 Decode_Table[] = {
   0x2A,0x6F,0x29,0xF3,0xA4,0x51,0x26,0xB6,0xB0,0xC5,0x76,0xE8,0x4D,0x1A,0xE6,0x66
 };
 
-template<typename T> T read_and_decode(QDataStream& stream) {
+// Decodes n bytes in place, eight bytes at a time. The byte at shift 8k
+// is written back to the same shift, so the byte order does not matter.
+static void DecodeInPlace(char* data, qint64 n) {
+  const quint8* t = Decode_Table;
+  qint64 i = 0;
+  for (; i + 8 <= n; i += 8) {
+    quint64 w;
+    memcpy(&w, data + i, 8);
+    const quint64 d =
+        static_cast<quint64>(t[w & 0xff]) |
+        static_cast<quint64>(t[(w >> 8) & 0xff]) << 8 |
+        static_cast<quint64>(t[(w >> 16) & 0xff]) << 16 |
+        static_cast<quint64>(t[(w >> 24) & 0xff]) << 24 |
+        static_cast<quint64>(t[(w >> 32) & 0xff]) << 32 |
+        static_cast<quint64>(t[(w >> 40) & 0xff]) << 40 |
+        static_cast<quint64>(t[(w >> 48) & 0xff]) << 48 |
+        static_cast<quint64>(t[(w >> 56) & 0xff]) << 56;
+    memcpy(data + i, &d, 8);
+  }
+  for (; i < n; i++) {
+    data[i] = t[static_cast<quint8>(data[i])];
+  }
+}
 
-  if (stream.atEnd()) throw ChartFileError("At end of chart file, cannot read more data");
+namespace CM93 {
 
-  T t;
-  stream >> t;
+//
+// Reads a CM93 cell file in one go and decodes it in bulk. The
+// parser then reads little endian values from the decoded buffer.
+//
+class DecodedStream {
+public:
 
-  // decode inplace
-  quint8 *q = reinterpret_cast<quint8*>(&t);
+  // reads and decodes at most maxLen bytes, or the whole file
+  DecodedStream(const QString& path, qint64 maxLen = -1);
 
-  for (uint i = 0; i < sizeof(T); i++) {
-    quint8 a = *q;
-    *q = Decode_Table[a];
+  // size of the file
+  qint64 size() const {return m_size;}
 
-    q++;
+  template<typename T> T read() {
+    if (m_pos + static_cast<qint64>(sizeof(T)) > m_data.size()) {
+      throw ChartFileError("At end of chart file, cannot read more data");
+    }
+    T t;
+    memcpy(&t, m_data.constData() + m_pos, sizeof(T));
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    // qFromLittleEndian does not handle floating point types in older Qt
+    auto b = reinterpret_cast<uchar*>(&t);
+    std::reverse(b, b + sizeof(T));
+#endif
+    m_pos += sizeof(T);
+    return t;
   }
 
-  return t;
-}
-
-QByteArray read_and_decode_bytes(QDataStream& stream, int n) {
-
-  if (stream.atEnd()) throw ChartFileError("At end of chart file, cannot read more data");
+  void skip(qint64 n) {
+    m_pos += n;
+  }
 
-  QByteArray bytes;
-  bytes.resize(n);
-  stream.readRawData(bytes.data(), n);
+private:
 
+  QByteArray m_data;
+  qint64 m_size;
+  qint64 m_pos;
+};
 
-  for (int i = 0; i < bytes.size(); i++) {
-    quint8 a = bytes[i];
-    bytes[i] = Decode_Table[a];
+DecodedStream::DecodedStream(const QString& path, qint64 maxLen)
+  : m_size(0)
+  , m_pos(0)
+{
+  QFile file(path);
+  if (!file.open(QFile::ReadOnly)) {
+    throw ChartFileError(QString("Cannot open %1 for reading").arg(path));
   }
-
-  return bytes;
+  m_size = file.size();
+  m_data = maxLen < 0 ? file.readAll() : file.read(maxLen);
+  DecodeInPlace(m_data.data(), m_data.size());
 }
 
-namespace CM93 {
-
 class Attribute {
 public:
 
-  static Attribute* Decode(QDataStream& stream);
+  static Attribute* Decode(DecodedStream& stream);
 
   const QString& name() const {return m_name;}
   const QString& type() const {return m_type;}
@@ -192,7 +232,7 @@ public:
 
   virtual ~Attribute() = default;
 
-  virtual void decode(QDataStream& stream) = 0;
+  virtual void decode(DecodedStream& stream) = 0;
   virtual S57::Attribute attribute(S57::Attribute::Type t, bool* ok) const = 0;
 
   Attribute(quint8 index, const QString& name, const QString& type)
@@ -213,12 +253,12 @@ public:
   explicit StringAttribute(quint8 index)
     : Attribute(index, CM93::GetAttributeName(index), "String") {}
 
-  void decode(QDataStream& stream) override {
+  void decode(DecodedStream& stream) override {
     QByteArray bytes;
-    auto b = read_and_decode<quint8>(stream);
+    auto b = stream.read<quint8>();
     while (b != 0) {
       bytes.append(b);
-      b = read_and_decode<quint8>(stream);
+      b = stream.read<quint8>();
     }
     QString v = QString::fromUtf8(bytes);
     m_value = QVariant::fromValue(v);
@@ -251,8 +291,8 @@ public:
   explicit ByteAttribute(quint8 index)
     : Attribute(index, CM93::GetAttributeName(index), "Byte") {}
 
-  void decode(QDataStream& stream) override {
-    auto b = read_and_decode<quint8>(stream);
+  void decode(DecodedStream& stream) override {
+    auto b = stream.read<quint8>();
     m_value = QVariant::fromValue(b);
     m_bytes += 1;
   }
@@ -309,11 +349,11 @@ public:
   explicit ListAttribute(quint8 index)
     : Attribute(index, CM93::GetAttributeName(index), "List") {}
 
-  void decode(QDataStream& stream) override {
-    auto n_elems = read_and_decode<quint8>(stream);
+  void decode(DecodedStream& stream) override {
+    auto n_elems = stream.read<quint8>();
     QVariantList elems;
     for (int i = 0; i < n_elems; i++) {
-      auto v = read_and_decode<quint8>(stream);
+      auto v = stream.read<quint8>();
       elems << QVariant::fromValue(static_cast<int>(v));
     }
     m_value = QVariant::fromValue(elems);
@@ -336,8 +376,8 @@ public:
   explicit WordAttribute(quint8 index)
     : Attribute(index, CM93::GetAttributeName(index), "Word10") {}
 
-  void decode(QDataStream& stream) override {
-    auto v16 = read_and_decode<quint16>(stream);
+  void decode(DecodedStream& stream) override {
+    auto v16 = stream.read<quint16>();
     auto v = .1 * static_cast<double>(v16);
     m_value = QVariant::fromValue(v);
     m_bytes += 2;
@@ -359,8 +399,8 @@ public:
   explicit FloatAttribute(quint8 index)
     : Attribute(index, CM93::GetAttributeName(index), "Real") {}
 
-  void decode(QDataStream& stream) override {
-    auto v = read_and_decode<float>(stream);
+  void decode(DecodedStream& stream) override {
+    auto v = stream.read<float>();
     m_value = QVariant::fromValue(v);
     m_bytes += 4;
   }
@@ -390,8 +430,8 @@ public:
   explicit LongAttribute(quint8 index)
     : Attribute(index, CM93::GetAttributeName(index), "Int") {}
 
-  void decode(QDataStream& stream) override {
-    auto v = read_and_decode<int>(stream);
+  void decode(DecodedStream& stream) override {
+    auto v = stream.read<int>();
     m_value = QVariant::fromValue(v);
     m_bytes += 4;
   }
@@ -411,14 +451,14 @@ public:
   explicit TextAttribute(quint8 index)
     : Attribute(index, CM93::GetAttributeName(index), "Text") {}
 
-  void decode(QDataStream& stream) override {
-    stream.skipRawData(3);
+  void decode(DecodedStream& stream) override {
+    stream.skip(3);
 
     QByteArray bytes;
-    auto b = read_and_decode<quint8>(stream);
+    auto b = stream.read<quint8>();
     while (b != 0) {
       bytes.append(b);
-      b = read_and_decode<quint8>(stream);
+      b = stream.read<quint8>();
     }
     QString v = QString::fromUtf8(bytes);
     m_value = QVariant::fromValue(v);
@@ -437,8 +477,8 @@ public:
 };
 
 
-Attribute* Attribute::Decode(QDataStream &stream) {
-  auto index = read_and_decode<quint8>(stream);
+Attribute* Attribute::Decode(DecodedStream& stream) {
+  auto index = stream.read<quint8>();
   auto t = CM93::GetAttributeType(index);
   Attribute* a;
   switch (t) {
@@ -463,33 +503,29 @@ using Region = S57ChartOutline::Region;
 
 GeoProjection* CM93Reader::configuredProjection(const QString& path) const {
 
-  QFile file(path);
-  if (!file.open(QFile::ReadOnly)) {
-    throw ChartFileError(QString("Cannot open %1 for reading").arg(path));
-  }
-  QDataStream stream(&file);
-  stream.setByteOrder(QDataStream::LittleEndian);
+  // only the header is needed
+  CM93::DecodedStream stream(path, payload_offset);
 
   // length of prolog + header (10 + 128)
-  auto header_len = read_and_decode<quint16>(stream);
+  auto header_len = stream.read<quint16>();
   if (header_len != 138) {
     throw ChartFileError(QString("%1 is not a proper CM93 file").arg(path));
   }
-  auto geom_table_len = read_and_decode<qint32>(stream);
-  auto feature_table_len = read_and_decode<qint32>(stream);
-  if (header_len + geom_table_len + feature_table_len != file.size()) {
+  auto geom_table_len = stream.read<qint32>();
+  auto feature_table_len = stream.read<qint32>();
+  if (header_len + geom_table_len + feature_table_len != stream.size()) {
     throw ChartFileError(QString("%1 is not a proper CM93 file").arg(path));
   }
 
   // header 64/128 bytes
 
-  stream.skipRawData(32); // lng_min, lat_min, lng_max, lat_max
+  stream.skip(32); // lng_min, lat_min, lng_max, lat_max
 
-  auto e_min = read_and_decode<double>(stream);
-  auto n_min = read_and_decode<double>(stream);
+  auto e_min = stream.read<double>();
+  auto n_min = stream.read<double>();
 
-  auto e_max = read_and_decode<double>(stream);
-  auto n_max = read_and_decode<double>(stream);
+  auto e_max = stream.read<double>();
+  auto n_max = stream.read<double>();
 
   if (e_max < e_min) {
     e_max += 2 * M_PI * CM93Mercator::zC;
@@ -507,21 +543,16 @@ GeoProjection* CM93Reader::configuredProjection(const QString& path) const {
 
 S57ChartOutline CM93Reader::readOutline(const QString& path, const GeoProjection* gp) const {
 
-  QFile file(path);
-  if (!file.open(QFile::ReadOnly)) {
-    throw ChartFileError(QString("Cannot open %1 for reading").arg(path));
-  }
-  QDataStream stream(&file);
-  stream.setByteOrder(QDataStream::LittleEndian);
+  CM93::DecodedStream stream(path);
 
   // length of prolog + header (10 + 128)
-  auto header_len = read_and_decode<quint16>(stream);
+  auto header_len = stream.read<quint16>();
   if (header_len != 138) {
     throw ChartFileError(QString("%1 is not a proper CM93 file").arg(path));
   }
-  auto geom_table_len = read_and_decode<qint32>(stream);
-  auto feature_table_len = read_and_decode<qint32>(stream);
-  if (header_len + geom_table_len + feature_table_len != file.size()) {
+  auto geom_table_len = stream.read<qint32>();
+  auto feature_table_len = stream.read<qint32>();
+  if (header_len + geom_table_len + feature_table_len != stream.size()) {
     throw ChartFileError(QString("%1 is not a proper CM93 file").arg(path));
   }
 
@@ -532,41 +563,38 @@ S57ChartOutline CM93Reader::readOutline(const QString& path, const GeoProjection
 
   // header 128 bytes
 
-  auto lng_min = read_and_decode<double>(stream);
-  auto lat_min = read_and_decode<double>(stream);
+  auto lng_min = stream.read<double>();
+  auto lat_min = stream.read<double>();
   WGS84Point sw = WGS84Point::fromLL(lng_min, lat_min);
   // qCDebug(CENC) << "sw" << sw.print();
 
-  auto lng_max = read_and_decode<double>(stream);
-  auto lat_max = read_and_decode<double>(stream);
+  auto lng_max = stream.read<double>();
+  auto lat_max = stream.read<double>();
   WGS84Point ne = WGS84Point::fromLL(lng_max, lat_max);
   // qCDebug(CENC) << "ne" << ne.print();
 
-  stream.skipRawData(32); // emin, nmin, emax, nmax
+  stream.skip(32); // emin, nmin, emax, nmax
 
   // vector record table: n_vec_records * 2 + n_vec_record_points  * 4 =
   // byte size of vertex table
-  auto n_vec_records = read_and_decode<quint16>(stream);
-  auto n_vec_record_points = read_and_decode<quint32>(stream);
-
-  stream.skipRawData(24);
+  auto n_vec_records = stream.read<quint16>();
+  auto n_vec_record_points = stream.read<quint32>();
 
-  auto n_feat_records = read_and_decode<quint16>(stream);
+  stream.skip(24);
 
-  stream.skipRawData(32);
+  auto n_feat_records = stream.read<quint16>();
 
-  // from this point on there are only 32 bit floats
-  stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+  stream.skip(32);
 
   // vector record table
   int offset = 0;
   EdgeVector mesh;
   GL::VertexVector vertices;
   for (int i = 0; i < n_vec_records; i++) {
-    auto n_elems = read_and_decode<quint16>(stream);
+    auto n_elems = stream.read<quint16>();
     for (int v = 0; v < n_elems; v++) {
-      vertices << gp->scaling().width() * read_and_decode<quint16>(stream);
-      vertices << gp->scaling().height() * read_and_decode<quint16>(stream);
+      vertices << gp->scaling().width() * stream.read<quint16>();
+      vertices << gp->scaling().height() * stream.read<quint16>();
     }
     Edge e;
     e.count = n_elems;
@@ -575,7 +603,7 @@ S57ChartOutline CM93Reader::readOutline(const QString& path, const GeoProjection
     offset += n_elems;
   }
   // skip rest of the geometry table
-  stream.skipRawData(geom_table_len - n_vec_records * 2 - n_vec_record_points * 4);
+  stream.skip(geom_table_len - n_vec_records * 2 - n_vec_record_points * 4);
 
   // feature record table
   // records with class _m_sor have coverage and publish dates
@@ -584,26 +612,26 @@ S57ChartOutline CM93Reader::readOutline(const QString& path, const GeoProjection
 
   bool in_sor = false;
   for (int featureId = 0; featureId < n_feat_records; featureId++) {
-    auto classCode = read_and_decode<quint8>(stream);
+    auto classCode = stream.read<quint8>();
     // qCDebug(CENC) << "[class]" << CM93::GetClassInfo(classCode) << featureId << "/" << n_feat_records;
-    auto objCode = read_and_decode<quint8>(stream);
-    auto n_bytes = read_and_decode<quint16>(stream);
+    auto objCode = stream.read<quint8>();
+    auto n_bytes = stream.read<quint16>();
     if (classCode != m_m_sor) {
       if (in_sor) break;
       // qCDebug(CENC) << "skipping" << n_bytes - 4 << "bytes";
-      stream.skipRawData(n_bytes - 4);
+      stream.skip(n_bytes - 4);
       continue;
     }
     in_sor = true;
     auto geoType = as_enum<CM93::GeomType>(objCode & 0x0f, CM93::AllGeomTypes);
     const quint8 flags = (objCode & 0xf0) >> 4;
 
-    auto n_records = read_and_decode<quint16>(stream);
+    auto n_records = stream.read<quint16>();
     if (geoType == CM93::GeomType::Area ||
         geoType == CM93::GeomType::Line) {
       EdgeVector edges;
       for (int i = 0; i < n_records; i++) {
-        auto edgeHeader = read_and_decode<quint16>(stream);
+        auto edgeHeader = stream.read<quint16>();
         auto index = edgeHeader & IndexMask;
         auto edgeflags = edgeHeader >> IndexBits;
         Q_ASSERT(index < n_vec_records);
@@ -617,16 +645,16 @@ S57ChartOutline CM93Reader::readOutline(const QString& path, const GeoProjection
     }
 
     if (flags & RelatedBit1) {
-      auto n_elems = read_and_decode<quint8>(stream);
-      stream.skipRawData(n_elems * 2);
+      auto n_elems = stream.read<quint8>();
+      stream.skip(n_elems * 2);
     }
 
     if (flags & RelatedBit2) {
-      stream.skipRawData(2);
+      stream.skip(2);
     }
 
     if (flags & AttributeBit) {
-      auto n_elems = read_and_decode<quint8>(stream);
+      auto n_elems = stream.read<quint8>();
       // qCDebug(CENC) << "attributes" << n_elems;
       for (int i = 0; i < n_elems; i++) {
         auto a = QScopedPointer<const CM93::Attribute>(CM93::Attribute::Decode(stream));
@@ -677,94 +705,86 @@ void CM93Reader::readChart(GL::VertexVector& vertices,
                            S57::ObjectVector& objects,
                            const QString& path,
                            const GeoProjection* proj) const {
-  QFile file(path);
-  if (!file.open(QFile::ReadOnly)) {
-    throw ChartFileError(QString("Cannot open %1 for reading").arg(path));
-  }
-  QDataStream stream(&file);
-  stream.setByteOrder(QDataStream::LittleEndian);
+  CM93::DecodedStream stream(path);
 
   // length of prolog + header (10 + 128)
-  auto header_len = read_and_decode<quint16>(stream);
+  auto header_len = stream.read<quint16>();
   if (header_len != 138) {
     throw ChartFileError(QString("%1 is not a proper CM93 file").arg(path));
   }
 
-  auto geom_table_len = read_and_decode<qint32>(stream);
-  auto feature_table_len = read_and_decode<qint32>(stream);
-  if (header_len + geom_table_len + feature_table_len != file.size()) {
+  auto geom_table_len = stream.read<qint32>();
+  auto feature_table_len = stream.read<qint32>();
+  if (header_len + geom_table_len + feature_table_len != stream.size()) {
     throw ChartFileError(QString("%1 is not a proper CM93 file").arg(path));
   }
 
   // skip to size section
-  stream.skipRawData(size_section_offset - coord_section_offset);
+  stream.skip(size_section_offset - coord_section_offset);
 
   // vector record table: n_vec_records * 2
   // + n_vec_record_points  * 4 = byte size of vertex table
-  auto n_vec_records = read_and_decode<quint16>(stream);
+  auto n_vec_records = stream.read<quint16>();
 
-  // auto n_vec_record_points = read_and_decode<quint32>(stream);
-  // auto m_46 = read_and_decode<quint32>(stream);
+  // auto n_vec_record_points = stream.read<quint32>();
+  // auto m_46 = stream.read<quint32>();
   // qCDebug(CENC) << "m_46" << m_46;
-  // auto m_4a = read_and_decode<quint32>(stream);
+  // auto m_4a = stream.read<quint32>();
   // qCDebug(CENC) << "m_4a" << m_4a;
-  stream.skipRawData(12);
+  stream.skip(12);
 
   // 3d point table: n_p3d_records * 2
   // + n_p3d_record_points * 6 = byte size 3d points table
-  auto n_p3d_records = read_and_decode<quint16>(stream);
+  auto n_p3d_records = stream.read<quint16>();
 
-  // auto n_p3d_record_points = read_and_decode<quint32>(stream);
-  // auto m_54 = read_and_decode<quint32>(stream);
+  // auto n_p3d_record_points = stream.read<quint32>();
+  // auto m_54 = stream.read<quint32>();
   // qCDebug(CENC) << "m_54" << m_54;
-  stream.skipRawData(8);
+  stream.skip(8);
 
   // 2d point table: n_p2d_records * 4 = byte size of 2d point table
-  auto n_p2d_records = read_and_decode<quint16>(stream);
+  auto n_p2d_records = stream.read<quint16>();
 
-  // auto m_5a = read_and_decode<quint16>(stream);
+  // auto m_5a = stream.read<quint16>();
   // qCDebug(CENC) << "m_5a" << m_5a;
-  // auto m_5c = read_and_decode<quint16>(stream);
+  // auto m_5c = stream.read<quint16>();
   // qCDebug(CENC) << "m_5c" << m_5c;
-  stream.skipRawData(4);
+  stream.skip(4);
 
-  auto n_feat_records = read_and_decode<quint16>(stream);
+  auto n_feat_records = stream.read<quint16>();
   // qCDebug(CENC) << "Number of objects" << n_feat_records;
 
-  // auto m_60 = read_and_decode<quint32>(stream);
+  // auto m_60 = stream.read<quint32>();
   // qCDebug(CENC) << "m_60" << m_60;
-  // auto m_64 = read_and_decode<quint32>(stream);
+  // auto m_64 = stream.read<quint32>();
   // qCDebug(CENC) << "m_64" << m_64;
-  // auto m_68 = read_and_decode<quint16>(stream);
+  // auto m_68 = stream.read<quint16>();
   // qCDebug(CENC) << "m_68" << m_68;
-  // auto m_6a = read_and_decode<quint16>(stream);
+  // auto m_6a = stream.read<quint16>();
   // qCDebug(CENC) << "m_6a" << m_6a;
-  // auto m_6c = read_and_decode<quint16>(stream);
+  // auto m_6c = stream.read<quint16>();
   // qCDebug(CENC) << "m_6c" << m_6c;
-  // auto n_related = read_and_decode<quint32>(stream);
+  // auto n_related = stream.read<quint32>();
   // qCDebug(CENC) << "num related" << n_related;
-  // auto m_72 = read_and_decode<quint32>(stream);
+  // auto m_72 = stream.read<quint32>();
   // qCDebug(CENC) << "m_72" << m_72;
-  // auto m_76 = read_and_decode<quint16>(stream);
+  // auto m_76 = stream.read<quint16>();
   // qCDebug(CENC) << "m_76" << m_76;
-  // auto m_78 = read_and_decode<quint32>(stream);
+  // auto m_78 = stream.read<quint32>();
   // qCDebug(CENC) << "m_78" << m_78;
-  // auto m_7c = read_and_decode<quint32>(stream);
+  // auto m_7c = stream.read<quint32>();
   // qCDebug(CENC) << "m_7c" << m_7c;
-  stream.skipRawData(32);
-
-  // from this point on there are only 32 bit floats
-  stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+  stream.skip(32);
 
   // vector record table
   int offset = 0;
   EdgeVector mesh;
   // Apply scaling to avoid problems with non-uniform x/y scales
   for (int i = 0; i < n_vec_records; i++) {
-    auto n_elems = read_and_decode<quint16>(stream);
+    auto n_elems = stream.read<quint16>();
     for (int v = 0; v < n_elems; v++) {
-      vertices << proj->scaling().width() * read_and_decode<quint16>(stream);
-      vertices << proj->scaling().height() * read_and_decode<quint16>(stream);
+      vertices << proj->scaling().width() * stream.read<quint16>();
+      vertices << proj->scaling().height() * stream.read<quint16>();
     }
     Edge e;
     e.count = n_elems;
@@ -776,12 +796,12 @@ void CM93Reader::readChart(GL::VertexVector& vertices,
   // soundings table
   QVector<GL::VertexVector> soundings;
   for (int i = 0; i < n_p3d_records; i++) {
-    auto n_vertices = read_and_decode<quint16>(stream);
+    auto n_vertices = stream.read<quint16>();
     GL::VertexVector ss;
     for (int v = 0; v < n_vertices; v++) {
-      ss << proj->scaling().width() * read_and_decode<quint16>(stream);
-      ss << proj->scaling().height() * read_and_decode<quint16>(stream);
-      auto z = read_and_decode<quint16>(stream);
+      ss << proj->scaling().width() * stream.read<quint16>();
+      ss << proj->scaling().height() * stream.read<quint16>();
+      auto z = stream.read<quint16>();
       if (z >= 12000) {
         ss << static_cast<double>(z - 12000);
       } else {
@@ -794,8 +814,8 @@ void CM93Reader::readChart(GL::VertexVector& vertices,
   // point table
   QVector<QPointF> points;
   for (int i = 0; i < n_p2d_records; i++) {
-    auto x = proj->scaling().width() * read_and_decode<quint16>(stream);
-    auto y = proj->scaling().height() * read_and_decode<quint16>(stream);
+    auto x = proj->scaling().width() * stream.read<quint16>();
+    auto y = proj->scaling().height() * stream.read<quint16>();
     points.append(QPointF(x, y));
   }
 
@@ -803,12 +823,15 @@ void CM93Reader::readChart(GL::VertexVector& vertices,
   auto projSc = QScopedPointer<GeoProjection>(GeoProjection::CreateProjection(proj->className()));
   projSc->setReference(proj->reference());
   S57::ObjectBuilder helper;
+
+  AreaTriangulator triangulator;
+
   // feature record table
 
   for (int featureId = 0; featureId < n_feat_records; featureId++) {
-    auto classCode = read_and_decode<quint8>(stream);
-    auto geoHeader = read_and_decode<quint8>(stream);
-    auto n_bytes = read_and_decode<quint16>(stream) - 4;
+    auto classCode = stream.read<quint8>();
+    auto geoHeader = stream.read<quint8>();
+    auto n_bytes = stream.read<quint16>() - 4;
     quint32 featureCode;
     const QString className = CM93::GetClassName(classCode);
     if (m_subst.contains(className)) {
@@ -818,7 +841,7 @@ void CM93Reader::readChart(GL::VertexVector& vertices,
       featureCode = S52::FindCIndex(className, &ok);
       if (!ok) {
         qCWarning(CENC) << "Unknown class" << CM93::GetClassInfo(classCode) << classCode;
-        stream.skipRawData(n_bytes);
+        stream.skip(n_bytes);
         continue;
       }
     }
@@ -837,9 +860,9 @@ void CM93Reader::readChart(GL::VertexVector& vertices,
     switch (geoType) {
     case CM93::GeomType::Area: {
       EdgeVector edges;
-      auto n_elems = read_and_decode<quint16>(stream);
+      auto n_elems = stream.read<quint16>();
       for (int i = 0; i < n_elems; i++) {
-        auto edgeHeader = read_and_decode<quint16>(stream);
+        auto edgeHeader = stream.read<quint16>();
         auto index = edgeHeader & IndexMask;
         auto edgeflags = edgeHeader >> IndexBits;
         Q_ASSERT(index < n_vec_records);
@@ -852,28 +875,17 @@ void CM93Reader::readChart(GL::VertexVector& vertices,
       S57::ElementDataVector lines;
       createLineElements(lines, indices, vertices, edges, true);
 
-      S57::ElementDataVector triangles;
-      triangulate(triangles, indices, vertices, lines);
-
-      const QPointF center = computeAreaCenterAndBboxes(triangles, vertices, indices);
       const QRectF bbox = computeBBox(lines, vertices, indices);
-      helper.cm93SetGeometry(object,
-                             new S57::Geometry::Area(lines,
-                                                     center,
-                                                     triangles,
-                                                     0,
-                                                     true,
-                                                     projSc.data()),
-                             bbox);
+      triangulator.add(object, lines, bbox);
 
       n_bytes -= n_elems * 2 + 2;
       break;
     }
     case CM93::GeomType::Line: {
       EdgeVector edges;
-      auto n_elems = read_and_decode<quint16>(stream);
+      auto n_elems = stream.read<quint16>();
       for (int i = 0; i < n_elems; i++) {
-        auto edgeHeader = read_and_decode<quint16>(stream);
+        auto edgeHeader = stream.read<quint16>();
         auto index = edgeHeader & IndexMask;
         auto edgeflags = edgeHeader >> IndexBits;
         Q_ASSERT(index < n_vec_records);
@@ -893,7 +905,7 @@ void CM93Reader::readChart(GL::VertexVector& vertices,
       break;
     }
     case CM93::GeomType::Point: {
-      auto index = read_and_decode<quint16>(stream);
+      auto index = stream.read<quint16>();
       auto p0 = points[index];
       QRectF bbox(p0 - QPointF(10, 10), QSizeF(20, 20));
       helper.cm93SetGeometry(object, new S57::Geometry::Point(p0, projSc.data()), bbox);
@@ -901,7 +913,7 @@ void CM93Reader::readChart(GL::VertexVector& vertices,
       break;
     }
     case CM93::GeomType::Sounding: {
-      auto index = read_and_decode<quint16>(stream);
+      auto index = stream.read<quint16>();
       auto ps = soundings[index];
       auto bbox = computeSoundingsBBox(ps);
       helper.cm93SetGeometry(object, new S57::Geometry::Point(ps, projSc.data()), bbox);
@@ -913,18 +925,18 @@ void CM93Reader::readChart(GL::VertexVector& vertices,
     }
 
     if (geoFlags & RelatedBit1) {
-      auto n_elems = read_and_decode<quint8>(stream);
-      stream.skipRawData(n_elems * 2);
+      auto n_elems = stream.read<quint8>();
+      stream.skip(n_elems * 2);
       n_bytes -= n_elems * 2 + 1;
     }
 
     if (geoFlags & RelatedBit2) {
-      stream.skipRawData(2);
+      stream.skip(2);
       n_bytes -= 2;
     }
 
     if (geoFlags & AttributeBit) {
-      auto n_elems = read_and_decode<quint8>(stream);
+      auto n_elems = stream.read<quint8>();
       n_bytes -= 1;
       for (int j = 0; j < n_elems; j++) {
         auto a = QScopedPointer<const CM93::Attribute>(CM93::Attribute::Decode(stream));
@@ -958,6 +970,11 @@ void CM93Reader::readChart(GL::VertexVector& vertices,
     }
     Q_ASSERT(n_bytes == 0);
   }
+
+  triangulator.triangulate(indices, vertices, projSc.data(),
+                           [&helper] (S57::Object* obj, S57::Geometry::Base* g, const QRectF& bb) {
+    helper.cm93SetGeometry(obj, g, bb);
+  });
 }
 
 
@@ -21,18 +21,64 @@
 #include <QDebug>
 #include <QPluginLoader>
 #include "chartfilereader.h"
+#include "chartcover.h"
 #include <QLibraryInfo>
 #include <QDir>
 #include <QDirIterator>
+#include <QFileInfo>
 #include <QStandardPaths>
 #include <QScopedPointer>
+#include <QRunnable>
+#include <QCryptographicHash>
+#include <QDataStream>
 
+namespace {
+
+class OutlineTask: public QRunnable {
+public:
+
+  OutlineTask(const ChartFileReader* reader, const QString& path, S57ChartOutline* outline,
+              QString* error)
+    : QRunnable()
+    , m_reader(reader)
+    , m_path(path)
+    , m_outline(outline)
+    , m_error(error) {}
+
+  void run() override {
+    try {
+      auto gp = QScopedPointer<GeoProjection>(m_reader->configuredProjection(m_path));
+      *m_outline = m_reader->readOutline(m_path, gp.data());
+    } catch (ChartFileError& e) {
+      *m_error = e.msg();
+    }
+  }
+
+private:
+
+  const ChartFileReader* m_reader;
+  QString m_path;
+  S57ChartOutline* m_outline;
+  QString* m_error;
+};
+
+}
 
 Updater::Updater(QObject* parent)
   : QObject(parent)
   , m_db("updater")
 {
   loadPlugins();
+
+  m_watchTimer.setSingleShot(true);
+  m_watchTimer.setInterval(watchDelay);
+  connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, [this] () {
+    m_watchTimer.start();
+  });
+  connect(&m_watchTimer, &QTimer::timeout, this, [this] () {
+    qDebug() << "Chart folders changed, syncing";
+    sync(m_watchPaths);
+  });
 }
 
 QString Updater::ping() const {
@@ -45,22 +91,81 @@ Updater::~Updater() {
 }
 
 void Updater::fullSync(const QStringList& paths) {
-  ChartInfoMap current;
-  manageCharts(paths, &current);
-  updateCharts(current);
+  manageCharts(paths, true);
   emit status("Full sync ready");
   emit ready();
 }
 
 void Updater::sync(const QStringList& paths) {
-  manageCharts(paths, nullptr);
+  manageCharts(paths, false);
+  if (!m_watchPaths.isEmpty()) {
+    // pick up new subfolders
+    updateWatcher();
+  }
   emit status("Sync ready");
   emit ready();
 }
 
-void Updater::manageCharts(const QStringList& dirs, ChartInfoMap* charts) {
+void Updater::watch(const QStringList& paths) {
+  m_watchPaths = paths;
+  const auto dirs = m_watcher.directories();
+  if (!dirs.isEmpty()) {
+    m_watcher.removePaths(dirs);
+  }
+  updateWatcher();
+}
+
+void Updater::updateWatcher() {
+  // inotify watches are not recursive
+  QStringList dirs;
+  for (const auto& path: m_watchPaths) {
+    if (!QFileInfo(path).isDir()) continue;
+    dirs << path;
+    QDirIterator it(path,
+                    QDir::Dirs | QDir::NoDotAndDotDot | QDir::Readable,
+                    QDirIterator::FollowSymlinks | QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+      dirs << it.next();
+    }
+  }
+  for (const auto& dir: m_watcher.directories()) {
+    dirs.removeOne(dir);
+  }
+  if (!dirs.isEmpty()) {
+    m_watcher.addPaths(dirs);
+  }
+}
+
+void Updater::manageCharts(const QStringList& dirs, bool full) {
   // traverse paths -> candidates
   PathHash candidates;
+  m_stats.clear();
+
+  // S57 update files (.001, .002, ...) by directory and base name
+  using UpdateHash = QHash<QString, QFileInfoList>;
+  QHash<QString, UpdateHash> updateFiles;
+
+  // The stat of a chart covers its update files so that new, changed and
+  // removed updates mark the chart as modified, cf. CacheReader::SourceStamp.
+  auto fileStat = [&updateFiles] (const QFileInfo& info) {
+    const QString dirPath = info.absolutePath();
+    if (!updateFiles.contains(dirPath)) {
+      UpdateHash& updates = updateFiles[dirPath];
+      const QStringList filters {"*.[0-9][0-9][0-9]"};
+      const auto files = info.dir().entryInfoList(filters, QDir::Files, QDir::Name);
+      for (const QFileInfo& f: files) {
+        updates[f.completeBaseName()].append(f);
+      }
+    }
+    FileStat stat(info.size(), info.lastModified().toMSecsSinceEpoch());
+    for (const QFileInfo& f: updateFiles[dirPath].value(info.completeBaseName())) {
+      if (f.fileName() == info.fileName()) continue;
+      stat.size += f.size();
+      stat.mtime += f.lastModified().toMSecsSinceEpoch();
+    }
+    return stat;
+  };
+
   for (auto ft = m_factories.cbegin(); ft != m_factories.cend(); ++ft) {
     const ChartFileReaderFactory* ftor = ft.value();
     for (const auto dir: dirs) {
@@ -76,19 +181,27 @@ void Updater::manageCharts(const QStringList& dirs, ChartInfoMap* charts) {
       }
       auto reader = m_readers[ftor->name()];
       while (it.hasNext()) {
-        candidates[it.next()] = reader;
+        const auto path = it.next();
+        candidates[path] = reader;
+        m_stats[path] = fileStat(it.fileInfo());
       }
     }
   }
   IdSet unwanted;
-  // fetch current charts
-  QSqlQuery r = m_db.exec("select id, path from charts");
+  ChartInfoMap modified;
+  // fetch current charts & compare to the manifest
+  QSqlQuery r = m_db.exec("select c.id, c.path, m.size, m.mtime, m.outline "
+                          "from charts c "
+                          "left join manifest m on m.id = c.id");
   while (r.next()) {
     const quint32 id = r.value(0).toUInt();
     const auto path = r.value(1).toString();
     if (candidates.contains(path)) {
-      if (charts != nullptr) {
-        charts->insert(id, ChartInfo(path, candidates[path]));
+      const FileStat& stat = m_stats[path];
+      if (full || r.isNull(2) ||
+          r.value(2).toLongLong() != stat.size ||
+          r.value(3).toLongLong() != stat.mtime) {
+        modified.insert(id, ChartInfo(path, candidates[path], r.value(4).toByteArray()));
       }
       candidates.remove(path);
     } else {
@@ -101,47 +214,86 @@ void Updater::manageCharts(const QStringList& dirs, ChartInfoMap* charts) {
   insertCharts(candidates);
   // remove the remove set
   deleteCharts(unwanted);
+  // update modified charts
+  updateCharts(modified);
+  // approximate missing coverage regions
+  updateCovers();
   // delete empty chartsets & unused scales
   cleanupDB();
 }
 
 void Updater::updateCharts(const ChartInfoMap& charts) {
+
+  if (!m_db.transaction()) {
+    qWarning() << "Cannot create db transaction, not updating";
+    return;
+  }
+  prepareCovInserts();
+
+  const QVector<quint32> ids = charts.keys().toVector();
+  const ChartInfoVector infos = charts.values().toVector();
+
   int count = 0;
-  for (auto it = charts.cbegin(); it != charts.cend(); ++it) {
-    const ChartInfo& v = it.value();
-    try {
-      auto gp = QScopedPointer<GeoProjection>(v.reader->configuredProjection(v.path));
-      S57ChartOutline ch = v.reader->readOutline(v.path, gp.data());
-
-      QSqlQuery s = m_db.prepare("select published, modified "
-                                 "from charts where id = ?");
-      s.bindValue(0, it.key());
-      m_db.exec(s);
-
-      if (!s.first() || (ch.published().toJulianDay() == s.value(0).toInt() &&
-          ch.modified().toJulianDay() == s.value(1).toInt())) {
-        count += 1;
-        if (count % statusFrequency == 0) {
-          emit status(QString("Checked %1/%2 charts").arg(count).arg(charts.size()));
+  for (int first = 0; first < infos.size(); first += outlineBatch) {
+    const auto batch = infos.mid(first, outlineBatch);
+    const auto outlines = readOutlines(batch);
+    for (int i = 0; i < batch.size(); i++) {
+      const ChartInfo& v = batch[i];
+      const OutlineInfo& info = outlines[i];
+      const quint32 id = ids[first + i];
+      count += 1;
+
+      if (!info.error.isEmpty()) {
+        qWarning() << "Chart file error in" << v.path << ":" << info.error << ", skipping";
+      } else {
+        const S57ChartOutline& ch = info.outline;
+
+        const QByteArray hash = OutlineHash(ch);
+
+        if (!v.hash.isEmpty()) {
+          if (hash != v.hash) {
+            update(id, ch);
+          }
+        } else {
+          // not in manifest yet
+          QSqlQuery s = m_db.prepare("select published, modified "
+                                     "from charts where id = ?");
+          s.bindValue(0, id);
+          m_db.exec(s);
+
+          if (s.first() && (ch.published().toJulianDay() != s.value(0).toInt() ||
+                            ch.modified().toJulianDay() != s.value(1).toInt())) {
+            update(id, ch);
+          }
         }
-        continue;
+        updateManifest(id, v.path, hash);
       }
 
-      update(it.key(), ch);
-
-    } catch (ChartFileError& e) {
-      qWarning() << "Chart file error in" << v.path << ":" << e.msg() << ", skipping";
-    }
-    count += 1;
-    if (count % statusFrequency == 0) {
-      emit status(QString("Checked %1/%2 charts").arg(count).arg(charts.size()));
+      if (count % statusFrequency == 0) {
+        emit status(QString("Checked %1/%2 charts").arg(count).arg(charts.size()));
+      }
     }
   }
+
+  if (!m_db.commit()) {
+    qWarning() << "DB commit failed!";
+  }
   if (charts.size() % statusFrequency != 0) {
     emit status(QString("Checked %1/%1 charts").arg(charts.size()));
   }
 }
 
+Updater::OutlineVector Updater::readOutlines(const ChartInfoVector& charts) {
+  OutlineVector outlines(charts.size());
+  for (int i = 0; i < charts.size(); i++) {
+    auto task = new OutlineTask(charts[i].reader, charts[i].path,
+                                &outlines[i].outline, &outlines[i].error);
+    m_pool.start(task);
+  }
+  m_pool.waitForDone();
+  return outlines;
+}
+
 
 void Updater::loadPlugins() {
   const auto& staticFactories = QPluginLoader::staticInstances();
@@ -205,35 +357,44 @@ void Updater::insertCharts(const PathHash& paths) {
     return;
   }
 
-  int count = 0;
+  prepareCovInserts();
+
+  ChartInfoVector charts;
   for (auto it = paths.cbegin(); it != paths.cend(); ++it) {
-    const auto reader = it.value();
-    const auto path = it.key();
-    const auto name = reader->name();
-    try {
-      auto gp = QScopedPointer<GeoProjection>(reader->configuredProjection(path));
-      // qDebug() << "reading outline" << path;
-      S57ChartOutline ch = reader->readOutline(path, gp.data());
-      if (!scales.contains(name) || !scales[name].contains(ch.scale())) {
-        auto r4 = m_db.prepare("insert into scales "
-                               "(chartset_id, scale) "
-                               "values(?, ?)");
-        r4.bindValue(0, chartsets[name]);
-        r4.bindValue(1, ch.scale());
-        m_db.exec(r4);
-        scales[name][ch.scale()] = r4.lastInsertId().toUInt();
-      }
+    charts.append(ChartInfo(it.key(), it.value()));
+  }
 
-      insert(path, ch, scales[name][ch.scale()]);
+  int count = 0;
+  for (int first = 0; first < charts.size(); first += outlineBatch) {
+    const auto batch = charts.mid(first, outlineBatch);
+    const auto outlines = readOutlines(batch);
+    for (int i = 0; i < batch.size(); i++) {
+      const auto path = batch[i].path;
+      const auto name = batch[i].reader->name();
+      const OutlineInfo& info = outlines[i];
+      count += 1;
+
+      if (!info.error.isEmpty()) {
+        qWarning() << "Chart file error in" << path << ":" << info.error << ", skipping";
+      } else {
+        const S57ChartOutline& ch = info.outline;
+        if (!scales.contains(name) || !scales[name].contains(ch.scale())) {
+          auto r4 = m_db.prepare("insert into scales "
+                                 "(chartset_id, scale) "
+                                 "values(?, ?)");
+          r4.bindValue(0, chartsets[name]);
+          r4.bindValue(1, ch.scale());
+          m_db.exec(r4);
+          scales[name][ch.scale()] = r4.lastInsertId().toUInt();
+        }
 
-    } catch (ChartFileError& e) {
-      qWarning() << "Chart file error in" << path << ":" << e.msg() << ", skipping";
-    }
-    count += 1;
-    if (count % statusFrequency == 0) {
-      emit status(QString("Inserted %1/%2 charts").arg(count).arg(paths.size()));
-    }
+        insert(path, ch, scales[name][ch.scale()]);
+      }
 
+      if (count % statusFrequency == 0) {
+        emit status(QString("Inserted %1/%2 charts").arg(count).arg(paths.size()));
+      }
+    }
   }
   if (!m_db.commit()) {
     qWarning() << "DB commit failed!";
@@ -270,6 +431,7 @@ void Updater::deleteCharts(const IdSet& c_ids) {
   }
 
   deleteFrom("charts", c_ids);
+  deleteFrom("manifest", c_ids);
   deleteFrom("coverage", v_ids);
   deleteFrom("polygons", p_ids);
 }
@@ -335,8 +497,8 @@ void Updater::insert(const QString &path, const S57ChartOutline &ch, quint32 sca
   // insert into charts
   QSqlQuery t = m_db.prepare("insert into charts "
                              "(scale_id, swx, swy, nex, ney, "
-                             "published, modified, path) "
-                             "values(?, ?, ?, ?, ?, ?, ?, ?)");
+                             "published, modified, path, cover) "
+                             "values(?, ?, ?, ?, ?, ?, ?, ?, ?)");
   // scale_id (0)
   t.bindValue(0, scale_id);
   // sw, ne (1, 2, 3, 4)
@@ -350,48 +512,166 @@ void Updater::insert(const QString &path, const S57ChartOutline &ch, quint32 sca
   t.bindValue(5, ch.published().toJulianDay());
   t.bindValue(6, ch.modified().toJulianDay());
   t.bindValue(7, path);
+  // cover (8)
+  t.bindValue(8, ChartCover::Approximate(ch.coverage(), ch.nocoverage(), sw, ne));
 
   m_db.exec(t);
   uint chart_id = t.lastInsertId().toUInt();
 
+  updateManifest(chart_id, path, OutlineHash(ch));
+
   insertCov(chart_id, 1, ch.coverage());
   insertCov(chart_id, 2, ch.nocoverage());
 }
 
+void Updater::prepareCovInserts() {
+  m_coverageQuery = m_db.prepare("insert into coverage "
+                                 "(type_id, chart_id) "
+                                 "values(?, ?)");
+
+  m_polygonQuery = m_db.prepare("insert into polygons "
+                                "(cov_id, x, y) "
+                                "values(?, ?, ?)");
+
+  QString sql = "insert into polygons (cov_id, x, y) values ";
+  sql += QString("(?, ?, ?),").repeated(polygonBatch);
+  sql.chop(1);
+  m_polygonBatchQuery = m_db.prepare(sql);
+}
+
 void Updater::insertCov(quint32 chart_id, quint32 type_id,
                         const S57ChartOutline::Region &r) {
-  // insert into coverage
-  QVector<quint32> ids;
-  int cnt = r.size();
-  while (cnt > 0) {
-    QSqlQuery r = m_db.prepare("insert into coverage "
-                               "(type_id, chart_id) "
-                               "values(?, ?)");
-    r.bindValue(0, type_id);
-    r.bindValue(1, chart_id);
-    m_db.exec(r);
-    ids << r.lastInsertId().toUInt();
-    cnt--;
-  }
-  // insert into polygons
-  for (int k = 0; k < ids.size(); k++) {
-    for (const WGS84Point& p: r[k]) {
-      QSqlQuery r = m_db.prepare("insert into polygons "
-                                 "(cov_id, x, y) "
-                                 "values(?, ?, ?)");
-      r.bindValue(0, ids[k]);
-      r.bindValue(1, p.lng());
-      r.bindValue(2, p.lat());
-      m_db.exec(r);
+  for (const WGS84PointVector& ps: r) {
+    // insert into coverage
+    m_coverageQuery.bindValue(0, type_id);
+    m_coverageQuery.bindValue(1, chart_id);
+    m_db.exec(m_coverageQuery);
+    const quint32 cov_id = m_coverageQuery.lastInsertId().toUInt();
+
+    // insert into polygons
+    int k = 0;
+    for (; k + polygonBatch <= ps.size(); k += polygonBatch) {
+      for (int i = 0; i < polygonBatch; i++) {
+        m_polygonBatchQuery.bindValue(3 * i, cov_id);
+        m_polygonBatchQuery.bindValue(3 * i + 1, ps[k + i].lng());
+        m_polygonBatchQuery.bindValue(3 * i + 2, ps[k + i].lat());
+      }
+      m_db.exec(m_polygonBatchQuery);
+    }
+    for (; k < ps.size(); k++) {
+      m_polygonQuery.bindValue(0, cov_id);
+      m_polygonQuery.bindValue(1, ps[k].lng());
+      m_polygonQuery.bindValue(2, ps[k].lat());
+      m_db.exec(m_polygonQuery);
+    }
+  }
+}
+
+void Updater::updateCovers() {
+  IdSet ids;
+  QSqlQuery r0 = m_db.exec("select id from charts where cover is null");
+  while (r0.next()) ids << r0.value(0).toUInt();
+
+  if (ids.isEmpty()) return;
+
+  if (!m_db.transaction()) {
+    qWarning() << "Cannot create db transaction, not updating";
+    return;
+  }
+
+  for (auto id: ids) {
+    QSqlQuery r1 = m_db.prepare("select swx, swy, nex, ney "
+                                "from charts where id = ?");
+    r1.bindValue(0, id);
+    m_db.exec(r1);
+    if (!r1.first()) continue;
+    const auto sw = WGS84Point::fromLL(r1.value(0).toDouble(), r1.value(1).toDouble());
+    const auto ne = WGS84Point::fromLL(r1.value(2).toDouble(), r1.value(3).toDouble());
+
+    QSqlQuery r2 = m_db.prepare("select c.id, c.type_id, p.x, p.y "
+                                "from polygons p "
+                                "join coverage c on p.cov_id = c.id "
+                                "where c.chart_id = ? order by c.id, p.id");
+    r2.bindValue(0, id);
+    m_db.exec(r2);
+
+    S57ChartOutline::Region cov;
+    S57ChartOutline::Region nocov;
+    WGS84PointVector ps;
+    int prev = -1;
+    int type_id = -1;
+    auto flush = [&cov, &nocov, &ps, &type_id] () {
+      if (ps.isEmpty()) return;
+      if (type_id == 1) {
+        cov << ps;
+      } else if (type_id == 2) {
+        nocov << ps;
+      }
+      ps.clear();
+    };
+    while (r2.next()) {
+      const int cid = r2.value(0).toInt();
+      if (cid != prev) flush();
+      ps << WGS84Point::fromLL(r2.value(2).toDouble(), r2.value(3).toDouble());
+      prev = cid;
+      type_id = r2.value(1).toInt();
+    }
+    flush();
+
+    QSqlQuery t = m_db.prepare("update charts set cover=? where id=?");
+    t.bindValue(0, ChartCover::Approximate(cov, nocov, sw, ne));
+    t.bindValue(1, id);
+    m_db.exec(t);
+  }
+
+  if (!m_db.commit()) {
+    qWarning() << "DB commit failed!";
+  }
+  emit status(QString("Approximated %1 chart coverages").arg(ids.size()));
+}
+
+void Updater::updateManifest(quint32 id, const QString& path, const QByteArray& hash) {
+  if (!m_stats.contains(path)) return;
+
+  const FileStat& stat = m_stats[path];
+  QSqlQuery t = m_db.prepare("insert or replace into manifest "
+                             "(id, size, mtime, outline) "
+                             "values(?, ?, ?, ?)");
+  t.bindValue(0, id);
+  t.bindValue(1, stat.size);
+  t.bindValue(2, stat.mtime);
+  t.bindValue(3, hash);
+  m_db.exec(t);
+}
+
+QByteArray Updater::OutlineHash(const S57ChartOutline& ch) {
+  QByteArray bytes;
+  QDataStream stream(&bytes, QIODevice::WriteOnly);
+  stream.setByteOrder(QDataStream::LittleEndian);
+
+  stream << ch.scale()
+         << ch.extent().sw().lng() << ch.extent().sw().lat()
+         << ch.extent().ne().lng() << ch.extent().ne().lat()
+         << ch.published().toJulianDay() << ch.modified().toJulianDay();
+
+  for (const S57ChartOutline::Region* r: {&ch.coverage(), &ch.nocoverage()}) {
+    stream << r->size();
+    for (const WGS84PointVector& ps: *r) {
+      stream << ps.size();
+      for (const WGS84Point& p: ps) {
+        stream << p.lng() << p.lat();
+      }
     }
   }
+
+  return QCryptographicHash::hash(bytes, QCryptographicHash::Sha1);
 }
 
 void Updater::update(quint32 id, const S57ChartOutline &ch) {
   // update charts
   QSqlQuery t = m_db.prepare("update charts set "
                              "swx=?, swy=?, nex=?, ney=?, "
-                             "published=?, modified=? "
+                             "published=?, modified=?, cover=? "
                              "where id=?");
   // sw, ne (0, 1, 2, 3)
   t.bindValue(0, ch.extent().sw().lng());
@@ -401,8 +681,11 @@ void Updater::update(quint32 id, const S57ChartOutline &ch) {
   // published, modified, path (4, 5)
   t.bindValue(4, ch.published().toJulianDay());
   t.bindValue(5, ch.modified().toJulianDay());
-  // id (6)
-  t.bindValue(6, id);
+  // cover (6)
+  t.bindValue(6, ChartCover::Approximate(ch.coverage(), ch.nocoverage(),
+                                         ch.extent().sw(), ch.extent().ne()));
+  // id (7)
+  t.bindValue(7, id);
 
   m_db.exec(t);
 
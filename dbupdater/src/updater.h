@@ -23,6 +23,9 @@
 #include "chartdatabase.h"
 #include <QMap>
 #include <QHash>
+#include <QThreadPool>
+#include <QFileSystemWatcher>
+#include <QTimer>
 #include "s57chartoutline.h"
 
 class ChartFileReader;
@@ -41,6 +44,7 @@ public slots:
 
   void sync(const QStringList& paths);
   void fullSync(const QStringList& paths);
+  void watch(const QStringList& paths);
   QString ping() const;
 
 
@@ -53,6 +57,12 @@ signals:
 private:
 
   static const int statusFrequency = 100;
+  // number of outlines read in parallel before inserting them
+  static const int outlineBatch = 256;
+  // rows per polygon insert, sqlite allows at most 999 host parameters
+  static const int polygonBatch = 300;
+  // msecs to wait for changes in watched folders to settle
+  static const int watchDelay = 5000;
 
   using IdSet = QSet<quint32>;
 
@@ -64,21 +74,45 @@ private:
 
   struct ChartInfo {
     ChartInfo() = default;
-    ChartInfo(const QString& p, ChartFileReader* r)
+    ChartInfo(const QString& p, ChartFileReader* r,
+              const QByteArray& h = QByteArray())
       : path(p)
-      , reader(r) {}
+      , reader(r)
+      , hash(h) {}
     QString path;
     ChartFileReader* reader;
+    QByteArray hash; // outline hash in manifest
   };
 
+  struct FileStat {
+    FileStat() = default;
+    FileStat(qint64 s, qint64 t)
+      : size(s)
+      , mtime(t) {}
+    // summed over the chart file and its update files
+    qint64 size;
+    qint64 mtime; // msecs since epoch
+  };
+
+  using FileStatHash = QHash<QString, FileStat>;
+
   using ChartInfoMap = QMap<quint32, ChartInfo>;
   using ChartInfoVector = QVector<ChartInfo>;
   using PathHash = QHash<QString, ChartFileReader*>;
 
-  void manageCharts(const QStringList& paths, ChartInfoMap* charts);
+  struct OutlineInfo {
+    S57ChartOutline outline;
+    QString error; // empty if the outline is valid
+  };
+
+  using OutlineVector = QVector<OutlineInfo>;
+
+  void manageCharts(const QStringList& paths, bool full);
   void updateCharts(const ChartInfoMap& charts);
 
   void insertCharts(const PathHash& paths);
+  OutlineVector readOutlines(const ChartInfoVector& charts);
+  void prepareCovInserts();
   void checkChartsets();
   void loadPlugins();
   void deleteCharts(const IdSet& ids);
@@ -86,10 +120,26 @@ private:
   void insert(const QString& path, const S57ChartOutline& ch, quint32 scale_id);
   void update(quint32 id, const S57ChartOutline& ch);
   void insertCov(quint32 chart_id, quint32 type_id, const S57ChartOutline::Region& r);
+  void updateCovers();
+  void updateManifest(quint32 id, const QString& path, const QByteArray& hash);
+  void updateWatcher();
+  static QByteArray OutlineHash(const S57ChartOutline& ch);
   void cleanupDB();
 
   ChartDatabase m_db;
 
   ReaderMap m_readers;
   FactoryMap m_factories;
+
+  QThreadPool m_pool;
+  QSqlQuery m_coverageQuery;
+  QSqlQuery m_polygonQuery;
+  QSqlQuery m_polygonBatchQuery;
+
+  // size & mtime of the chart files seen by the latest sync
+  FileStatHash m_stats;
+
+  QFileSystemWatcher m_watcher;
+  QTimer m_watchTimer;
+  QStringList m_watchPaths;
 };
@@ -27,7 +27,6 @@
 #include <QDir>
 #include "types.h"
 #include <QApplication>
-#include <QCryptographicHash>
 #include <QProcess>
 
 extern "C" {
@@ -35,6 +34,7 @@ extern "C" {
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <poll.h>
 }
 
 OeDevice::OeDevice(const QString& path, ReadMode mode)
@@ -43,6 +43,7 @@ OeDevice::OeDevice(const QString& path, ReadMode mode)
   , m_path(path)
   , m_userKey()
   , m_clientEP(-1)
+  , m_eof(false)
 {
 
   if (m_path.size() > 255) {
@@ -74,28 +75,6 @@ OeDevice::OeDevice(const QString& path, ReadMode mode)
     throw ChartFileError(QString("User key %1 longer than 255 bytes").arg(m_userKey));
   }
 
-  // Create client endpoint
-  m_clientEPName = QString("%1/%2-%3-%4-%5")
-      .arg(QDir::tempPath())
-      .arg(QApplication::applicationName())
-      .arg(QApplication::applicationPid())
-      .arg(static_cast<uint>(m_mode))
-      .arg(QString(CacheId(m_path)));
-
-
-  if (m_clientEPName.size() > 255) {
-    throw ChartFileError(QString("Client endpoint name %1 longer than 255 bytes").arg(m_clientEPName));
-  }
-
-  QFileInfo tmp(m_clientEPName);
-  if (tmp.exists()) {
-    qCDebug(CENC) << "removing" << m_clientEPName;
-    QDir::temp().remove(m_clientEPName);
-  }
-  if (mkfifo(m_clientEPName.toUtf8().constData(), S_IRUSR | S_IWUSR) < 0) {
-    qCWarning(CENC) << strerror(errno);
-    throw ChartFileError(QString("Failed to create %1").arg(m_clientEPName));
-  }
 }
 
 OeDevice::~OeDevice() {
@@ -105,7 +84,7 @@ OeDevice::~OeDevice() {
 
 bool OeDevice::atEnd() const {
   // qCDebug(CENC) << "OeDevice::atEnd" << (m_clientEP < 0);
-  return m_clientEP < 0;
+  return m_clientEP < 0 || m_eof;
 }
 
 qint64 OeDevice::bytesAvailable() const {
@@ -115,14 +94,13 @@ qint64 OeDevice::bytesAvailable() const {
 
 void OeDevice::close() {
   qCDebug(CENC) << "OeDevice::close";
-  if (m_clientEP > 0) {
+  if (m_clientEP >= 0) {
     ::close(m_clientEP);
+    m_clientEP = -1;
   }
-  QFileInfo tmp(m_clientEPName);
-  if (tmp.exists()) {
-    qCDebug(CENC) << "removing" << m_clientEPName;
-    QDir::temp().remove(m_clientEPName);
-  }
+  // the server might still write to an endpoint that was not read to the end
+  releaseEndpoint(m_eof);
+  QIODevice::close();
 }
 
 bool OeDevice::isSequential() const {
@@ -140,74 +118,231 @@ bool OeDevice::open(OpenMode mode) {
     return false;
   }
 
+  quint32 generation;
+  {
+    QMutexLocker lock(&serverMutex);
+    generation = serverGeneration;
+  }
+
+  if (request()) {
+    return true;
+  }
+
+  // try once more with a fresh server
+  Restart(generation);
+
+  if (request()) {
+    return true;
+  }
+
+  QIODevice::close();
+  return false;
+}
+
+bool OeDevice::request() {
+
+  m_eof = false;
+
+  m_clientEPName = Pool().acquire();
+  if (m_clientEPName.isEmpty()) {
+    return false;
+  }
+
+  // opening the read end does not block, the server opens the write end
+  // when it starts to process the request
+  m_clientEP = ::open(m_clientEPName.toUtf8().constData(), O_RDONLY | O_NONBLOCK);
+  if (m_clientEP < 0) {
+    qCWarning(CENC) << strerror(errno);
+    releaseEndpoint(false);
+    return false;
+  }
+
+  FifoMessage msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.cmd = static_cast<char>(m_mode);
+  strncpy(msg.fifo_name, m_clientEPName.toUtf8().constData(), 255);
+  strncpy(msg.senc_name, m_path.toUtf8().constData(), 255);
+  strncpy(msg.senc_key, m_userKey.toUtf8().constData(), 255);
+
+  if (Send(msg) && waitForData(requestTimeout)) {
+    return true;
+  }
+
+  qCWarning(CENC) << "No response from" << serverName << "for" << m_path;
+  ::close(m_clientEP);
+  m_clientEP = -1;
+  releaseEndpoint(false);
+  return false;
+}
+
+void OeDevice::releaseEndpoint(bool reusable) {
+  if (m_clientEPName.isEmpty()) return;
+  Pool().release(m_clientEPName, reusable);
+  m_clientEPName.clear();
+}
+
+bool OeDevice::waitForData(int timeout) const {
+  pollfd fd;
+  fd.fd = m_clientEP;
+  fd.events = POLLIN;
+  int ret;
+  do {
+    ret = ::poll(&fd, 1, timeout);
+  } while (ret < 0 && errno == EINTR);
+  // POLLHUP is reported only after the server has opened and closed
+  // its end, and is handled as end of data by readData
+  return ret > 0;
+}
+
+bool OeDevice::Send(const FifoMessage& msg) {
   auto serverEP = ::open(serverEPName, O_WRONLY | O_NDELAY);
   if (serverEP < 0) {
     qCWarning(CENC) << strerror(errno);
     return false;
   }
+  const auto ret = ::write(serverEP, reinterpret_cast<const char*>(&msg), sizeof(msg));
+  ::close(serverEP);
+  return ret == static_cast<ssize_t>(sizeof(msg));
+}
 
+void OeDevice::Restart(quint32 generation) {
+  QMutexLocker lock(&serverMutex);
+  if (generation != serverGeneration) {
+    // restarted already by another request
+    return;
+  }
+  serverGeneration++;
 
+  qCDebug(CENC) << "restarting" << serverName;
   FifoMessage msg;
-  msg.cmd = static_cast<char>(m_mode);
-  strncpy(msg.fifo_name, m_clientEPName.toUtf8().constData(), 256);
-  strncpy(msg.senc_name, m_path.toUtf8().constData(), 256);
-  strncpy(msg.senc_key, m_userKey.toUtf8().constData(), 256);
+  memset(&msg, 0, sizeof(msg));
+  msg.cmd = CmdExit;
+  if (Send(msg)) {
+    // wait for the server to close its endpoint
+    int cnt = 50;
+    auto serverEP = ::open(serverEPName, O_WRONLY | O_NDELAY);
+    while (serverEP >= 0 && cnt > 0) {
+      ::close(serverEP);
+      usleep(20000);
+      serverEP = ::open(serverEPName, O_WRONLY | O_NDELAY);
+      cnt--;
+    }
+    if (serverEP >= 0) {
+      ::close(serverEP);
+      qCWarning(CENC) << serverName << "does not respond to exit command";
+    }
+  }
+  Kickoff();
+}
 
-  ::write(serverEP, reinterpret_cast<char*>(&msg), sizeof(msg));
+OeDevice::EndpointPool& OeDevice::Pool() {
+  static EndpointPool pool;
+  return pool;
+}
 
-  ::close(serverEP);
+OeDevice::EndpointPool::EndpointPool()
+  : m_available(maxEndpoints)
+  , m_serial(0)
+{}
 
-  m_clientEP = ::open(m_clientEPName.toUtf8().constData(), O_RDONLY);
-  if (m_clientEP < 0) {
+OeDevice::EndpointPool::~EndpointPool() {
+  for (const QString& name: m_created) {
+    QDir::temp().remove(name);
+  }
+}
+
+QString OeDevice::EndpointPool::acquire() {
+  if (!m_available.tryAcquire(1, requestTimeout)) {
+    qCWarning(CENC) << "No free client endpoints";
+    return QString();
+  }
+
+  QMutexLocker lock(&m_mutex);
+  if (!m_free.isEmpty()) {
+    return m_free.takeLast();
+  }
+
+  const QString name = QString("%1/%2-%3-oe%4")
+      .arg(QDir::tempPath())
+      .arg(QApplication::applicationName())
+      .arg(QApplication::applicationPid())
+      .arg(m_serial++);
+
+  if (name.size() > 255) {
+    qCWarning(CENC) << "Client endpoint name" << name << "longer than 255 bytes";
+    m_available.release();
+    return QString();
+  }
+
+  QFileInfo tmp(name);
+  if (tmp.exists()) {
+    qCDebug(CENC) << "removing" << name;
+    QDir::temp().remove(name);
+  }
+  if (mkfifo(name.toUtf8().constData(), S_IRUSR | S_IWUSR) < 0) {
     qCWarning(CENC) << strerror(errno);
-    return false;
+    m_available.release();
+    return QString();
   }
-  return true;
+  m_created.append(name);
+
+  return name;
+}
+
+void OeDevice::EndpointPool::release(const QString& name, bool reusable) {
+  {
+    QMutexLocker lock(&m_mutex);
+    if (reusable) {
+      m_free.append(name);
+    } else {
+      qCDebug(CENC) << "removing" << name;
+      QDir::temp().remove(name);
+      m_created.removeOne(name);
+    }
+  }
+  m_available.release();
 }
 
 #define READ_SIZE 64000LL
-#define MAX_TRIES 100
 
 qint64 OeDevice::readData(char* data, qint64 len) {
 
-  if (m_clientEP < 0) return -1;
+  if (m_clientEP < 0 || m_eof) return -1;
 
-  qint64 remains = len;
-  size_t bytesRead = 0;
-  int sleepCnt = MAX_TRIES;
+  qint64 bytesRead = 0;
 
-  do {
+  while (bytesRead < len) {
 
-    size_t bytesToRead = qMin(remains, READ_SIZE);
-    const int ret = ::read(m_clientEP, data + bytesRead, bytesToRead);
-    if (ret < 0) {
-      qCWarning(CENC) << strerror(errno);
-      return -1;
+    const qint64 bytesToRead = qMin(len - bytesRead, READ_SIZE);
+    const auto ret = ::read(m_clientEP, data + bytesRead, bytesToRead);
+    if (ret > 0) {
+      bytesRead += ret;
+      continue;
     }
 
-    // Server may not have opened the Write end of the FIFO yet
     if (ret == 0) {
-      usleep(1000);
-      sleepCnt--;
-      continue;
+      // server has closed its end
+      m_eof = true;
+      break;
     }
 
-    sleepCnt = MAX_TRIES;
-    remains -= ret;
-    bytesRead += ret;
+    if (errno != EAGAIN && errno != EINTR) {
+      qCWarning(CENC) << strerror(errno);
+      return -1;
+    }
 
-  } while (remains > 0 && sleepCnt > 0);
+    if (!waitForData(readTimeout)) {
+      qCWarning(CENC) << "Timeout reading" << m_path;
+      return -1;
+    }
+  }
 
+  if (bytesRead == 0 && m_eof) {
+    return -1;
+  }
   return bytesRead;
 }
 
-QByteArray OeDevice::CacheId(const QString& path) {
-  QCryptographicHash hash(QCryptographicHash::Sha1);
-  hash.addData(path.toUtf8());
-  // convert sha1 to base36 form and return first 8 bytes for use as string
-  return QByteArray::number(*reinterpret_cast<const quint64*>(hash.result().constData()), 36).left(8);
-}
-
 void OeDevice::Kickoff() {
   int cnt = 10;
   auto serverEP = ::open(serverEPName, O_WRONLY | O_NDELAY);
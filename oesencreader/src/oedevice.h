@@ -22,6 +22,9 @@
 #pragma once
 
 #include <QIODevice>
+#include <QMutex>
+#include <QSemaphore>
+#include <QStringList>
 
 class OeDevice: public QIODevice {
 
@@ -56,19 +59,63 @@ private:
     char senc_key[256];
   };
 
+  //
+  // Pool of client endpoints (FIFOs). The endpoints are reused across
+  // requests, and the pool size limits the number of requests the
+  // server processes concurrently.
+  //
+  class EndpointPool {
+  public:
+    EndpointPool();
+    ~EndpointPool();
+
+    // blocks until a free endpoint is available
+    QString acquire();
+    // reusable endpoints are returned to the pool, others are removed
+    void release(const QString& name, bool reusable);
+
+  private:
+
+    static const int maxEndpoints = 4;
+
+    QSemaphore m_available;
+    QMutex m_mutex;
+    QStringList m_free;
+    QStringList m_created;
+    quint32 m_serial;
+  };
+
+  static EndpointPool& Pool();
+
+  // sends a request to the server and opens the client endpoint for reading
+  bool request();
+  void releaseEndpoint(bool reusable);
+  // waits until the client endpoint is readable
+  bool waitForData(int timeout) const;
+
+  static bool Send(const FifoMessage& msg);
+  // stops a non-responding server and launches a new one
+  static void Restart(quint32 generation);
+
   static const qint8 CmdExit = 2;
   static const qint8 CmdTestAvail = 1;
 
+  // milliseconds
+  static const int requestTimeout = 10000;
+  static const int readTimeout = 5000;
+
   static inline const char serverEPName[] = "/tmp/OCPN_PIPE";
   static inline const char serverName[] = "/usr/bin/oeserverd";
 
-  static QByteArray CacheId(const QString& path);
+  static inline QMutex serverMutex;
+  static inline quint32 serverGeneration = 0;
 
   ReadMode m_mode;
   QString m_path;
   QString m_userKey;
   QString m_clientEPName;
   int m_clientEP;
+  bool m_eof;
 };
 
 
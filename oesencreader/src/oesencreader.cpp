@@ -20,6 +20,9 @@
 #include "oesencreader.h"
 #include "osenc.h"
 #include "oedevice.h"
+#include <QBuffer>
+#include <QFileInfo>
+#include <QDateTime>
 
 
 
@@ -30,15 +33,41 @@ const GeoProjection* OesencReader::geoprojection() const {
 OesencReader::OesencReader(const QString& name)
   : ChartFileReader(name)
   , m_proj(GeoProjection::CreateProjection("SimpleMercator"))
+  , m_headers(maxCachedHeaders)
 {}
 
-
-GeoProjection* OesencReader::configuredProjection(const QString &path) const {
+QByteArray OesencReader::header(const QString& path) const {
+  const QString key = QString("%1:%2")
+      .arg(path)
+      .arg(QFileInfo(path).lastModified().toMSecsSinceEpoch());
+  {
+    QMutexLocker lock(&m_headerMutex);
+    auto data = m_headers.object(key);
+    if (data != nullptr) {
+      return *data;
+    }
+  }
 
   OeDevice device(path, OeDevice::ReadHeader);
   if (!device.open(OeDevice::ReadOnly)) {
     throw ChartFileError(QString("Cannot open %1 for reading").arg(path));
   }
+  const QByteArray data = device.readAll();
+  if (!device.atEnd()) {
+    throw ChartFileError(QString("Error reading %1").arg(path));
+  }
+
+  QMutexLocker lock(&m_headerMutex);
+  m_headers.insert(key, new QByteArray(data));
+  return data;
+}
+
+
+GeoProjection* OesencReader::configuredProjection(const QString &path) const {
+
+  QByteArray data = header(path);
+  QBuffer device(&data);
+  device.open(QBuffer::ReadOnly);
 
   Osenc senc;
   return senc.configuredProjection(&device, m_proj->className());
@@ -46,10 +75,9 @@ GeoProjection* OesencReader::configuredProjection(const QString &path) const {
 
 S57ChartOutline OesencReader::readOutline(const QString &path, const GeoProjection *gp) const {
 
-  OeDevice device(path, OeDevice::ReadHeader);
-  if (!device.open(OeDevice::ReadOnly)) {
-    throw ChartFileError(QString("Cannot open %1 for reading").arg(path));
-  }
+  QByteArray data = header(path);
+  QBuffer device(&data);
+  device.open(QBuffer::ReadOnly);
 
   Osenc senc;
   return senc.readOutline(&device, gp);
@@ -63,7 +91,9 @@ void OesencReader::readChart(GL::VertexVector& vertices,
                             const QString& path,
                             const GeoProjection* gp) const {
   OeDevice device(path, OeDevice::ReadSENC);
-  device.open(OeDevice::ReadOnly);
+  if (!device.open(OeDevice::ReadOnly)) {
+    throw ChartFileError(QString("Cannot open %1 for reading").arg(path));
+  }
 
   Osenc senc;
   senc.readChart(vertices, indices, objects, &device, gp);
@@ -20,6 +20,8 @@
 #pragma once
 
 #include "chartfilereader.h"
+#include <QCache>
+#include <QMutex>
 
 class OesencReaderFactory;
 
@@ -45,7 +47,16 @@ private:
 
   OesencReader(const QString& name);
 
+  // The projection and the outline are read from the same header, fetch
+  // it from the server only once
+  QByteArray header(const QString& path) const;
+
+  using HeaderCache = QCache<QString, QByteArray>;
+  static const int maxCachedHeaders = 8;
+
   GeoProjection* m_proj;
+  mutable QMutex m_headerMutex;
+  mutable HeaderCache m_headers;
 
 };
 
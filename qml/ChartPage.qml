@@ -167,6 +167,14 @@ ChartPagePL {
       visible: !page.infoMode &&
                (tracker.status === Tracker.Tracking || tracker.status === Tracker.Displaying) &&
                !zoom.zooming
+
+      onBearingChanged: {
+        if (status === Tracker.Tracking) encdis.setCourse(bearing);
+      }
+
+      onStatusChanged: {
+        if (status !== Tracker.Tracking) encdis.clearCourse();
+      }
     }
 
     Router {
@@ -76,7 +76,7 @@ static bool inpolygon(const PointVector& ps, qreal x, qreal y) {
   return c;
 }
 
-KV::Region ChartCover::approximate(const PointVector& poly, const QRectF& box) const {
+QVector<bool> ChartCover::approximateGrid(const PointVector& poly, const QRectF& box) {
 
   const qreal dx = box.width() / (gridWidth - 1);
   const qreal dy = box.height() / (gridWidth - 1);
@@ -91,14 +91,33 @@ KV::Region ChartCover::approximate(const PointVector& poly, const QRectF& box) c
     }
   }
 
+  // cell (i, j) is covered if any of its corners is inside
+  QVector<bool> cells((gridWidth - 1) * (gridWidth - 1));
+  for (int i = 0; i < gridWidth - 1; i++) {
+    for (int j = 0; j < gridWidth - 1; j++) {
+      cells[i * (gridWidth - 1) + j] =
+          grid[i * gridWidth + j] || grid[(i + 1) * gridWidth + j] ||
+          grid[i * gridWidth + j + 1] || grid[(i + 1) * gridWidth + j + 1];
+    }
+  }
+
+  return cells;
+}
+
+KV::Region ChartCover::approximate(const PointVector& poly, const QRectF& box) const {
+
+  const qreal dx = box.width() / (gridWidth - 1);
+  const qreal dy = box.height() / (gridWidth - 1);
+
+  const auto cells = approximateGrid(poly, box);
+
   KV::Region reg;
 
   for (int i = 0; i < gridWidth - 1; i++) {
     const auto x = box.left() + i * dx;
     for (int j = 0; j < gridWidth - 1; j++) {
       const auto y = box.top() + j * dy;
-      if (grid[i * gridWidth + j] || grid[(i + 1) * gridWidth + j] ||
-          grid[i * gridWidth + j + 1] || grid[(i + 1) * gridWidth + j + 1]) {
+      if (cells[i * (gridWidth - 1) + j]) {
         reg += QRectF(x, y, dx, dy);
       }
     }
@@ -107,6 +126,100 @@ KV::Region ChartCover::approximate(const PointVector& poly, const QRectF& box) c
   return reg;
 }
 
+QByteArray ChartCover::Approximate(const LLPolygon& cov, const LLPolygon& nocov,
+                                   const WGS84Point& sw, const WGS84Point& ne) {
+
+  const int n = gridWidth - 1;
+
+  // longitudes relative to sw, accounting the antimeridian
+  auto toPoint = [sw] (const WGS84Point& v) {
+    const double lng = v.lng() < sw.lng() - 180. ? v.lng() + 360. : v.lng();
+    return QPointF(lng, v.lat());
+  };
+
+  const QPointF ll = toPoint(sw);
+  const QPointF ur(ne.lng(sw), ne.lat());
+
+  // offset bbox to account boundary not being part of polygon in inpolygon
+  const qreal eps = 1.e-5;
+  const QRectF bbox(ll + QPointF(eps, eps), ur - QPointF(eps, eps));
+
+  QVector<bool> cells(n * n, cov.isEmpty());
+
+  for (const WGS84PointVector& vs: cov) {
+    PointVector ps;
+    for (auto v: vs) {
+      ps << toPoint(v);
+    }
+    const auto covered = approximateGrid(ps, bbox);
+    for (int k = 0; k < n * n; k++) {
+      cells[k] = cells[k] || covered[k];
+    }
+  }
+
+  for (const WGS84PointVector& vs: nocov) {
+    PointVector ps;
+    for (auto v: vs) {
+      ps << toPoint(v);
+    }
+    const auto uncovered = approximateGrid(ps, bbox);
+    for (int k = 0; k < n * n; k++) {
+      cells[k] = cells[k] && !uncovered[k];
+    }
+  }
+
+  QByteArray bits(1 + (n * n + 7) / 8, '\0');
+  bits[0] = static_cast<char>(n);
+  for (int k = 0; k < n * n; k++) {
+    if (cells[k]) {
+      bits[1 + k / 8] = bits[1 + k / 8] | static_cast<char>(1 << (k % 8));
+    }
+  }
+
+  return bits;
+}
+
+bool ChartCover::IsValid(const QByteArray& cells) {
+  if (cells.isEmpty()) return false;
+  const int n = static_cast<uchar>(cells[0]);
+  return n > 0 && cells.size() == 1 + (n * n + 7) / 8;
+}
+
+ChartCover::ChartCover(const QByteArray& cells,
+                       const WGS84Point& sw, const WGS84Point& ne,
+                       const GeoProjection* proj)
+  : m_ref(proj->reference())
+  , m_cover() {
+
+  Q_ASSERT(IsValid(cells));
+
+  const int n = static_cast<uchar>(cells[0]);
+  const double dx = (ne.lng(sw) - sw.lng()) / n;
+  const double dy = (ne.lat() - sw.lat()) / n;
+
+  auto covered = [cells, n] (int i, int j) {
+    const int k = i * n + j;
+    return (static_cast<uchar>(cells[1 + k / 8]) & (1 << (k % 8))) != 0;
+  };
+
+  // merge cells to latitude runs for each longitude column
+  for (int i = 0; i < n; i++) {
+    const double x0 = sw.lng() + i * dx;
+    int j = 0;
+    while (j < n) {
+      if (!covered(i, j)) {
+        j++;
+        continue;
+      }
+      const int j0 = j;
+      while (j < n && covered(i, j)) j++;
+      const auto p0 = proj->fromWGS84(WGS84Point::fromLL(x0, sw.lat() + j0 * dy));
+      const auto p1 = proj->fromWGS84(WGS84Point::fromLL(x0 + dx, sw.lat() + j * dy));
+      m_cover += QRectF(p0, p1);
+    }
+  }
+}
+
 
 // Note: not 100% reliable, but good enough (should test x/y is constant alternatingly)
 bool ChartCover::isRectangle(const PointVector& poly) const {
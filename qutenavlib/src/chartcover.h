@@ -40,12 +40,26 @@ public:
              const WGS84Point& sw, const WGS84Point& ne,
              const GeoProjection* gp);
 
+  // from the output of Approximate
+  ChartCover(const QByteArray& cells,
+             const WGS84Point& sw, const WGS84Point& ne,
+             const GeoProjection* gp);
+
   KV::Region region(const GeoProjection* gp) const;
 
+  // Projection independent approximation of the coverage: a bitmap of
+  // covered grid cells in the longitude/latitude bounding box. The first
+  // byte is the number of cells per side.
+  static QByteArray Approximate(const LLPolygon& cov, const LLPolygon& nocov,
+                                const WGS84Point& sw, const WGS84Point& ne);
+
+  static bool IsValid(const QByteArray& cells);
+
 private:
 
   static const int gridWidth = 21;
 
+  static QVector<bool> approximateGrid(const PointVector& poly, const QRectF& box);
   KV::Region approximate(const PointVector& poly, const QRectF& box) const;
   bool isRectangle(const PointVector& poly) const;
 
@@ -40,7 +40,8 @@ ChartDatabase::ChartDatabase()
                "swy real not null, "
                "nex real not null, "
                "ney real not null, "
-               "path text not null unique)");
+               "path text not null unique, "
+               "cover blob)");
   checkError();
 
   m_Query.exec("create table if not exists m.coverage ("
@@ -93,7 +94,18 @@ void ChartDatabase::createTables() {
              "ney real not null, "
              "published int not null, " // Julian day
                "modified int not null, "  // Julian day
-               "path text not null unique)");
+               "path text not null unique, "
+               "cover blob)"); // ChartCover::Approximate
+
+    // add cover column to charts tables created by older versions
+    bool hasCover = false;
+    query.exec("pragma table_info(charts)");
+    while (query.next()) {
+      hasCover = hasCover || query.value(1).toString() == "cover";
+    }
+    if (!hasCover) {
+      query.exec("alter table charts add column cover blob");
+    }
 
     query.exec("create table if not exists coverage ("
              "id integer primary key autoincrement, "
@@ -106,6 +118,14 @@ void ChartDatabase::createTables() {
              "x real not null, "
              "y real not null)");
 
+    // chart file state at the latest sync
+    query.exec("create table if not exists manifest ("
+             "id integer primary key, " // charts.id
+             // summed over the chart file and its update files
+             "size integer not null, "
+             "mtime integer not null, " // msecs since epoch
+             "outline blob not null)"); // Updater::OutlineHash
+
     db.close();
   }
   QSqlDatabase::removeDatabase("ChartDatabase::createTables");
@@ -123,7 +143,7 @@ void ChartDatabase::loadCharts(int chartset_id) {
   checkError();
 
   m_Query.prepare("insert into m.charts select "
-                  "c.id, s.scale, c.swx, c.swy, c.nex, c.ney, c.path from "
+                  "c.id, s.scale, c.swx, c.swy, c.nex, c.ney, c.path, c.cover from "
                   "main.charts c "
                   "join main.scales s on c.scale_id = s.id "
                   "where s.chartset_id = ?");
@@ -138,7 +158,7 @@ void ChartDatabase::loadCharts(int chartset_id) {
                   "main.charts c "
                   "join main.scales s on c.scale_id = s.id "
                   "join main.coverage v on v.chart_id = c.id "
-                  "where s.chartset_id = ?");
+                  "where s.chartset_id = ? and c.cover is null");
   checkError();
 
   m_Query.bindValue(0, chartset_id);
@@ -151,10 +171,57 @@ void ChartDatabase::loadCharts(int chartset_id) {
                   "join main.scales s on c.scale_id = s.id "
                   "join main.coverage v on v.chart_id = c.id "
                   "join main.polygons p on p.cov_id = v.id "
-                  "where s.chartset_id = ?");
+                  "where s.chartset_id = ? and c.cover is null");
   checkError();
 
   m_Query.bindValue(0, chartset_id);
   m_Query.exec();
   checkError();
+
+  createIndex();
+}
+
+void ChartDatabase::createIndex() {
+  m_index.clear();
+
+  m_Query = QSqlQuery(m_DB);
+  m_Query.exec("select chart_id, scale, swx, swy, nex, ney "
+               "from m.charts order by rowid");
+  checkError();
+
+  while (m_Query.next()) {
+    const quint32 scale = m_Query.value(1).toUInt();
+    m_index[scale].charts.append(ChartBox(m_Query.value(0).toUInt(),
+                                          scale,
+                                          m_Query.value(2).toDouble(),
+                                          m_Query.value(3).toDouble(),
+                                          m_Query.value(4).toDouble(),
+                                          m_Query.value(5).toDouble()));
+  }
+
+  for (ScaleIndex& index: m_index) {
+    KV::RTree::RectVector boxes;
+    for (const ChartBox& c: index.charts) {
+      boxes.append(QRectF(QPointF(c.swx, c.swy), QPointF(c.nex, c.ney)));
+    }
+    index.tree.build(boxes);
+  }
+}
+
+ChartDatabase::ChartBoxVector ChartDatabase::selectCharts(const ScaleVector& scales,
+                                                          double swx, double swy,
+                                                          double nex, double ney) const {
+  const QRectF box(QPointF(swx, swy), QPointF(nex, ney));
+
+  ChartBoxVector charts;
+  for (auto scale: scales) {
+    auto it = m_index.constFind(scale);
+    if (it == m_index.cend()) continue;
+    const ScaleIndex& index = it.value();
+    const auto ids = index.tree.intersecting(box);
+    for (auto id: ids) {
+      charts.append(index.charts[id]);
+    }
+  }
+  return charts;
 }
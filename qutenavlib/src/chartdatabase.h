@@ -21,18 +21,59 @@
 #pragma once
 
 #include "sqlitedatabase.h"
+#include "rtree.h"
+#include <QMap>
 
 
 class ChartDatabase: public SQLiteDatabase {
 public:
 
+  struct ChartBox {
+    ChartBox() = default;
+    ChartBox(quint32 i, quint32 s, double x0, double y0, double x1, double y1)
+      : id(i)
+      , scale(s)
+      , swx(x0)
+      , swy(y0)
+      , nex(x1)
+      , ney(y1) {}
+    quint32 id;
+    quint32 scale;
+    double swx;
+    double swy;
+    double nex;
+    double ney;
+  };
+
+  using ChartBoxVector = QVector<ChartBox>;
+  using ScaleVector = QVector<quint32>;
+
   ChartDatabase();
   ChartDatabase(const QString& connName);
   ~ChartDatabase() = default;
 
   void loadCharts(int chartset);
 
+  // Charts of the loaded chartset intersecting the box, ordered by the
+  // given scales.
+  ChartBoxVector selectCharts(const ScaleVector& scales,
+                              double swx, double swy,
+                              double nex, double ney) const;
+
   static void createTables();
 
+private:
+
+  struct ScaleIndex {
+    KV::RTree tree;
+    ChartBoxVector charts;
+  };
+
+  using ScaleIndexMap = QMap<quint32, ScaleIndex>;
+
+  void createIndex();
+
+  ScaleIndexMap m_index;
+
 };
 
@@ -20,6 +20,9 @@
 #include "chartfilereader.h"
 #include "triangulator.h"
 #include "logging.h"
+#include <QThreadPool>
+#include <QSemaphore>
+#include <functional>
 
 
 ChartFileReader* ChartFileReaderFactory::loadReader(const QStringList& paths) const {
@@ -174,13 +177,12 @@ QPointF ChartFileReader::computeAreaCenterAndBboxes(S57::ElementDataVector &elem
 
 
 
-void ChartFileReader::triangulate(S57::ElementDataVector &elems,
-                                  GL::IndexVector &indices,
-                                  const GL::VertexVector &vertices,
+bool ChartFileReader::Triangulate(GL::IndexVector& triangles,
+                                  const GL::IndexVector& indices,
+                                  const GL::VertexVector& vertices,
                                   const S57::ElementDataVector& edges) {
 
-
-  if (edges.isEmpty()) return;
+  if (edges.isEmpty()) return false;
 
   Triangulator tri(vertices, indices);
   int first = edges.first().offset / sizeof(GLuint) + 1;
@@ -188,7 +190,7 @@ void ChartFileReader::triangulate(S57::ElementDataVector &elems,
   // skip open ended linestrings
   if (indices[first] != indices[first + count]) {
     qCWarning(CENC) << "Cannot triangulate";
-    return;
+    return false;
   }
   tri.addPolygon(first, count);
 
@@ -203,15 +205,98 @@ void ChartFileReader::triangulate(S57::ElementDataVector &elems,
     tri.addHole(first, count);
   }
 
-  auto triangles = tri.triangulate();
+  triangles = tri.triangulate();
+  return true;
+}
+
+void ChartFileReader::AreaTriangulator::add(S57::Object* obj,
+                                            const S57::ElementDataVector& lines,
+                                            const QRectF& bbox) {
+  m_areas.append(PendingArea {obj, lines, bbox});
+}
+
+namespace {
+
+class TriangulateTask: public QRunnable {
+public:
 
-  S57::ElementData e;
-  e.mode = GL_TRIANGLES;
-  e.count = triangles.size();
-  e.offset = indices.size() * sizeof(GLuint);
-  elems.append(e);
+  TriangulateTask(const std::function<void ()>& work, QSemaphore* done)
+    : QRunnable()
+    , m_work(work)
+    , m_done(done) {}
 
-  indices.append(triangles);
+  void run() override {
+    m_work();
+    m_done->release();
+  }
+
+private:
+
+  std::function<void ()> m_work;
+  QSemaphore* m_done;
+};
+
+}
+
+void ChartFileReader::AreaTriangulator::triangulate(GL::IndexVector& indices,
+                                                    const GL::VertexVector& vertices,
+                                                    const GeoProjection* proj,
+                                                    const GeometrySetter& setGeometry) {
+  const int n = m_areas.size();
+  if (n == 0) return;
+
+  QVector<GL::IndexVector> results(n);
+  QVector<char> valid(n);
+
+  // detach before sharing between threads
+  GL::IndexVector* out = results.data();
+  char* ok = valid.data();
+  const PendingArea* areas = m_areas.constData();
+
+  QAtomicInt next(0);
+  auto work = [out, ok, areas, n, &next, &indices, &vertices] () {
+    int i;
+    while ((i = next.fetchAndAddRelaxed(1)) < n) {
+      ok[i] = Triangulate(out[i], indices, vertices, areas[i].lines);
+    }
+  };
+
+  // Use the idle threads of the global pool, if any. The calling thread
+  // works too, so the areas get triangulated even if the pool is busy.
+  auto pool = QThreadPool::globalInstance();
+  const int maxHelpers = qMin(pool->maxThreadCount(), n / minAreas);
+  QSemaphore done;
+  int helpers = 0;
+  while (helpers < maxHelpers) {
+    auto task = new TriangulateTask(work, &done);
+    if (!pool->tryStart(task)) {
+      delete task;
+      break;
+    }
+    helpers++;
+  }
+
+  work();
+  done.acquire(helpers);
+
+  // merge & finish the areas
+  for (int i = 0; i < n; i++) {
+    S57::ElementDataVector triangles;
+    if (ok[i]) {
+      S57::ElementData e;
+      e.mode = GL_TRIANGLES;
+      e.count = out[i].size();
+      e.offset = indices.size() * sizeof(GLuint);
+      triangles.append(e);
+      indices.append(out[i]);
+    }
+    const PendingArea& area = m_areas[i];
+    const QPointF center = computeAreaCenterAndBboxes(triangles, vertices, indices);
+    setGeometry(area.object,
+                new S57::Geometry::Area(area.lines, center, triangles, 0, true, proj),
+                area.bbox);
+  }
+  m_areas.clear();
 }
 
 int ChartFileReader::addIndices(const Edge& e, GL::IndexVector& indices) {
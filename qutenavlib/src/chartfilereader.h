@@ -23,6 +23,7 @@
 #include "s57object.h"
 #include "geoprojection.h"
 #include <QtPlugin>
+#include <functional>
 
 class ChartFileReader {
 public:
@@ -58,10 +59,41 @@ public:
                                             const GL::VertexVector& vertices,
                                             const GL::IndexVector& indices);
 
-  static void triangulate(S57::ElementDataVector& elems,
-                          GL::IndexVector& indices,
-                          const GL::VertexVector& vertices,
-                          const S57::ElementDataVector& edges);
+  //
+  // Triangulates areas concurrently. The area objects are collected while
+  // the chart is read and triangulated in one go when all line elements
+  // are in place. The triangles are appended to the index buffer in the
+  // order the areas were added, so the result does not depend on
+  // the thread scheduling.
+  //
+  class AreaTriangulator {
+  public:
+
+    // Only the reader's object builder can set the geometry of an object
+    using GeometrySetter = std::function<void (S57::Object*, S57::Geometry::Base*, const QRectF&)>;
+
+    void add(S57::Object* obj, const S57::ElementDataVector& lines, const QRectF& bbox);
+
+    // triangulates the areas and passes the area geometries to setGeometry
+    // in the order the areas were added
+    void triangulate(GL::IndexVector& indices,
+                     const GL::VertexVector& vertices,
+                     const GeoProjection* proj,
+                     const GeometrySetter& setGeometry);
+
+  private:
+
+    // areas per helper thread
+    static const int minAreas = 32;
+
+    struct PendingArea {
+      S57::Object* object;
+      S57::ElementDataVector lines;
+      QRectF bbox;
+    };
+
+    QVector<PendingArea> m_areas;
+  };
 
   struct Edge {
     Edge() = default;
@@ -86,6 +118,12 @@ public:
 
 protected:
 
+  // returns false if the outer ring is not closed
+  static bool Triangulate(GL::IndexVector& triangles,
+                          const GL::IndexVector& indices,
+                          const GL::VertexVector& vertices,
+                          const S57::ElementDataVector& edges);
+
   ChartFileReader(const QString& name)
     : m_name(name) {}
 
@@ -19,7 +19,10 @@
  */
 #include "osenc.h"
 #include <QDataStream>
+#include <QFile>
 #include <functional>
+#include <limits>
+#include <cstddef>
 #include <QDate>
 #include "s52names.h"
 #include "chartfilereader.h"
@@ -383,9 +386,56 @@ public:
 
 }
 
-static void appendTriangles(GL::VertexVector& ps, const glm::vec2* vs, quint32 nv);
-static void appendTriangleStrip(GL::VertexVector& ps, const glm::vec2* vs, quint32 nv);
-static void appendTriangleFan(GL::VertexVector& ps, const glm::vec2* vs, quint32 nv);
+static void appendTriangles(GL::VertexVector& ps, const char* vs, quint32 nv);
+static void appendTriangleStrip(GL::VertexVector& ps, const char* vs, quint32 nv);
+static void appendTriangleFan(GL::VertexVector& ps, const char* vs, quint32 nv);
+
+// throws if n bytes starting at ptr do not fit in the record
+static void Require(const char* ptr, quint64 n, const char* end) {
+  if (ptr > end || n > static_cast<quint64>(end - ptr)) {
+    throw ChartFileError(QString("Truncated record, cannot read %1 bytes").arg(n));
+  }
+}
+
+// reads a value from possibly unaligned record data
+template<typename T> static T Read(const char*& ptr, const char* end) {
+  Require(ptr, sizeof(T), end);
+  T t;
+  memcpy(&t, ptr, sizeof(T));
+  ptr += sizeof(T);
+  return t;
+}
+
+template<typename T> static void Grow(QVector<T>& v, quint32 index, quint32 maxIndex) {
+  if (index > maxIndex) {
+    throw ChartFileError(QString("Node or edge id %1 is out of range").arg(index));
+  }
+  if (index >= static_cast<quint32>(v.size())) {
+    v.resize(index + 1);
+  }
+}
+
+void Osenc::ReadEdgeRefs(RawEdgeRefVector& refs, const char* ptr, const char* end,
+                         quint32 count, bool hasReversed) {
+  const quint64 refSize = (hasReversed ? 4 : 3) * sizeof(int);
+  Require(ptr, count * refSize, end);
+  refs.reserve(refs.size() + count);
+  for (uint i = 0; i < count; i++) {
+    const int begin = Read<int>(ptr, end);
+    const int index = Read<int>(ptr, end);
+    const int last = Read<int>(ptr, end);
+    RawEdgeRef ref;
+    ref.begin = begin;
+    ref.index = std::abs(index);
+    ref.end = last;
+    if (hasReversed) {
+      ref.reversed = Read<int>(ptr, end) != 0;
+    } else {
+      ref.reversed = index < 0;
+    }
+    refs.append(ref);
+  }
+}
 
 void Osenc::readChart(GL::VertexVector& vertices,
                             GL::IndexVector& indices,
@@ -394,8 +444,9 @@ void Osenc::readChart(GL::VertexVector& vertices,
                             const GeoProjection* gp) const {
 
 
-  PointRefMap connected;
-  RawEdgeMap edges;
+  // dense tables indexed by node/edge id
+  PointRefVector connected;
+  RawEdgeVector edges;
 
   S57::Object* current = nullptr;
   ObjectWrapperVector features;
@@ -404,304 +455,292 @@ void Osenc::readChart(GL::VertexVector& vertices,
 
   bool hasReversed = false;
 
-  QDataStream stream(device);
-
-
-  const QMap<SencRecordType, Handler*> handlers {
+  // records are decoded in place from one buffer
+  QByteArray data;
+  const char* ptr = nullptr;
+  const char* end = nullptr;
+  auto file = qobject_cast<QFile*>(device);
+  uchar* mapped = nullptr;
+  if (file != nullptr && file->size() > file->pos()) {
+    mapped = file->map(file->pos(), file->size() - file->pos());
+  }
+  if (mapped != nullptr) {
+    ptr = reinterpret_cast<const char*>(mapped);
+    end = ptr + file->size() - file->pos();
+  } else {
+    data = device->readAll();
+    ptr = data.constData();
+    end = ptr + data.size();
+  }
 
-    {SencRecordType::HEADER_SENC_VERSION, new Handler([&hasReversed] (const Buffer& b) {
-        quint16 version = *(reinterpret_cast<const quint16*>(b.constData()));
-        qCDebug(CENC) << "senc version" << version;
-        hasReversed = version > 200;
-        return true;
-      })
-    },
+  const int baseSize = sizeof(OSENC_Record_Base);
 
-    {SencRecordType::FEATURE_ID_RECORD, new Handler([&current, &features] (const Buffer& b) {
-        // qCDebug(CENC) << "id record";
-        auto p = reinterpret_cast<const OSENC_Feature_Identification_Record_Payload*>(b.constData());
-        current = new S57::Object(p->feature_ID, p->feature_type_code);
-        features.append(ObjectWrapper(current));
-        return true;
-      })
-    },
+  // Node and edge ids are record ids, which are numbered sequentially
+  // within the cell. Every table entry takes at least 12 bytes, so larger
+  // ids can only come from a corrupt file.
+  const quint32 maxIndex = static_cast<quint32>(std::min<qint64>(
+                                                  (end - ptr) / 12,
+                                                  std::numeric_limits<qint32>::max() - 1));
 
-    {SencRecordType::FEATURE_ATTRIBUTE_RECORD, new Handler([&current, helper] (const Buffer& b) {
-        // qCDebug(CENC) << "attribute record";
-        if (!current) return false;
-        auto p = reinterpret_cast<const OSENC_Attribute_Record_Payload*>(b.constData());
-        auto t = as_enum<AttributeRecType>(p->attribute_value_type, AllAttrTypes);
-        switch (t) {
-        case AttributeRecType::Integer: {
-          int v;
-          memcpy(&v, &p->attribute_data, sizeof(int));
-          helper.osEncAddAttribute(current,
-                                   p->attribute_type_code,
-                                   S57::Attribute(v));
-          return true;
-        }
-        case AttributeRecType::Real: {
-          double v;
-          memcpy(&v, &p->attribute_data, sizeof(double));
-          helper.osEncAddAttribute(current,
-                                   p->attribute_type_code,
-                                   S57::Attribute(v));
-          return true;
-        }
-        case AttributeRecType::String: {
-          const char* s = &p->attribute_data; // null terminated string
-          // handles strings and integer lists
-          helper.osEncAddString(current,
-                                p->attribute_type_code,
-                                QString::fromUtf8(s));
-          return true;
-        }
-        default: return false;
-        }
-        return false;
-      })
-    },
+  bool done = false;
 
-    {SencRecordType::FEATURE_GEOMETRY_RECORD_POINT, new Handler([&current, &features, helper, gp] (const Buffer& b) {
-        // qCDebug(CENC) << "feature geometry/point record";
-        if (!current) return false;
-        auto p = reinterpret_cast<const OSENC_PointGeometry_Record_Payload*>(b.constData());
-        auto p0 = gp->fromWGS84(WGS84Point::fromLL(p->lon, p->lat));
-        features.last().geom = S57::Geometry::Type::Point;
-        QRectF bb(p0 - QPointF(10, 10), QSizeF(20, 20));
-        return helper.osEncSetGeometry(current, new S57::Geometry::Point(p0, gp), bb);
-      })
-    },
+  while (!done && end - ptr >= baseSize) {
 
-    {SencRecordType::FEATURE_GEOMETRY_RECORD_LINE, new Handler([&features, &hasReversed] (const Buffer& b) {
-        // qCDebug(CENC) << "feature geometry/line record";
-        auto p = reinterpret_cast<const OSENC_LineGeometry_Record_Payload*>(b.constData());
-        const uint stride = hasReversed ? 4 : 3;
-        QVector<int> es(p->edgeVector_count * stride);
-        memcpy(es.data(), &p->edge_data, p->edgeVector_count * stride * sizeof(int));
-        RawEdgeRefVector refs;
-        for (uint i = 0; i < p->edgeVector_count; i++) {
-          RawEdgeRef ref;
-          ref.begin = es[stride * i];
-          ref.index = std::abs(es[stride * i + 1]);
-          ref.end = es[stride * i + 2];
-          if (hasReversed) {
-            ref.reversed = es[stride * i + stride - 1] != 0;
-          } else {
-            ref.reversed = es[stride * i + 1] < 0;
-          }
-          refs.append(ref);
-        }
-        features.last().edgeRefs.append(refs);
-        features.last().geom = S57::Geometry::Type::Line;
-        return true;
-      })
-    },
+    auto record = reinterpret_cast<const OSENC_Record_Base*>(ptr);
 
-    {SencRecordType::FEATURE_GEOMETRY_RECORD_AREA, new Handler([&features, &hasReversed] (const Buffer& b) {
-        // qCDebug(CENC) << "feature geometry/area record";
-        auto p = reinterpret_cast<const OSENC_AreaGeometry_Record_Payload*>(b.constData());
-
-        const uint8_t* ptr = &p->edge_data;
-
-        // skip contour counts
-        ptr += p->contour_count * sizeof(int);
-
-        TrianglePatchVector ts;
-        if (p->triprim_count < 5) {
-          ts.resize(p->triprim_count);
-          for (uint i = 0; i < p->triprim_count; i++) {
-            ts[i].mode = static_cast<GLenum>(*ptr);
-            ptr++;
-            auto nvert = *reinterpret_cast<const uint32_t*>(ptr);
-            ptr += sizeof(uint32_t);
-            ptr += 4 * sizeof(double); // skip bbox
-            ts[i].vertices.resize(nvert * 2);
-            memcpy(ts[i].vertices.data(), ptr, nvert * 2 * sizeof(float));
-            ptr += nvert * 2 * sizeof(float);
-          }
-        } else {
-          ts << TrianglePatch();
-          for (uint i = 0; i < p->triprim_count; i++) {
-            if (ts.last().vertices.size() > blockSize) {
-              ts << TrianglePatch();
-            }
-            GLenum mode = static_cast<GLenum>(*ptr);
-            ptr++;
-            auto nvert = *reinterpret_cast<const uint32_t*>(ptr);
-            ptr += sizeof(uint32_t);
-            ptr += 4 * sizeof(double); // skip bbox
-            if (mode == GL_TRIANGLES) {
-              appendTriangles(ts.last().vertices, reinterpret_cast<const glm::vec2*>(ptr), nvert);
-            } else if (mode == GL_TRIANGLE_STRIP) {
-              appendTriangleStrip(ts.last().vertices, reinterpret_cast<const glm::vec2*>(ptr), nvert);
-            } else if (mode == GL_TRIANGLE_FAN) {
-              appendTriangleFan(ts.last().vertices, reinterpret_cast<const glm::vec2*>(ptr), nvert);
-            } else {
-              Q_ASSERT_X(false, "feature geometry/area record", "Unknown primitive");
-            }
-            ptr += nvert * 2 * sizeof(float);
-          }
+    if (record->record_length <= baseSize) {
+      qCWarning(CENC) << "Record length is too small" << record->record_length;
+      break;
+    }
 
-        }
+    if (record->record_length > static_cast<quint64>(end - ptr)) {
+      qCWarning(CENC) << "Cannot read base record data";
+      break;
+    }
 
-        features.last().triangles.append(ts);
-        features.last().geom = S57::Geometry::Type::Area;
-
-        const uint stride = hasReversed ? 4 : 3;
-        QVector<int> es(p->edgeVector_count * stride);
-        memcpy(es.data(), ptr, p->edgeVector_count * stride * sizeof(int));
-
-        RawEdgeRefVector refs;
-        for (uint i = 0; i < p->edgeVector_count; i++) {
-          RawEdgeRef ref;
-          ref.begin = es[stride * i];
-          ref.index = std::abs(es[stride * i + 1]);
-          ref.end = es[stride * i + 2];
-          if (hasReversed) {
-            ref.reversed = es[stride * i + stride - 1] != 0;
-          } else {
-            ref.reversed = es[stride * i + 1] < 0;
-          }
-          refs.append(ref);
-        }
-        features.last().edgeRefs.append(refs);
+    const SencRecordType rec_type = record->record_type;
+    const char* b = ptr + baseSize;
+    ptr += record->record_length;
+    const char* rend = ptr;
 
-        return true;
-      })
-    },
+    bool ok = true;
 
-    {SencRecordType::FEATURE_GEOMETRY_RECORD_MULTIPOINT, new Handler([&current, &features, helper, gp] (const Buffer& b) {
-        // qCDebug(CENC) << "feature geometry/multipoint record";
-        if (!current) return false;
-        auto p = reinterpret_cast<const OSENC_MultipointGeometry_Record_Payload*>(b.constData());
-        GL::VertexVector ps(p->point_count * 3);
-        memcpy(ps.data(), &p->point_data, p->point_count * 3 * sizeof(GLfloat));
-        features.last().geom = S57::Geometry::Type::Point;
-        auto bbox = ChartFileReader::computeSoundingsBBox(ps);
-        return helper.osEncSetGeometry(current, new S57::Geometry::Point(ps, gp), bbox);
-      })
-    },
+    switch (rec_type) {
 
-    {SencRecordType::VECTOR_EDGE_NODE_TABLE_RECORD, new Handler([&vertices, &edges] (const Buffer& b) {
-        // qCDebug(CENC) << "vector edge node table record";
-        const char* ptr = b.constData();
+    case SencRecordType::HEADER_SENC_VERSION: {
+      const quint16 version = Read<quint16>(b, rend);
+      qCDebug(CENC) << "senc version" << version;
+      hasReversed = version > 200;
+      break;
+    }
 
-        // edge count
-        auto cnt = *reinterpret_cast<const quint32*>(ptr);
-        ptr += sizeof(quint32);
+    case SencRecordType::FEATURE_ID_RECORD: {
+      // qCDebug(CENC) << "id record";
+      Require(b, sizeof(OSENC_Feature_Identification_Record_Payload), rend);
+      auto p = reinterpret_cast<const OSENC_Feature_Identification_Record_Payload*>(b);
+      current = new S57::Object(p->feature_ID, p->feature_type_code);
+      features.append(ObjectWrapper(current));
+      break;
+    }
 
-        for (uint i = 0; i < cnt; i++) {
-          auto index = *reinterpret_cast<const quint32*>(ptr);
-          ptr += sizeof(quint32);
+    case SencRecordType::FEATURE_ATTRIBUTE_RECORD: {
+      // qCDebug(CENC) << "attribute record";
+      if (!current) {
+        ok = false;
+        break;
+      }
+      const auto header = offsetof(OSENC_Attribute_Record_Payload, attribute_data);
+      Require(b, header, rend);
+      auto p = reinterpret_cast<const OSENC_Attribute_Record_Payload*>(b);
+      auto t = as_enum<AttributeRecType>(p->attribute_value_type, AllAttrTypes);
+      switch (t) {
+      case AttributeRecType::Integer: {
+        Require(b, header + sizeof(int), rend);
+        int v;
+        memcpy(&v, &p->attribute_data, sizeof(int));
+        helper.osEncAddAttribute(current,
+                                 p->attribute_type_code,
+                                 S57::Attribute(v));
+        break;
+      }
+      case AttributeRecType::Real: {
+        Require(b, header + sizeof(double), rend);
+        double v;
+        memcpy(&v, &p->attribute_data, sizeof(double));
+        helper.osEncAddAttribute(current,
+                                 p->attribute_type_code,
+                                 S57::Attribute(v));
+        break;
+      }
+      case AttributeRecType::String: {
+        const char* s = &p->attribute_data; // null terminated string
+        // handles strings and integer lists
+        helper.osEncAddString(current,
+                              p->attribute_type_code,
+                              QString::fromUtf8(s, qstrnlen(s, static_cast<uint>(rend - s))));
+        break;
+      }
+      default: ok = false;
+      }
+      break;
+    }
 
-          auto pcnt = *reinterpret_cast<const quint32*>(ptr);
-          ptr += sizeof(quint32);
+    case SencRecordType::FEATURE_GEOMETRY_RECORD_POINT: {
+      // qCDebug(CENC) << "feature geometry/point record";
+      if (!current) {
+        ok = false;
+        break;
+      }
+      Require(b, sizeof(OSENC_PointGeometry_Record_Payload), rend);
+      auto p = reinterpret_cast<const OSENC_PointGeometry_Record_Payload*>(b);
+      auto p0 = gp->fromWGS84(WGS84Point::fromLL(p->lon, p->lat));
+      features.last().geom = S57::Geometry::Type::Point;
+      QRectF bb(p0 - QPointF(10, 10), QSizeF(20, 20));
+      ok = helper.osEncSetGeometry(current, new S57::Geometry::Point(p0, gp), bb);
+      break;
+    }
 
-          QVector<float> points(2 * pcnt);
-          memcpy(points.data(), ptr, 2 * pcnt * sizeof(float));
-          ptr += 2 * pcnt * sizeof(float);
+    case SencRecordType::FEATURE_GEOMETRY_RECORD_LINE: {
+      // qCDebug(CENC) << "feature geometry/line record";
+      if (!current) {
+        ok = false;
+        break;
+      }
+      auto p = reinterpret_cast<const OSENC_LineGeometry_Record_Payload*>(b);
+      Require(b, offsetof(OSENC_LineGeometry_Record_Payload, edge_data), rend);
+      ReadEdgeRefs(features.last().edgeRefs,
+                   reinterpret_cast<const char*>(&p->edge_data),
+                   rend,
+                   p->edgeVector_count,
+                   hasReversed);
+      features.last().geom = S57::Geometry::Type::Line;
+      break;
+    }
 
-          RawEdge edge;
-          edge.first = vertices.size() / 2;
-          edge.count = pcnt;
-          edges[index] = edge;
-          vertices.append(points);
+    case SencRecordType::FEATURE_GEOMETRY_RECORD_AREA: {
+      // qCDebug(CENC) << "feature geometry/area record";
+      if (!current) {
+        ok = false;
+        break;
+      }
+      auto p = reinterpret_cast<const OSENC_AreaGeometry_Record_Payload*>(b);
+      Require(b, offsetof(OSENC_AreaGeometry_Record_Payload, edge_data), rend);
+
+      const char* q = reinterpret_cast<const char*>(&p->edge_data);
+
+      // skip contour counts
+      Require(q, static_cast<quint64>(p->contour_count) * sizeof(int), rend);
+      q += p->contour_count * sizeof(int);
+
+      TrianglePatchVector& ts = features.last().triangles;
+      if (p->triprim_count < 5) {
+        for (uint i = 0; i < p->triprim_count; i++) {
+          TrianglePatch patch;
+          patch.mode = static_cast<GLenum>(Read<quint8>(q, rend));
+          const auto nvert = Read<quint32>(q, rend);
+          Require(q, 4 * sizeof(double) + static_cast<quint64>(nvert) * 2 * sizeof(float), rend);
+          q += 4 * sizeof(double); // skip bbox
+          patch.vertices.resize(nvert * 2);
+          memcpy(patch.vertices.data(), q, nvert * 2 * sizeof(float));
+          q += nvert * 2 * sizeof(float);
+          ts << patch;
         }
-        return true;
-      })
-    },
-
-    {SencRecordType::VECTOR_CONNECTED_NODE_TABLE_RECORD, new Handler([&vertices, &connected] (const Buffer& b) {
-        // qCDebug(CENC) << "vector connected node table record";
-        const char* ptr = b.constData();
-
-        // node count
-        auto cnt = *reinterpret_cast<const quint32*>(ptr);
+      } else {
+        ts << TrianglePatch();
+        for (uint i = 0; i < p->triprim_count; i++) {
+          if (ts.last().vertices.size() > blockSize) {
+            ts << TrianglePatch();
+          }
+          const GLenum mode = static_cast<GLenum>(Read<quint8>(q, rend));
+          const auto nvert = Read<quint32>(q, rend);
+          Require(q, 4 * sizeof(double) + static_cast<quint64>(nvert) * 2 * sizeof(float), rend);
+          q += 4 * sizeof(double); // skip bbox
+          if (mode == GL_TRIANGLES) {
+            appendTriangles(ts.last().vertices, q, nvert);
+          } else if (mode == GL_TRIANGLE_STRIP) {
+            appendTriangleStrip(ts.last().vertices, q, nvert);
+          } else if (mode == GL_TRIANGLE_FAN) {
+            appendTriangleFan(ts.last().vertices, q, nvert);
+          } else {
+            Q_ASSERT_X(false, "feature geometry/area record", "Unknown primitive");
+          }
+          q += nvert * 2 * sizeof(float);
+        }
+      }
 
-        ptr += sizeof(quint32);
+      features.last().geom = S57::Geometry::Type::Area;
+      ReadEdgeRefs(features.last().edgeRefs, q, rend, p->edgeVector_count, hasReversed);
+      break;
+    }
 
-        for (uint i = 0; i < cnt; i++) {
-          auto index = *reinterpret_cast<const quint32*>(ptr);
-          ptr += sizeof(quint32);
+    case SencRecordType::FEATURE_GEOMETRY_RECORD_MULTIPOINT: {
+      // qCDebug(CENC) << "feature geometry/multipoint record";
+      if (!current) {
+        ok = false;
+        break;
+      }
+      auto p = reinterpret_cast<const OSENC_MultipointGeometry_Record_Payload*>(b);
+      Require(b, offsetof(OSENC_MultipointGeometry_Record_Payload, point_data), rend);
+      Require(reinterpret_cast<const char*>(&p->point_data),
+              static_cast<quint64>(p->point_count) * 3 * sizeof(GLfloat), rend);
+      GL::VertexVector ps(p->point_count * 3);
+      memcpy(ps.data(), &p->point_data, p->point_count * 3 * sizeof(GLfloat));
+      features.last().geom = S57::Geometry::Type::Point;
+      auto bbox = ChartFileReader::computeSoundingsBBox(ps);
+      ok = helper.osEncSetGeometry(current, new S57::Geometry::Point(ps, gp), bbox);
+      break;
+    }
 
-          auto x = *reinterpret_cast<const float*>(ptr);
-          ptr += sizeof(float);
-          auto y = *reinterpret_cast<const float*>(ptr);
-          ptr += sizeof(float);
+    case SencRecordType::VECTOR_EDGE_NODE_TABLE_RECORD: {
+      // qCDebug(CENC) << "vector edge node table record";
 
-          connected[index] = vertices.size() / 2;
-          vertices.append(x);
-          vertices.append(y);
-        }
-        return true;
-      })
-    },
+      // edge count
+      const auto cnt = Read<quint32>(b, rend);
 
-    {SencRecordType::FEATURE_GEOMETRY_RECORD_AREA_EXT, new Handler([] (const Buffer& b) {
-        qCDebug(CENC) << "feature geometry/area ext record";
-        throw NotImplementedError(QStringLiteral("FEATURE_GEOMETRY_RECORD_AREA_EXT not implemented"));
-        return true;
-      })
-    },
-    {SencRecordType::VECTOR_EDGE_NODE_TABLE_EXT_RECORD, new Handler([] (const Buffer& b) {
-        qCDebug(CENC) << "edge node ext record";
-        throw NotImplementedError(QStringLiteral("VECTOR_EDGE_NODE_TABLE_EXT_RECORD not implemented"));
-        return true;
-      })
-    },
-    {SencRecordType::VECTOR_CONNECTED_NODE_TABLE_EXT_RECORD, new Handler([] (const Buffer& b) {
-        qCDebug(CENC) << "connected node ext record";
-        throw NotImplementedError(QStringLiteral("VECTOR_CONNECTED_NODE_TABLE_EXT_RECORD not implemented"));
-        return true;
-      })
-    },
+      for (uint i = 0; i < cnt; i++) {
+        const auto index = Read<quint32>(b, rend);
+        const auto pcnt = Read<quint32>(b, rend);
+        Require(b, static_cast<quint64>(pcnt) * 2 * sizeof(float), rend);
 
-  };
+        Grow(edges, index, maxIndex);
+        RawEdge& edge = edges[index];
+        edge.first = vertices.size() / 2;
+        edge.count = pcnt;
 
-  bool done = false;
+        const int first = vertices.size();
+        vertices.resize(first + 2 * pcnt);
+        memcpy(vertices.data() + first, b, 2 * pcnt * sizeof(float));
+        b += 2 * pcnt * sizeof(float);
+      }
+      break;
+    }
 
-  const int baseSize = sizeof(OSENC_Record_Base);
+    case SencRecordType::VECTOR_CONNECTED_NODE_TABLE_RECORD: {
+      // qCDebug(CENC) << "vector connected node table record";
 
-  while (!done) {
+      // node count
+      const auto cnt = Read<quint32>(b, rend);
 
-    Buffer buffer;
+      for (uint i = 0; i < cnt; i++) {
+        const auto index = Read<quint32>(b, rend);
+        const auto x = Read<float>(b, rend);
+        const auto y = Read<float>(b, rend);
 
-    buffer.resize(baseSize);
-    if (stream.readRawData(buffer.data(), baseSize) < baseSize) {
-      done = true;
-      continue;
+        Grow(connected, index, maxIndex);
+        connected[index] = vertices.size() / 2;
+        vertices.append(x);
+        vertices.append(y);
+      }
+      break;
     }
 
-    auto record = reinterpret_cast<OSENC_Record_Base*>(buffer.data());
+    case SencRecordType::FEATURE_GEOMETRY_RECORD_AREA_EXT:
+      qCDebug(CENC) << "feature geometry/area ext record";
+      throw NotImplementedError(QStringLiteral("FEATURE_GEOMETRY_RECORD_AREA_EXT not implemented"));
 
-    if (record->record_length <= baseSize) {
-      done = true;
-      qCWarning(CENC) << "Record length is too small" << buffer;
-      continue;
-    }
+    case SencRecordType::VECTOR_EDGE_NODE_TABLE_EXT_RECORD:
+      qCDebug(CENC) << "edge node ext record";
+      throw NotImplementedError(QStringLiteral("VECTOR_EDGE_NODE_TABLE_EXT_RECORD not implemented"));
 
-    // copy, record_type will be overwritten in the next stream.readRawData
-    SencRecordType rec_type = record->record_type;
+    case SencRecordType::VECTOR_CONNECTED_NODE_TABLE_EXT_RECORD:
+      qCDebug(CENC) << "connected node ext record";
+      throw NotImplementedError(QStringLiteral("VECTOR_CONNECTED_NODE_TABLE_EXT_RECORD not implemented"));
 
-    buffer.resize(record->record_length - baseSize);
-    if (stream.readRawData(buffer.data(), buffer.size()) < buffer.size()) {
-      done = true;
-      qCWarning(CENC) << "Cannot read base record data";
-      continue;
-    }
-    if (!handlers.contains(rec_type)) {
+    default:
       // qCWarning(CENC) << "Unhandled type" << static_cast<int>(rec_type);
-      continue;
+      break;
     }
 
-    done = !(handlers[rec_type])->func(buffer);
+    done = !ok;
     if (done) {
       qCWarning(CENC) << "Handler failed for type" << as_numeric(rec_type);
     }
 
   }
-  qDeleteAll(handlers);
+
+  if (mapped != nullptr) {
+    file->unmap(mapped);
+  }
 
 
   auto triangleGeometry = [&vertices] (const TrianglePatchVector& triangles, S57::ElementDataVector& elems) {
@@ -734,14 +773,15 @@ void Osenc::readChart(GL::VertexVector& vertices,
         if (ref.reversed) {
           // Osenc does not reverse begin and end like the other formats,
           // so do it here
-          e.begin = connected[ref.end];
-          e.end = connected[ref.begin];
+          e.begin = connected.value(ref.end);
+          e.end = connected.value(ref.begin);
         } else {
-          e.begin = connected[ref.begin];
-          e.end = connected[ref.end];
+          e.begin = connected.value(ref.begin);
+          e.end = connected.value(ref.end);
         }
-        e.first = edges[ref.index].first;
-        e.count = edges[ref.index].count;
+        const RawEdge edge = edges.value(ref.index);
+        e.first = edge.first;
+        e.count = edge.count;
         e.reversed = ref.reversed;
         e.inner = false; // not used
         shape.append(e);
@@ -856,27 +896,39 @@ QPointF Osenc::computeAreaCenterAndBboxes(S57::ElementDataVector &elems,
 }
 
 
-static void appendTriangles(GL::VertexVector& ps, const glm::vec2* vs, quint32 nv) {
-  for (uint i = 0; i < nv; ++i) {
-    ps << vs[i].x << vs[i].y;
-  }
+static glm::vec2 vertex(const char* vs, quint32 i) {
+  glm::vec2 v;
+  memcpy(&v, vs + i * sizeof(glm::vec2), sizeof(glm::vec2));
+  return v;
+}
+
+static void appendTriangles(GL::VertexVector& ps, const char* vs, quint32 nv) {
+  const int first = ps.size();
+  ps.resize(first + 2 * nv);
+  memcpy(ps.data() + first, vs, 2 * nv * sizeof(float));
 }
 
-static void appendTriangleStrip(GL::VertexVector& ps, const glm::vec2* vs, quint32 nv) {
+static void appendTriangleStrip(GL::VertexVector& ps, const char* vs, quint32 nv) {
   bool reverseWinding = false;
   for (uint i = 0; i < nv - 2; ++i) {
+    const glm::vec2 v0 = vertex(vs, i);
+    const glm::vec2 v1 = vertex(vs, i + 1);
+    const glm::vec2 v2 = vertex(vs, i + 2);
     if (reverseWinding) {
-      ps << vs[i].x << vs[i].y << vs[i + 1].x << vs[i + 1].y << vs[i + 2].x << vs[i + 2].y;
+      ps << v0.x << v0.y << v1.x << v1.y << v2.x << v2.y;
     } else {
-      ps << vs[i + 1].x << vs[i + 1].y << vs[i].x << vs[i].y << vs[i + 2].x << vs[i + 2].y;
+      ps << v1.x << v1.y << v0.x << v0.y << v2.x << v2.y;
     }
     reverseWinding = !reverseWinding;
   }
 }
 
-static void appendTriangleFan(GL::VertexVector& ps, const glm::vec2* vs, quint32 nv) {
+static void appendTriangleFan(GL::VertexVector& ps, const char* vs, quint32 nv) {
+  const glm::vec2 v0 = vertex(vs, 0);
   for (uint i = 0; i < nv - 2; ++i) {
-    ps << vs[0].x << vs[0].y << vs[i + 1].x << vs[i + 1].y << vs[i + 2].x << vs[i + 2].y;
+    const glm::vec2 v1 = vertex(vs, i + 1);
+    const glm::vec2 v2 = vertex(vs, i + 2);
+    ps << v0.x << v0.y << v1.x << v1.y << v2.x << v2.y;
   }
 }
 
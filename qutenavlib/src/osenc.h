@@ -55,10 +55,8 @@ private:
     quint32 count;
   };
 
-  using RawEdgeMap = QMap<quint32, RawEdge>;
-  using REMIter = RawEdgeMap::const_iterator;
-
-  using PointRefMap = QMap<quint32, quint32>;
+  using RawEdgeVector = QVector<RawEdge>;
+  using PointRefVector = QVector<quint32>;
 
   struct TrianglePatch {
     TrianglePatch()
@@ -80,6 +78,9 @@ private:
 
   using RawEdgeRefVector = QVector<RawEdgeRef>;
 
+  static void ReadEdgeRefs(RawEdgeRefVector& refs, const char* ptr, const char* end,
+                           quint32 count, bool hasReversed);
+
   struct ObjectWrapper {
     explicit ObjectWrapper(S57::Object* obj = nullptr)
       : object(obj)
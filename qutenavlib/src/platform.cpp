@@ -46,8 +46,8 @@ float dots_per_inch_y() {
 }
 
 const QString& baseAppName() {
-  // qutenav, harbour-qutenav, qutenav_dbupdater or harbour_qutenav_updater ->
-  // qutenav or harbour-qutenav
-  static QString name = qAppName().replace("_dbupdater", "").replace("_", "-");
+  // qutenav, harbour-qutenav, qutenav_dbupdater, harbour_qutenav_updater or
+  // qutenav_render -> qutenav or harbour-qutenav
+  static QString name = qAppName().replace("_dbupdater", "").replace("_render", "").replace("_", "-");
   return name;
 }
@@ -0,0 +1,146 @@
+/* -*- coding: utf-8-unix -*-
+ *
+ * File: src/rtree.cpp
+ *
+ * Copyright (C) 2021 Jukka Sirkka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rtree.h"
+#include <QStack>
+#include <cmath>
+#include <algorithm>
+
+void KV::RTree::clear() {
+  m_items.clear();
+  m_order.clear();
+  m_levels.clear();
+}
+
+KV::RTree::NodeVector KV::RTree::Pack(const RectVector& boxes, IndexVector& order) {
+
+  const int n = boxes.size();
+  order.resize(n);
+  for (int i = 0; i < n; i++) order[i] = i;
+
+  // sort by x, then tile vertical slices and sort them by y
+  const int leafCount = (n + nodeSize - 1) / nodeSize;
+  const int sliceCount = std::ceil(std::sqrt(static_cast<double>(leafCount)));
+  const int sliceSize = sliceCount * nodeSize;
+
+  std::sort(order.begin(), order.end(), [&boxes] (quint32 a, quint32 b) {
+    return boxes[a].center().x() < boxes[b].center().x();
+  });
+
+  for (int first = 0; first < n; first += sliceSize) {
+    const int last = qMin(first + sliceSize, n);
+    std::sort(order.begin() + first, order.begin() + last, [&boxes] (quint32 a, quint32 b) {
+      return boxes[a].center().y() < boxes[b].center().y();
+    });
+  }
+
+  NodeVector nodes;
+  for (int first = 0; first < n; first += nodeSize) {
+    const int count = qMin(nodeSize, n - first);
+    // Note: QRectF::united ignores null rects, make sure they count
+    QPointF ll = boxes[order[first]].topLeft();
+    QPointF ur = boxes[order[first]].bottomRight();
+    for (int i = 1; i < count; i++) {
+      const QRectF& b = boxes[order[first + i]];
+      ll.setX(qMin(ll.x(), b.left()));
+      ll.setY(qMin(ll.y(), b.top()));
+      ur.setX(qMax(ur.x(), b.right()));
+      ur.setY(qMax(ur.y(), b.bottom()));
+    }
+    nodes.append(Node(QRectF(ll, ur), first, count));
+  }
+
+  return nodes;
+}
+
+void KV::RTree::build(const RectVector& items) {
+  clear();
+  if (items.isEmpty()) return;
+
+  m_items = items;
+
+  RectVector boxes;
+  for (const QRectF& r: items) {
+    boxes.append(r.normalized());
+  }
+
+  m_levels.append(Pack(boxes, m_order));
+
+  while (m_levels.last().size() > 1) {
+    const NodeVector& below = m_levels.last();
+
+    RectVector nodeBoxes;
+    for (const Node& node: below) {
+      nodeBoxes.append(node.box);
+    }
+
+    IndexVector order;
+    NodeVector packed = Pack(nodeBoxes, order);
+
+    // reorder the level below to make the children of a node contiguous
+    NodeVector reordered;
+    for (auto index: order) {
+      reordered.append(below[index]);
+    }
+    m_levels.last() = reordered;
+    m_levels.append(packed);
+  }
+}
+
+KV::RTree::IndexVector KV::RTree::intersecting(const QRectF& box) const {
+
+  IndexVector result;
+  if (m_levels.isEmpty()) return result;
+
+  const QRectF q = box.normalized();
+
+  auto overlaps = [q] (const QRectF& r) {
+    return r.left() <= q.right() && r.right() >= q.left() &&
+        r.top() <= q.bottom() && r.bottom() >= q.top();
+  };
+
+  using Ref = QPair<int, quint32>; // level, node index
+  QStack<Ref> stack;
+
+  const int top = m_levels.size() - 1;
+  for (int i = 0; i < m_levels[top].size(); i++) {
+    stack.push(Ref(top, i));
+  }
+
+  while (!stack.isEmpty()) {
+    const Ref ref = stack.pop();
+    const Node& node = m_levels[ref.first][ref.second];
+    if (!overlaps(node.box)) continue;
+    if (ref.first == 0) {
+      for (quint32 i = node.first; i < node.first + node.count; i++) {
+        const auto index = m_order[i];
+        if (m_items[index].intersects(q)) {
+          result.append(index);
+        }
+      }
+    } else {
+      for (quint32 i = node.first; i < node.first + node.count; i++) {
+        stack.push(Ref(ref.first - 1, i));
+      }
+    }
+  }
+
+  std::sort(result.begin(), result.end());
+  return result;
+}
@@ -0,0 +1,71 @@
+/* -*- coding: utf-8-unix -*-
+ *
+ * File: src/rtree.h
+ *
+ * Copyright (C) 2021 Jukka Sirkka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <QVector>
+#include <QRectF>
+
+namespace KV {
+
+// Static R-tree packed with the Sort-Tile-Recursive algorithm.
+// Items are identified by their index in the vector passed to build.
+class RTree {
+public:
+
+  using RectVector = QVector<QRectF>;
+  using IndexVector = QVector<quint32>;
+
+  RTree() = default;
+
+  void build(const RectVector& items);
+  void clear();
+  bool isEmpty() const {return m_items.isEmpty();}
+  int size() const {return m_items.size();}
+
+  // Indices of the items intersecting box in ascending order.
+  // Intersection is tested as in QRectF::intersects.
+  IndexVector intersecting(const QRectF& box) const;
+
+private:
+
+  struct Node {
+    Node() = default;
+    Node(const QRectF& b, quint32 f, quint32 c)
+      : box(b)
+      , first(f)
+      , count(c) {}
+    QRectF box;
+    quint32 first; // first child in the level below, or in m_order
+    quint32 count;
+  };
+
+  using NodeVector = QVector<Node>;
+  using LevelVector = QVector<NodeVector>;
+
+  static const inline int nodeSize = 16;
+
+  static NodeVector Pack(const RectVector& boxes, IndexVector& order);
+
+  RectVector m_items;
+  IndexVector m_order; // leaf order of the items
+  LevelVector m_levels; // leaves first, root last
+};
+
+}
@@ -265,32 +265,6 @@ bool S57::Geometry::Area::includes(const glm::vec2* vs, const GLuint* is, const
 
 
 
-static QDate stringToDate(const QString& s, const QDate& today, bool start) {
-  if (s.length() == 8) return QDate::fromString(s, "yyyyMMdd");
-
-  if (s.length() == 4) {
-    auto d = QDate::fromString(s, "MMdd");
-    d.setDate(today.year(), d.month(), d.day());
-    return d;
-  }
-
-  if (s.length() == 2) {
-    auto d = QDate::fromString(s, "MM");
-    if (start) {
-      d.setDate(today.year(), d.month(), 1);
-    } else {
-      int day = 31;
-      const int month = d.month();
-      while (!d.setDate(today.year(), month, day) && day >= 28) {
-        day -= 1;
-      }
-    }
-    return d;
-  }
-
-  return QDate();
-}
-
 S57::Object::~Object() {
   delete m_geometry;
 }
@@ -318,61 +292,108 @@ QSet<int> S57::Object::attributeSetValue(quint32 attr) const {
   return rs;
 }
 
-bool S57::Object::canPaint(const KV::Region& cover, quint32 scale,
-                           const QDate& today, bool coverOnly) const {
+S57::Object::DateLimit S57::Object::ParseDateLimit(const QString& s, bool start) {
+  DateLimit d;
+  d.kind = DateLimit::Kind::Invalid;
 
-  if (m_bbox.isValid() && !cover.intersects(m_bbox)) {
-    // qDebug() << "no intersect" << m_bbox << S52::GetClassInfo(m_feature_type_code);
-    return false;
+  if (s.length() == 8) {
+    const QDate date = QDate::fromString(s, "yyyyMMdd");
+    if (date.isValid()) {
+      d.kind = DateLimit::Kind::Absolute;
+      d.value = date.toJulianDay();
+    }
+    return d;
   }
 
-  if (coverOnly) return true;
+  // periodic dates: MMdd or MM, every year
+  bool ok = s.length() == 4 || s.length() == 2;
+  const int month = ok ? s.left(2).toInt(&ok) : 0;
+  if (!ok || month < 1 || month > 12) return d;
 
-  if (m_attributes.contains(scaminIndex)) {
-    const quint32 mx = m_attributes[scaminIndex].value().toUInt();
-    if (scale > mx) {
-      // qDebug() << "scale too small" << scale << mx << name();
-      return false;
-    }
+  int day = start ? 1 : 31;
+  if (s.length() == 4) {
+    day = s.mid(2).toInt(&ok);
+    if (!ok || day < 1 || day > 31) return d;
   }
 
-  if (m_attributes.contains(datstaIndex)) {
-    auto d = stringToDate(m_attributes[datstaIndex].value().toString(), today, true);
-    if (today < d) return false;
-  }
+  d.kind = DateLimit::Kind::Yearly;
+  d.value = month * 32 + day;
+  return d;
+}
 
-  if (m_attributes.contains(datendIndex)) {
-    auto d = stringToDate(m_attributes[datendIndex].value().toString(), today, false);
-    if (today > d) return false;
+bool S57::Object::Started(const DateLimit& d, qint64 jd, int md) {
+  switch (d.kind) {
+  case DateLimit::Kind::Absolute: return jd >= d.value;
+  case DateLimit::Kind::Yearly: return md >= d.value;
+  default: return true;
   }
+}
 
-  if (m_attributes.contains(perstaIndex)) {
-    auto d = stringToDate(m_attributes[perstaIndex].value().toString(), today, true);
-    if (today < d) return false;
+bool S57::Object::Ended(const DateLimit& d, qint64 jd, int md) {
+  switch (d.kind) {
+  case DateLimit::Kind::Absolute: return jd > d.value;
+  case DateLimit::Kind::Yearly: return md > d.value;
+  // unparseable end dates hide the object
+  case DateLimit::Kind::Invalid: return true;
+  default: return false;
   }
+}
 
-  if (m_attributes.contains(perendIndex)) {
-    auto d = stringToDate(m_attributes[perendIndex].value().toString(), today, false);
-    if (today > d) return false;
+void S57::Object::decodeValidity() {
+  m_scamin = std::numeric_limits<quint32>::max();
+  if (m_attributes.contains(scaminIndex)) {
+    m_scamin = m_attributes[scaminIndex].value().toUInt();
   }
 
-  return true;
+  auto limit = [this] (int index, bool start) {
+    if (!m_attributes.contains(index)) return DateLimit();
+    return ParseDateLimit(m_attributes[index].value().toString(), start);
+  };
+
+  m_dateStart = limit(datstaIndex, true);
+  m_dateEnd = limit(datendIndex, false);
+  m_periodStart = limit(perstaIndex, true);
+  m_periodEnd = limit(perendIndex, false);
+
+  m_dated = m_dateStart.kind != DateLimit::Kind::None ||
+      m_dateEnd.kind != DateLimit::Kind::None ||
+      m_periodStart.kind != DateLimit::Kind::None ||
+      m_periodEnd.kind != DateLimit::Kind::None;
 }
 
+bool S57::Object::canPaint(const KV::Region& cover, quint32 scale,
+                           const QDate& today, bool coverOnly) const {
 
-bool S57::Object::canPaint(quint32 scale) const {
+  if (m_bbox.isValid() && !cover.intersects(m_bbox)) {
+    // qDebug() << "no intersect" << m_bbox << S52::GetClassInfo(m_feature_type_code);
+    return false;
+  }
 
-  if (m_attributes.contains(scaminIndex)) {
-    const quint32 mx = m_attributes[scaminIndex].value().toUInt();
-    if (scale > mx) {
-      // qDebug() << "scale too small" << scale << mx << name();
-      return false;
-    }
+  if (coverOnly) return true;
+
+  if (scale > m_scamin) {
+    // qDebug() << "scale too small" << scale << m_scamin << name();
+    return false;
   }
 
+  if (!m_dated) return true;
+
+  const qint64 jd = today.toJulianDay();
+  const int md = today.month() * 32 + today.day();
+
+  if (!Started(m_dateStart, jd, md)) return false;
+  if (Ended(m_dateEnd, jd, md)) return false;
+  if (!Started(m_periodStart, jd, md)) return false;
+  if (Ended(m_periodEnd, jd, md)) return false;
+
   return true;
 }
 
+
+bool S57::Object::canPaint(quint32 scale) const {
+  return scale <= m_scamin;
+}
+
 double S57::Object::getSafetyContour(double c0) const {
   for (auto c: *m_contours) {
     if (c >= c0) return c;
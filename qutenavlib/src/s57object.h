@@ -24,6 +24,7 @@
 #include "types.h"
 #include "geoprojection.h"
 #include <functional>
+#include <limits>
 
 namespace KV {class Region;}
 
@@ -272,6 +273,8 @@ public:
     , m_geometry(nullptr)
     , m_others(nullptr)
     , m_contours(nullptr)
+    , m_scamin(std::numeric_limits<quint32>::max())
+    , m_dated(false)
   {}
 
   ~Object();
@@ -304,6 +307,20 @@ private:
 
   void decode(QDataStream& stream);
 
+  // Decodes SCAMIN and the date attributes for canPaint. Called once
+  // the attributes are complete.
+  void decodeValidity();
+
+  struct DateLimit {
+    enum class Kind: quint8 {None, Absolute, Yearly, Invalid};
+    Kind kind = Kind::None;
+    qint64 value = 0; // julian day or month * 32 + day
+  };
+
+  static DateLimit ParseDateLimit(const QString& s, bool start);
+  static bool Started(const DateLimit& d, qint64 jd, int md);
+  static bool Ended(const DateLimit& d, qint64 jd, int md);
+
   // shortcuts to find SCAMIN and date attribute values. From s57attributes.csv.
   static const int scaminIndex = 133;
   static const int datstaIndex = 86;
@@ -319,6 +336,12 @@ private:
   LocationHash* m_others;
   ContourVector* m_contours;
   ObjectVector m_underlings;
+  quint32 m_scamin;
+  bool m_dated;
+  DateLimit m_dateStart;
+  DateLimit m_dateEnd;
+  DateLimit m_periodStart;
+  DateLimit m_periodEnd;
 
 };
 
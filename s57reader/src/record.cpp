@@ -21,318 +21,179 @@
  */
 #include "record.h"
 #include "logging.h"
-#include <QDataStream>
-#include <QPointF>
 #include "s52names.h"
+#include <QStringList>
 
-QString read_string(QDataStream& stream, int n) {
-
-  QByteArray bytes;
-  bytes.resize(n);
-  stream.readRawData(bytes.data(), n);
-  return bytes;
+S57::Record::Type S57::Record::type() const {
+  if (m_count == 0 || m_fields[0].len < 1) return Type();
+  return Type(static_cast<quint8>(m_fields[0].data[0]));
 }
 
-QByteArray read_bytes_until(QDataStream& stream, quint8 term, int& len) {
-
-  quint8 byte;
-  stream >> byte;
-  len = 1;
-  QByteArray bytes;
-  while (byte != term) {
-    bytes.append(byte);
-    stream >> byte;
-    len++;
-  }
-  return bytes;
+quint32 S57::Record::id() const {
+  if (m_count == 0) return 0;
+  FieldReader reader(m_fields[0]);
+  reader.skip(1);
+  return reader.read<quint32>();
 }
 
-QByteArray read_remaining(QDataStream& stream) {
-
-  QByteArray bytes;
-  quint8 byte;
-  while (!stream.atEnd()) {
-    stream >> byte;
-    bytes.append(byte);
+const S57::Field* S57::Record::find(const QLatin1String& tag) const {
+  for (int i = 1; i < m_count; i++) {
+    if (m_fields[i].tag == tag) return &m_fields[i];
   }
-  return bytes;
+  return nullptr;
 }
 
-
-#define CASE(NAME) if (name == #NAME) return new NAME(bytes)
-
-S57::Record* S57::Record::Create(const QString &name, const QByteArray &bytes,
-                                 LexLevel::palette attfLevel, LexLevel::palette natfLevel) {
-  CASE(DSID);
-  CASE(DSSI);
-  CASE(DSPM);
-  CASE(VRID);
-  CASE(VRPC);
-  CASE(SGCC);
-  CASE(SG2D);
-  CASE(SG3D);
-  CASE(VRPT);
-  CASE(FRID);
-  CASE(FOID);
-  CASE(ATTV);
-  CASE(FSPT);
-  CASE(FSPC);
-  CASE(FFPT);
-  CASE(FFPC);
-
-  if (name == "ATTF") {
-    return new ATTF(bytes, attfLevel);
-  }
-
-  if (name == "NATF") {
-    return new NATF(bytes, natfLevel);
+QString S57::Record::records() const {
+  QStringList names;
+  for (int i = 0; i < m_count; i++) {
+    names << m_fields[i].tag;
   }
-
-  qCDebug(CENC) << name;
-  Q_ASSERT(false);
-  return nullptr;
+  return names.join("->");
 }
 
-const S57::Record* S57::Record::find(const QString &name) const {
-  auto item = next;
-  while (item != nullptr && item->name() != name) {
-    item = item->next;
+void S57::Record::append(const Field& field) {
+  if (m_count == m_fields.size()) {
+    m_fields.append(field);
+  } else {
+    m_fields[m_count] = field;
   }
-  return item;
+  m_count++;
 }
 
-QString S57::Record::records() const {
-  auto names = name();
-  auto item = next;
-  while (item != nullptr) {
-    names += "->" + item->name();
-    item = item->next;
-  }
-  return names;
+QByteArray S57::FieldReader::until(quint8 term) {
+  const char* p = m_ptr;
+  while (p < m_end && static_cast<quint8>(*p) != term) p++;
+  const QByteArray bytes = QByteArray::fromRawData(m_ptr, p - m_ptr);
+  m_ptr = p < m_end ? p + 1 : m_end;
+  return bytes;
 }
 
-void S57::Record::decodeName(QDataStream& stream) {
-  m_type = Type(read_value<quint8>(stream));
-  m_id = read_value<quint32>(stream);
-  // qCDebug(CENC) << m_type.print() << m_id;
+static QDate ReadDate(S57::FieldReader& reader) {
+  char date[8];
+  for (char& c: date) c = reader.read<quint8>();
+  return QDate::fromString(QString::fromLatin1(date, 8), "yyyyMMdd");
 }
 
-S57::DSID::DSID(const QByteArray& bytes): Record("DSID") {
-  QDataStream stream(bytes);
-  stream.setByteOrder(QDataStream::LittleEndian);
-  decodeName(stream);
-  int len;
+S57::DSID::DSID(const Field& f) {
+  FieldReader reader(f);
+  // record name
+  reader.skip(5);
   // expp, intu, dsnm, edtn, updn
-  exPurp = ExPurp(read_value<quint8>(stream));
-  // qCDebug(CENC) << exPurp.print();
-  read_value<quint8>(stream);
-  read_bytes_until(stream, unitTerminator, len);
-  read_bytes_until(stream, unitTerminator, len);
-  read_bytes_until(stream, unitTerminator, len);
+  exPurp = Record::ExPurp(reader.read<quint8>());
+  reader.skip(1);
+  reader.until(Record::unitTerminator);
+  reader.until(Record::unitTerminator);
+  reader.until(Record::unitTerminator);
   // uadt, isdt
-  updated = QDate::fromString(read_string(stream, 8), "yyyyMMdd");
-  // qCDebug(CENC) << updated;
-  issued = QDate::fromString(read_string(stream, 8), "yyyyMMdd");
-  // qCDebug(CENC) << issued;
-  // edition number, prsp, psdn, pred, prof, agen, comment
-  read_string(stream, 4);
-  prodSpec = ProdSpec(read_value<quint8>(stream));
-  // qCDebug(CENC) << prodSpec.print();
-  read_bytes_until(stream, unitTerminator, len);
-  read_bytes_until(stream, unitTerminator, len);
-  read_value<quint8>(stream);
-  read_value<quint16>(stream);
-  read_bytes_until(stream, unitTerminator, len);
+  updated = ReadDate(reader);
+  issued = ReadDate(reader);
+  // edition number, prsp
+  reader.skip(4);
+  prodSpec = Record::ProdSpec(reader.read<quint8>());
 }
 
-
-S57::DSSI::DSSI(const QByteArray& bytes): Record("DSSI") {
-  QDataStream stream(bytes);
-  stream.setByteOrder(QDataStream::LittleEndian);
-  topology = Topology(read_value<quint8>(stream));
-  // qCDebug(CENC) << topology.print();
-  attfLevel = LexLevel(read_value<quint8>(stream));
-  // qCDebug(CENC) << attfLevel.print();
-  natfLevel = LexLevel(read_value<quint8>(stream));
-  // qCDebug(CENC) << nttfLevel.print();
-
-  // numbers of meta, carto, geo, collection, isolated, connected, edge, face
-
-  numMeta = read_value<quint32>(stream);
-  numCartographic = read_value<quint32>(stream);
-  numGeo = read_value<quint32>(stream);
-
-  numCollection = read_value<quint32>(stream);
-  numIsolated = read_value<quint32>(stream);
-  numConnected = read_value<quint32>(stream);
-
-  numEdge = read_value<quint32>(stream);
-  numFace = read_value<quint32>(stream);
+S57::DSSI::DSSI(const Field& f) {
+  FieldReader reader(f);
+  topology = Record::Topology(reader.read<quint8>());
+  attfLevel = Record::LexLevel(reader.read<quint8>());
+  natfLevel = Record::LexLevel(reader.read<quint8>());
 }
 
-
-S57::DSPM::DSPM(const QByteArray& bytes): Record("DSPM") {
-  QDataStream stream(bytes);
-  stream.setByteOrder(QDataStream::LittleEndian);
-  decodeName(stream);
-  // datums
-  attributes[S52::FindCIndex("HORDAT")] = S57::Attribute(read_value<quint8>(stream));
-  attributes[S52::FindCIndex("VERDAT")] = S57::Attribute(read_value<quint8>(stream));
-  // sounding datum = vertical datum
-  stream.skipRawData(1);
-  scale = read_value<quint32>(stream);
-  attributes[S52::FindCIndex("DUNITS")] = S57::Attribute(read_value<quint8>(stream));
-  attributes[S52::FindCIndex("HUNITS")] = S57::Attribute(read_value<quint8>(stream));
-  attributes[S52::FindCIndex("PUNITS")] = S57::Attribute(read_value<quint8>(stream));
-  units = Units(read_value<quint8>(stream));
-  // qCDebug(CENC) << units.print();
-  coordFactor = read_value<quint32>(stream);
-  soundingFactor = read_value<quint32>(stream);
-
-  int len;
-  const QString comment = read_bytes_until(stream, unitTerminator, len);
-  if (!comment.isEmpty()) qCDebug(CENC) << "DSPM: comment" << comment;
-
-  //  for (S57::AttributeMap::const_iterator it = attributes.cbegin();
-  //       it != attributes.cend(); ++it) {
-  //    qCDebug(CENC) << S52::GetAttributeDescription(it.key()) << "=" <<
-  //                S52::GetAttributeValueDescription(it.key(), it.value().value());
-  //  }
+S57::DSPM::DSPM(const Field& f) {
+  FieldReader reader(f);
+  // record name, horizontal, vertical and sounding datums
+  reader.skip(8);
+  scale = reader.read<quint32>();
+  // depth, height and positional accuracy units
+  reader.skip(3);
+  units = Record::Units(reader.read<quint8>());
+  coordFactor = reader.read<quint32>();
+  soundingFactor = reader.read<quint32>();
 }
 
-S57::VRID::VRID(const QByteArray& bytes): Record("VRID") {
-  QDataStream stream(bytes);
-  stream.setByteOrder(QDataStream::LittleEndian);
-  decodeName(stream);
-  version = read_value<quint16>(stream);
-  instruction = UpdateInstr(read_value<quint8>(stream));
-  // qCDebug(CENC) << m_type.print() << instruction.print();
+S57::VRID::VRID(const Field& f) {
+  FieldReader reader(f);
+  reader.skip(5);
+  version = reader.read<quint16>();
+  instruction = Record::UpdateInstr(reader.read<quint8>());
 }
 
-S57::VRPC::VRPC(const QByteArray& bytes): Record("VRPC") {
-  QDataStream stream(bytes);
-  stream.setByteOrder(QDataStream::LittleEndian);
-  instruction = UpdateInstr(read_value<quint8>(stream));
-  first = read_value<quint16>(stream);
-  count = read_value<quint16>(stream);
-  // qCDebug(CENC) << instruction.print() << first << count;
+S57::UpdateControl::UpdateControl(const Field& f) {
+  FieldReader reader(f);
+  instruction = Record::UpdateInstr(reader.read<quint8>());
+  first = reader.read<quint16>();
+  count = reader.read<quint16>();
 }
 
-
-S57::SG2D::SG2D(const QByteArray& bytes): Record("SG2D") {
-  QDataStream stream(bytes);
-  stream.setByteOrder(QDataStream::LittleEndian);
-  int numItems = bytes.length() / 8;
-  while (numItems > 0) {
-    const qreal y = read_value<qint32>(stream);
-    const qreal x = read_value<qint32>(stream);
-    points.append(QPointF(x, y));
-    numItems--;
-  }
-  // qCDebug(CENC) << "SG2D" << points.size();
+S57::VRPT::PointerField S57::VRPT::pointer(int i) const {
+  FieldReader reader(m_field);
+  reader.skip(i * itemLen);
+  PointerField p;
+  p.type = Record::Type(reader.read<quint8>());
+  p.id = reader.read<quint32>();
+  p.orient = Record::Orient(reader.read<quint8>());
+  p.boundary = Record::Boundary(reader.read<quint8>());
+  p.topind = Record::TopInd(reader.read<quint8>());
+  p.usage = Record::Usage(reader.read<quint8>());
+  return p;
 }
 
-S57::SG3D::SG3D(const QByteArray& bytes): Record("SG3D") {
-  QDataStream stream(bytes);
-  stream.setByteOrder(QDataStream::LittleEndian);
-  int numItems = bytes.length() / 12;
-  while (numItems > 0) {
-    const qreal y = read_value<qint32>(stream);
-    const qreal x = read_value<qint32>(stream);
-    float depth = read_value<qint32>(stream);
-    soundings.append(Sounding(x, y, depth));
-    numItems--;
-  }
-  // qCDebug(CENC) << "SG3D" << soundings.size();
+QPointF S57::SG2D::point(int i) const {
+  FieldReader reader(m_field);
+  reader.skip(i * itemLen);
+  const qreal y = reader.read<qint32>();
+  const qreal x = reader.read<qint32>();
+  return QPointF(x, y);
 }
 
-S57::VRPT::VRPT(const QByteArray& bytes): Record("VRPT") {
-  QDataStream stream(bytes);
-  stream.setByteOrder(QDataStream::LittleEndian);
-  int numItems = bytes.length() / 9;
-  while (numItems > 0) {
-    PointerField p;
-    p.type = Type(read_value<quint8>(stream));
-    p.id = read_value<quint32>(stream);
-    p.orient = Orient(read_value<quint8>(stream));
-    p.boundary = Boundary(read_value<quint8>(stream));
-    p.topind = TopInd(read_value<quint8>(stream));
-    p.usage = Usage(read_value<quint8>(stream));
-
-    //    qCDebug(CENC) << p.type.print() << p.id << p.orient.print()
-    //             << p.boundary.print() << p.topind.print() << p.usage.print();
-
-    pointers.append(p);
-
-    numItems--;
+QVector<QPointF> S57::SG2D::points() const {
+  QVector<QPointF> ps;
+  ps.reserve(size());
+  for (int i = 0; i < size(); i++) {
+    ps.append(point(i));
   }
+  return ps;
 }
 
-S57::FSPT::FSPT(const QByteArray& bytes): Record("FSPT") {
-  QDataStream stream(bytes);
-  stream.setByteOrder(QDataStream::LittleEndian);
-  int numItems = bytes.length() / 8;
-  while (numItems > 0) {
-    PointerField p;
-    p.type = Type(read_value<quint8>(stream));
-    p.id = read_value<quint32>(stream);
-    p.orient = Orient(read_value<quint8>(stream));
-    p.boundary = Boundary(read_value<quint8>(stream));
-    p.usage = Usage(read_value<quint8>(stream));
-
-//    qCDebug(CENC) << p.type.print() << p.id << p.orient.print()
-//             << p.boundary.print() << p.usage.print();
-
-    pointers.append(p);
-
-    numItems--;
-  }
+S57::SG3D::Sounding S57::SG3D::sounding(int i) const {
+  FieldReader reader(m_field);
+  reader.skip(i * itemLen);
+  const qreal y = reader.read<qint32>();
+  const qreal x = reader.read<qint32>();
+  const float depth = reader.read<qint32>();
+  return Sounding(x, y, depth);
 }
 
-S57::FSPC::FSPC(const QByteArray& bytes): Record("FSPC") {
-  QDataStream stream(bytes);
-  stream.setByteOrder(QDataStream::LittleEndian);
-  instruction = UpdateInstr(read_value<quint8>(stream));
-  first = read_value<quint16>(stream);
-  count = read_value<quint16>(stream);
-  // qCDebug(CENC) << instruction.print() << first << count;
+QVector<S57::SG3D::Sounding> S57::SG3D::soundings() const {
+  QVector<Sounding> ss;
+  ss.reserve(size());
+  for (int i = 0; i < size(); i++) {
+    ss.append(sounding(i));
+  }
+  return ss;
 }
 
-S57::SGCC::SGCC(const QByteArray& bytes): Record("SGCC") {
-  QDataStream stream(bytes);
-  stream.setByteOrder(QDataStream::LittleEndian);
-  instruction = UpdateInstr(read_value<quint8>(stream));
-  first = read_value<quint16>(stream);
-  count = read_value<quint16>(stream);
-  // qCDebug(CENC) << instruction.print() << first << count;
+S57::FSPT::PointerField S57::FSPT::pointer(int i) const {
+  FieldReader reader(m_field);
+  reader.skip(i * itemLen);
+  PointerField p;
+  p.type = Record::Type(reader.read<quint8>());
+  p.id = reader.read<quint32>();
+  p.orient = Record::Orient(reader.read<quint8>());
+  p.boundary = Record::Boundary(reader.read<quint8>());
+  p.usage = Record::Usage(reader.read<quint8>());
+  return p;
 }
 
-
-S57::FRID::FRID(const QByteArray& bytes): Record("FRID") {
-  QDataStream stream(bytes);
-  stream.setByteOrder(QDataStream::LittleEndian);
-  decodeName(stream);
-  geom = Geometry(read_value<quint8>(stream));
+S57::FRID::FRID(const Field& f) {
+  FieldReader reader(f);
+  reader.skip(5);
+  geom = Record::Geometry(reader.read<quint8>());
   // skip group
-  stream.skipRawData(1);
-  code = read_value<quint16>(stream);
-  version = read_value<quint16>(stream);
-  instruction = UpdateInstr(read_value<quint8>(stream));
-
-  // qCDebug(CENC) << S52::GetClassInfo(code) << geom.print() << instruction.print();
-}
-
-S57::LongName::LongName(QDataStream &stream) {
-  agency = read_value<quint16>(stream);
-  id = read_value<quint32>(stream);
-  subid = read_value<quint16>(stream);
-}
-
-S57::FOID::FOID(const QByteArray& bytes): Record("FOID") {
-  QDataStream stream(bytes);
-  stream.setByteOrder(QDataStream::LittleEndian);
-  id = LongName(stream);
-  // qCDebug(CENC) << id.agency << id.id << id.subid;
+  reader.skip(1);
+  code = reader.read<quint16>();
+  version = reader.read<quint16>();
+  instruction = Record::UpdateInstr(reader.read<quint8>());
 }
 
 using LX = S57::Record::LexLevel::palette;
@@ -363,10 +224,10 @@ S57::Attribute S57::Record::decode_attribute(quint16 acode, const QByteArray& v,
 
     QString s;
     if (level == LX::UCS2) {
-      QDataStream stream(v);
-      stream.setByteOrder(QDataStream::LittleEndian);
       QVector<QChar> unicode;
-      while (!stream.atEnd()) unicode << read_value<quint16>(stream);
+      for (int i = 0; i + 1 < v.size(); i += 2) {
+        unicode << QChar(qFromLittleEndian<quint16>(reinterpret_cast<const uchar*>(v.constData() + i)));
+      }
       s = QString(unicode.constData(), unicode.size());
       qCDebug(CENC) << "LX::UCS2" << s;
     } else {
@@ -396,92 +257,15 @@ S57::Attribute S57::Record::decode_attribute(quint16 acode, const QByteArray& v,
   return S57::Attribute(S57::AttributeType::None);
 }
 
-S57::ATTV::ATTV(const QByteArray& bytes): Record("ATTV") {
-  QDataStream stream(bytes);
-  stream.setByteOrder(QDataStream::LittleEndian);
-  int len;
-  do {
-    auto acode = read_value<quint16>(stream);
-    auto s = read_bytes_until(stream, unitTerminator, len);
-    attributes[acode] = decode_attribute(acode, s, LX::ASCII);
-  } while (!stream.atEnd());
-
-//  for (S57::AttributeMap::const_iterator it = attributes.cbegin();
-//       it != attributes.cend(); ++it) {
-//    qCDebug(CENC) << S52::GetAttributeDescription(it.key()) << "=" <<
-//                S52::GetAttributeValueDescription(it.key(), it.value().value());
-//  }
-}
-
-
-S57::ATTF::ATTF(const QByteArray &bytes, LX lexLevel): Record("ATTF") {
-  QDataStream stream(bytes);
-  stream.setByteOrder(QDataStream::LittleEndian);
-  int len;
-  do {
-    auto acode = read_value<quint16>(stream);
-    auto s = read_bytes_until(stream, unitTerminator, len);
-    attributes[acode] = decode_attribute(acode, s, lexLevel);
-  } while (!stream.atEnd());
-
-  //  for (S57::AttributeMap::const_iterator it = attributes.cbegin();
-  //       it != attributes.cend(); ++it) {
-  //    qCDebug(CENC) << S52::GetAttributeDescription(it.key()) << "=" <<
-  //                S52::GetAttributeValueDescription(it.key(), it.value().value());
-  //  }
-}
-
-
-S57::NATF::NATF(const QByteArray& bytes, LX lexLevel): Record("NATF") {
-  QDataStream stream(bytes);
-  stream.setByteOrder(QDataStream::LittleEndian);
-  int len;
-  do {
-    auto acode = read_value<quint16>(stream);
-    auto s = read_bytes_until(stream, unitTerminator, len);
+void S57::DecodeAttributes(AttributeMap& attrs, const Field& f, LX lexLevel) {
+  FieldReader reader(f);
+  while (!reader.atEnd()) {
+    const auto acode = reader.read<quint16>();
+    const QByteArray v = reader.until(Record::unitTerminator);
     if (lexLevel == LX::UCS2) {
-      quint8 term;
-      stream >> term;
-      Q_ASSERT(term == 0x00);
+      // UCS-2 unit terminator is followed by a zero byte
+      reader.skip(1);
     }
-    attributes[acode] = decode_attribute(acode, s, lexLevel);
-  } while (!stream.atEnd());
-
-  //  for (S57::AttributeMap::const_iterator it = attributes.cbegin();
-  //       it != attributes.cend(); ++it) {
-  //    qCDebug(CENC) << S52::GetAttributeDescription(it.key()) << "=" <<
-  //                S52::GetAttributeValueDescription(it.key(), it.value().value());
-  //  }
-}
-
-S57::FFPT::FFPT(const QByteArray& bytes): Record("FFPT") {
-  QDataStream stream(bytes);
-  stream.setByteOrder(QDataStream::LittleEndian);
-  int len;
-  do {
-    auto id = LongName(stream);
-    auto rel = Relation(read_value<quint8>(stream));
-
-    const QString comment = read_bytes_until(stream, unitTerminator, len);
-    if (!comment.isEmpty()) qCDebug(CENC) << "FFPT: comment:" << comment;
-
-    pointers.append(PointerField(id, rel));
-
-  } while (!stream.atEnd());
-
-//  for (const PointerField& pf: pointers) {
-//    qCDebug(CENC) << pf.id.agency << pf.id.id << pf.id.subid << pf.relation.print();
-//  }
-}
-
-S57::FFPC::FFPC(const QByteArray& bytes): Record("FFPC") {
-  QDataStream stream(bytes);
-  stream.setByteOrder(QDataStream::LittleEndian);
-  instruction = UpdateInstr(read_value<quint8>(stream));
-  first = read_value<quint16>(stream);
-  count = read_value<quint16>(stream);
-  // qCDebug(CENC) << instruction.print() << first << count;
+    attrs[acode] = Record::decode_attribute(acode, v, lexLevel);
+  }
 }
-
-
-
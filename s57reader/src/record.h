@@ -23,17 +23,34 @@
 
 #include <QString>
 #include <QVector>
-#include <QDataStream>
 #include <QMap>
 #include <QDate>
+#include <QPointF>
+#include <QtEndian>
 #include "s57object.h"
 
 #define NAMER(X) {X, #X}
 
 namespace S57 {
 
-class Record;
+// A field of an ISO/IEC 8211 data record: a view to the record data
+// without the field terminator.
+struct Field {
+  Field() = default;
+  Field(const char* t, const char* d, int l)
+    : tag(t, 4)
+    , data(d)
+    , len(l) {}
+
+  QLatin1String tag;
+  const char* data;
+  int len;
+};
 
+//
+// The data fields of an ISO/IEC 8211 data record. The first field names
+// the record.
+//
 class Record {
 public:
 
@@ -182,139 +199,159 @@ public:
     palette value;
   };
 
-  static Record* Create(const QString& name, const QByteArray& bytes,
-                        LexLevel::palette attfLevel, LexLevel::palette natfLevel);
+  Record()
+    : m_count(0) {}
 
-  const QString& name() const {return m_name;}
-  const Type& type() const {return m_type;}
-  quint32 id() const {return m_id;}
+  // the first field names the record
+  const Field& first() const {return m_fields[0];}
+  Type type() const;
+  quint32 id() const;
 
-  const Record* find(const QString& name) const;
+  // the field following the first field with the given tag, or nullptr
+  const Field* find(const QLatin1String& tag) const;
 
   QString records() const;
 
-  Record* next;
-
-  virtual ~Record() {delete next;}
+  // fields are reused from record to record
+  void clear() {m_count = 0;}
+  void append(const Field& field);
 
-protected:
+  static S57::Attribute decode_attribute(quint16 acode, const QByteArray& v, LexLevel::palette level);
 
   static const quint8 unitTerminator = 0x1f;
   static const quint8 attributeDeleter = 0x7f;
 
-  Record(const QString& name)
-    : next(nullptr)
-    , m_name(name)
-    , m_type()
-    , m_id(0)
-  {}
+private:
 
-  void decodeName(QDataStream& stream);
+  QVector<Field> m_fields;
+  int m_count;
 
-  static S57::Attribute decode_attribute(quint16 acode, const QByteArray& v, LexLevel::palette level);
+};
+
+//
+// Reads little endian values and unit terminated strings in place.
+// Reading past the end of the field returns zeros like QDataStream does.
+//
+class FieldReader {
+public:
+
+  FieldReader(const Field& f)
+    : m_ptr(f.data)
+    , m_end(f.data + f.len) {}
 
+  template<typename T> T read() {
+    if (m_end - m_ptr < static_cast<int>(sizeof(T))) {
+      m_ptr = m_end;
+      return 0;
+    }
+    const T v = qFromLittleEndian<T>(reinterpret_cast<const uchar*>(m_ptr));
+    m_ptr += sizeof(T);
+    return v;
+  }
 
-protected:
+  void skip(int n) {m_ptr += qMin<qint64>(n, m_end - m_ptr);}
 
-  QString m_name;
-  Type m_type;
-  quint32 m_id;
+  // view to the bytes up to the terminator, which is skipped
+  QByteArray until(quint8 term);
 
+  bool atEnd() const {return m_ptr >= m_end;}
+
+private:
+
+  const char* m_ptr;
+  const char* m_end;
 };
 
+//
+// Field decoders. These are stack values decoding their field in place,
+// arrays are decoded on access.
+//
 
-class DSID: public Record {
+class DSID {
 public:
-  DSID(const QByteArray& bytes);
-  ExPurp exPurp;
+  DSID(const Field& f);
+  Record::ExPurp exPurp;
   QDate updated;
   QDate issued;
-  ProdSpec prodSpec;
+  Record::ProdSpec prodSpec;
 };
 
-class DSSI: public Record {
+class DSSI {
 public:
-  DSSI(const QByteArray& bytes);
-  Topology topology;
-  LexLevel attfLevel;
-  LexLevel natfLevel;
-  quint32 numMeta;
-  quint32 numCartographic;
-  quint32 numGeo;
-  quint32 numCollection;
-  quint32 numIsolated;
-  quint32 numConnected;
-  quint32 numEdge;
-  quint32 numFace;
+  DSSI(const Field& f);
+  Record::Topology topology;
+  Record::LexLevel attfLevel;
+  Record::LexLevel natfLevel;
 };
 
-class DSPM: public Record {
+class DSPM {
 public:
-  DSPM(const QByteArray& bytes);
-  S57::AttributeMap attributes;
+  DSPM(const Field& f);
   quint32 scale;
-  Units units;
+  Record::Units units;
   quint32 coordFactor;
   quint32 soundingFactor;
 };
 
-class VRID: public Record {
+class VRID {
 public:
-  VRID(const QByteArray& bytes);
-  UpdateInstr instruction;
+  VRID(const Field& f);
   quint16 version;
+  Record::UpdateInstr instruction;
 };
 
-class VRPC: public Record {
+// VRPC, SGCC and FSPC
+class UpdateControl {
 public:
-  VRPC(const QByteArray& bytes);
-  UpdateInstr instruction;
+  UpdateControl(const Field& f);
+  Record::UpdateInstr instruction;
   quint16 first;
   quint16 count;
 };
 
+using VRPC = UpdateControl;
+using SGCC = UpdateControl;
+using FSPC = UpdateControl;
 
-class ATTV: public Record {
-public:
-  ATTV(const QByteArray& bytes);
-  S57::AttributeMap attributes;
-};
-
-class VRPT: public Record {
+class VRPT {
 public:
 
   struct PointerField {
     PointerField() = default;
-    Type type;
+    Record::Type type;
     quint32 id;
-    Orient orient;
-    Boundary boundary;
-    TopInd topind;
-    Usage usage;
+    Record::Orient orient;
+    Record::Boundary boundary;
+    Record::TopInd topind;
+    Record::Usage usage;
   };
 
-  VRPT(const QByteArray& bytes);
+  VRPT(const Field& f)
+    : m_field(f) {}
+
+  int size() const {return m_field.len / itemLen;}
+  PointerField pointer(int i) const;
 
-  QVector<PointerField> pointers;
+private:
+  static const int itemLen = 9;
+  const Field& m_field;
 };
 
-class SGCC: public Record {
+class SG2D {
 public:
-  SGCC(const QByteArray& bytes);
-  UpdateInstr instruction;
-  quint16 first;
-  quint16 count;
+  SG2D(const Field& f)
+    : m_field(f) {}
 
-};
+  int size() const {return m_field.len / itemLen;}
+  QPointF point(int i) const;
+  QVector<QPointF> points() const;
 
-class SG2D: public Record {
-public:
-  SG2D(const QByteArray& bytes);
-  QVector<QPointF> points;
+private:
+  static const int itemLen = 8;
+  const Field& m_field;
 };
 
-
-class SG3D: public Record {
+class SG3D {
 public:
   struct Sounding {
     Sounding() = default;
@@ -325,120 +362,52 @@ public:
     QPointF location;
     float value;
   };
-  SG3D(const QByteArray& bytes);
-  QVector<Sounding> soundings;
-};
-
-class FRID: public Record {
-public:
-  FRID(const QByteArray& bytes);
-  Geometry geom;
-  quint16 code;
-  quint16 version;
-  UpdateInstr instruction;
-};
-
-struct LongName {
-  LongName() = default;
-  LongName(QDataStream& stream);
-
-  quint16 agency;
-  quint32 id;
-  quint16 subid;
-};
-
-class FOID: public Record {
-public:
-  FOID(const QByteArray& bytes);
-  LongName id;
-};
 
-class ATTF: public Record {
-public:
-  ATTF(const QByteArray& bytes, LexLevel::palette lexLevel);
-  S57::AttributeMap attributes;
-};
-
-class NATF: public Record {
-public:
-  NATF(const QByteArray& bytes, LexLevel::palette lexLevel);
-  S57::AttributeMap attributes;
-};
+  SG3D(const Field& f)
+    : m_field(f) {}
 
-class FFPC: public Record {
-public:
-  FFPC(const QByteArray& bytes);
-  UpdateInstr instruction;
-  quint16 first;
-  quint16 count;
+  int size() const {return m_field.len / itemLen;}
+  Sounding sounding(int i) const;
+  QVector<Sounding> soundings() const;
 
+private:
+  static const int itemLen = 12;
+  const Field& m_field;
 };
 
-class FFPT: public Record {
+class FRID {
 public:
-
-  struct PointerField {
-    PointerField() = default;
-    PointerField(const LongName& i, const Relation& rel)
-      : id(i)
-      , relation(rel) {}
-
-    LongName id;
-    Relation relation;
-  };
-
-  FFPT(const QByteArray& bytes);
-
-  QVector<PointerField> pointers;
+  FRID(const Field& f);
+  Record::Geometry geom;
+  quint16 code;
+  quint16 version;
+  Record::UpdateInstr instruction;
 };
 
-class FSPC: public Record {
-public:
-  FSPC(const QByteArray& bytes);
-  UpdateInstr instruction;
-  quint16 first;
-  quint16 count;
-};
+// decodes ATTF and NATF fields into attrs
+void DecodeAttributes(AttributeMap& attrs, const Field& f, Record::LexLevel::palette lexLevel);
 
-class FSPT: public Record {
+class FSPT {
 public:
   struct PointerField {
     PointerField() = default;
-    Type type;
+    Record::Type type;
     quint32 id;
-    Orient orient;
-    Boundary boundary;
-    Usage usage;
+    Record::Orient orient;
+    Record::Boundary boundary;
+    Record::Usage usage;
   };
 
-  FSPT(const QByteArray& bytes);
+  FSPT(const Field& f)
+    : m_field(f) {}
 
-  QVector<PointerField> pointers;
+  int size() const {return m_field.len / itemLen;}
+  PointerField pointer(int i) const;
 
+private:
+  static const int itemLen = 8;
+  const Field& m_field;
 };
 
 
 } // namespace S57
-
-template<typename T> T read_integer(QDataStream& stream, int n) {
-
-  QByteArray bytes;
-  bytes.resize(n);
-  stream.readRawData(bytes.data(), n);
-
-  return static_cast<T>(bytes.toLong());
-
-}
-
-template<typename T> T read_value(QDataStream& stream) {
-
-  T value;
-  stream >> value;
-
-  return value;
-}
-
-QString read_string(QDataStream& stream, int n);
-QByteArray read_bytes_until(QDataStream& stream, quint8 term, int& len);
-
-
@@ -19,13 +19,12 @@
  */
 #include "s57reader.h"
 #include <QFile>
-#include <QDataStream>
-#include <functional>
 #include <QDate>
 #include "s52names.h"
 #include "record.h"
 #include <QDir>
 #include <QFileInfo>
+#include <QDateTime>
 #include "logging.h"
 
 const GeoProjection* S57Reader::geoprojection() const {
@@ -35,180 +34,154 @@ const GeoProjection* S57Reader::geoprojection() const {
 S57Reader::S57Reader(const QString& name)
   : ChartFileReader(name)
   , m_proj(GeoProjection::CreateProjection("SimpleMercator"))
+  , m_cells(maxCachedCells)
 {}
 
 
 
-struct FieldInfo {
-  FieldInfo() = default;
-  FieldInfo(const QString& t, quint32 l, quint32 p)
-    : tag(t)
-    , len(l)
-    , pos(p) {}
-
-  QString tag;
-  quint32 len;
-  quint32 pos;
-
-};
-
-struct FieldData {
-  FieldData() = default;
-  FieldData(const QString& t, const QByteArray& b)
-    : tag(t)
-    , bytes(b) {}
-
-  QString tag;
-  QByteArray bytes;
-};
-
 using LexLevel = S57::Record::LexLevel::palette;
 
-
+//
+// Reads ISO/IEC 8211 data records from a memory-mapped file. The record
+// fields are views to the mapped data and the record is reused, so that
+// reading a record does not allocate.
+//
 class FieldSource {
 
-  static const quint8 fieldControlLen = 9;
-  static const quint8 fieldTagFieldLen = 4;
   static const quint8 leaderLen = 24;
+  static const quint8 fieldTagLen = 4;
   static const quint8 fieldTerminator = 0x1e;
-  static const quint8 unitTerminator = 0x1f;
 
 public:
-  FieldSource(QFile* file, const QString& path);
-  S57::Record* nextRecord();
-  void setLexicalLevels(LexLevel alevel, LexLevel nlevel) {
-    m_attfLevel = alevel;
-    m_natfLevel = nlevel;
-  }
+  FieldSource(const QString& path);
+  // reads the next data record into rec, returns false at the end
+  bool next(S57::Record& rec);
 
 private:
 
-  using FieldInfoVector = QVector<FieldInfo>;
-  using FieldDataVector = QVector<FieldData>;
+  static quint32 Number(const char* p, int n);
 
-  FieldInfoVector readDirectory(quint32 hlen, quint8 flen, quint8 plen);
-  QDataStream m_stream;
-  QStringList m_tags;
-  LexLevel m_attfLevel;
-  LexLevel m_natfLevel;
+  // reads the record at m_pos into rec and moves to the next record
+  bool readRecord(S57::Record& rec, const QString& path = QString());
+
+  QFile m_file;
+  QByteArray m_buffer; // in case mapping fails
+  const char* m_data;
+  quint32 m_size;
+  quint32 m_pos;
 
 };
 
-S57::Record* FieldSource::nextRecord() {
+quint32 FieldSource::Number(const char* p, int n) {
+  quint32 v = 0;
+  for (int i = 0; i < n; i++) {
+    if (p[i] < '0' || p[i] > '9') continue; // leading spaces
+    v = 10 * v + (p[i] - '0');
+  }
+  return v;
+}
+
+bool FieldSource::readRecord(S57::Record& rec, const QString& path) {
+  rec.clear();
+
+  if (m_pos + leaderLen > m_size) return false;
+
+  const char* leader = m_data + m_pos;
+  quint32 recordLen = Number(leader, 5);
+  const quint32 base = Number(leader + 12, 5);
+  const int flen = Number(leader + 20, 1);
+  const int plen = Number(leader + 21, 1);
+
+  // record length 0 means that the record is longer than 99999 bytes
+  const quint32 maxLen = recordLen == 0 ? m_size - m_pos : recordLen;
 
-  if (m_stream.atEnd()) {
-    return nullptr;
+  if (base <= leaderLen || base > maxLen || flen == 0 || plen == 0 ||
+      m_pos + maxLen > m_size) {
+    if (!path.isEmpty()) {
+      throw ChartFileError(QString("%1 is not a proper S57 chart file").arg(path));
+    }
+    qCWarning(CENC) << "Invalid S57 record at" << m_pos;
+    return false;
   }
-  // read leader
-  m_stream.skipRawData(12); // reclen(5), " D     "
-  auto headerlen = read_integer<quint32>(m_stream, 5);
-  m_stream.skipRawData(3); // "   "
-  auto fieldLenFieldlen = read_integer<quint8>(m_stream, 1);
-  auto fieldPosFieldlen = read_integer<quint8>(m_stream, 1);
-  m_stream.skipRawData(2); // "04"
-  // read directory
-  FieldInfoVector fieldInfo = readDirectory(headerlen, fieldLenFieldlen, fieldPosFieldlen);
-  // decode records
-  // skip ISO/IEC 8211 Record Identifier
-  FieldInfo f0 = fieldInfo.takeFirst();
-  m_stream.skipRawData(f0.len);
-  S57::Record* head = nullptr;
-  S57::Record* p = nullptr;
-  do {
-    FieldInfo f = fieldInfo.takeFirst();
-    // qCDebug(CENC) << "block" << f.tag << f.len - 1 << fieldInfo.size();
-    QByteArray block(f.len - 1, '0');
-    m_stream.readRawData(block.data(), f.len - 1);
-    quint8 term;
-    m_stream >> term;
+
+  const char* fields = leader + base;
+  const int entryLen = fieldTagLen + flen + plen;
+  const int numItems = (base - leaderLen - 1) / entryLen;
+  const char* entry = leader + leaderLen;
+  quint32 end = 0;
+  for (int i = 0; i < numItems; i++, entry += entryLen) {
+    const quint32 len = Number(entry + fieldTagLen, flen);
+    const quint32 pos = Number(entry + fieldTagLen + flen, plen);
+    if (len == 0 || base + pos + len > maxLen) {
+      qCWarning(CENC) << "Invalid S57 field at" << m_pos;
+      return false;
+    }
+    end = qMax(end, pos + len);
+    // skip ISO/IEC 8211 Record Identifier
+    if (i == 0) continue;
+    const char* block = fields + pos;
+    int dlen = len - 1;
+    quint8 term = block[dlen];
     // only NATF can have UCS-2 text
-    if (f.tag == "NATF" && term == 0x00) {
-      term = block.at(block.size() - 1);
-      block.chop(1);
+    if (term == 0x00 && QLatin1String(entry, fieldTagLen) == QLatin1String("NATF")) {
+      dlen -= 1;
+      term = block[dlen];
     }
     Q_ASSERT(term == fieldTerminator);
-    auto rec = S57::Record::Create(f.tag, block, m_attfLevel, m_natfLevel);
-    if (!head) {
-      head = rec;
-      p = head;
-    } else {
-      p->next = rec;
-      p = p->next;
-    }
-  } while (!fieldInfo.isEmpty());
+    rec.append(S57::Field(entry, block, dlen));
+  }
+  Q_ASSERT(static_cast<quint8>(*entry) == fieldTerminator);
+
+  if (recordLen == 0) {
+    recordLen = base + end;
+  }
+  m_pos += recordLen;
 
-  return head;
+  return true;
 }
 
-QVector<FieldInfo> FieldSource::readDirectory(quint32 hlen, quint8 flen, quint8 plen) {
-  int numItems = (hlen - leaderLen - 1) / (fieldTagFieldLen + flen + plen);
-  QVector<FieldInfo> fieldInfo;
-  while (numItems > 0) {
-    auto t = read_string(m_stream, fieldTagFieldLen);
-    auto l = read_integer<quint32>(m_stream, flen);
-    auto p = read_integer<quint32>(m_stream, plen);
-    fieldInfo.append(FieldInfo(t, l, p));
-    numItems--;
-  }
-  quint8 term;
-  m_stream >> term;
-  Q_ASSERT(term == fieldTerminator);
-  return fieldInfo;
+bool FieldSource::next(S57::Record& rec) {
+  return readRecord(rec);
 }
 
-FieldSource::FieldSource(QFile* file, const QString& path)
-  : m_stream(file)
-  , m_attfLevel(LexLevel::N_A)
-  , m_natfLevel(LexLevel::N_A)
+FieldSource::FieldSource(const QString& path)
+  : m_file(path)
+  , m_data(nullptr)
+  , m_size(0)
+  , m_pos(0)
 {
-  // read leader
-  m_stream.skipRawData(5); // reclen
-  auto magic = read_string(m_stream, 7);
-  if (magic != "3LE1 09") {
-    throw ChartFileError(QString("%1 is not a proper S57 chart file").arg(path));
+  if (!m_file.open(QFile::ReadOnly)) {
+    throw ChartFileError(QString("Cannot open %1 for reading").arg(path));
   }
-  auto headerlen = read_integer<quint32>(m_stream, 5);
-  m_stream.skipRawData(3); // " ! "
-  auto fieldLenFieldlen = read_integer<quint8>(m_stream, 1);
-  auto fieldPosFieldlen = read_integer<quint8>(m_stream, 1);
-  m_stream.skipRawData(2); // "04"
-  // read directory
-  FieldInfoVector fieldInfo = readDirectory(headerlen, fieldLenFieldlen, fieldPosFieldlen);
-  // read field control field
-  FieldInfo info = fieldInfo.takeFirst();
-  m_stream.skipRawData(10); // "0000;&-A ", 0x1f
-  int numTagPairs = (info.len - 11) / 8;
-  for (int i = 0; i < numTagPairs; i++) {
-    m_tags << read_string(m_stream, 4) << read_string(m_stream, 4);
+  m_size = m_file.size();
+  m_data = reinterpret_cast<const char*>(m_file.map(0, m_size));
+  if (m_data == nullptr) {
+    m_buffer = m_file.readAll();
+    m_data = m_buffer.constData();
   }
-  quint8 term;
-  m_stream >> term;
-  Q_ASSERT(term == fieldTerminator);
-  // read data descriptive fields
-  for (int i = 0; i < fieldInfo.size(); i++) {
-    m_stream.skipRawData(1); // structureCode
-    auto typeCode = read_integer<quint8>(m_stream, 1);
-    Q_ASSERT(typeCode == 5 || typeCode == 6); // mixed or binary
-    m_stream.skipRawData(7); // "00;&-A "
-    int len;
-    read_bytes_until(m_stream, unitTerminator, len); // fieldName
-    read_bytes_until(m_stream, unitTerminator, len); // arrayDescr
-    read_bytes_until(m_stream, fieldTerminator, len); // fmtControls
+
+  // data descriptive record: the field control field and the data
+  // descriptive fields are not needed
+  if (m_size < leaderLen || QByteArray::fromRawData(m_data + 5, 7) != "3LE1 09") {
+    throw ChartFileError(QString("%1 is not a proper S57 chart file").arg(path));
+  }
+  S57::Record ddr;
+  if (!readRecord(ddr, path)) {
+    throw ChartFileError(QString("%1 is not a proper S57 chart file").arg(path));
   }
 }
 
-using HandlerFunc = std::function<bool (const S57::Record*)>;
-
-struct Handler {
-  Handler(HandlerFunc f): func(std::move(f)) {}
-  HandlerFunc func;
-  ~Handler() = default;
-};
-
+using RT = S57::Record::Type::palette;
 
+// Feeds the records to handle until it returns false. The record is
+// reused, handle must not keep references to its fields.
+template<typename Handler>
+static void ReadRecords(FieldSource& source, Handler handle) {
+  S57::Record rec;
+  while (source.next(rec) && handle(rec)) {}
+}
 
 using Region = S57ChartOutline::Region;
-using RT = S57::Record::Type::palette;
 using Purp = S57::Record::ExPurp::palette;
 using Topo = S57::Record::Topology::palette;
 using Units = S57::Record::Units::palette;
@@ -218,371 +191,473 @@ using TopInd = S57::Record::TopInd::palette;
 using Boundary = S57::Record::Boundary::palette;
 using Geom = S57::Record::Geometry::palette;
 
-GeoProjection* S57Reader::configuredProjection(const QString& path) const {
+//
+// The base cell with all its updates applied. Projection, outline and
+// chart geometry are all derived from the same parsed cell.
+//
+struct S57Reader::Cell {
 
-  QFile file(path);
-  if (!file.open(QFile::ReadOnly)) {
-    throw ChartFileError(QString("Cannot open %1 for reading").arg(path));
-  }
-
-  FieldSource source(&file, path);
+  using SoundingVector = QVector<S57::SG3D::Sounding>;
+  using SoundingMap = QMap<quint32, SoundingVector>;
 
+  QDate pub;
+  QDate mod;
+  quint32 scale = 0;
+  quint32 mulfac = 0;
+  // first isolated or connected node of the base cell
   WGS84Point ref;
-  quint32 mulfac;
-
-  const QMap<RT, Handler*> handlers {
-
-
-    {RT::DS, new Handler([] (const S57::Record*) {
-        return true;
-      })
-    },
-
-    {RT::DP, new Handler([&mulfac] (const S57::Record* rec) {
-        auto dspm = dynamic_cast<const S57::DSPM*>(rec);
-        mulfac = dspm->coordFactor;
-        return true;
-      })
-    },
-
-    {RT::VI, new Handler([&ref, &mulfac] (const S57::Record* rec) {
-        auto vrid = dynamic_cast<const S57::VRID*>(rec);
-        if (vrid->instruction.value != Instr::Insert) {
-          return true;
-        }
-        auto sg2d = dynamic_cast<const S57::SG2D*>(vrid->find("SG2D"));
-        if (sg2d != nullptr && !sg2d->points.isEmpty()) {
-          const auto p0 = sg2d->points.first() / mulfac;
-          ref = WGS84Point::fromLL(p0.x(), p0.y());
-          return false;
-        }
-        auto sg3d = dynamic_cast<const S57::SG3D*>(vrid->find("SG3D"));
-        if (sg3d != nullptr && !sg3d->soundings.isEmpty()) {
-          const auto p0 = sg3d->soundings.first().location / mulfac;
-          ref = WGS84Point::fromLL(p0.x(), p0.y());
-          return false;
-        }
-        return true;
-      })
-    },
-
-    {RT::VC, new Handler([&ref, &mulfac] (const S57::Record* rec) {
-        auto vrid = dynamic_cast<const S57::VRID*>(rec);
-        if (vrid->instruction.value != Instr::Insert) {
-          return true;
-        }
-        auto sg2d = dynamic_cast<const S57::SG2D*>(vrid->find("SG2D"));
-        const auto p0 = sg2d->points.first() / mulfac;
-        ref = WGS84Point::fromLL(p0.x(), p0.y());
-        return false;
-      })
-    },
 
-    {RT::VE, new Handler([] (const S57::Record*) {
-        return true;
-      })
-    },
-
-    {RT::FE, new Handler([] (const S57::Record*) {
-        return true;
-      })
-    },
+  PointMap isolated;
+  PointMap connected;
+  SoundingMap soundings;
+  RawEdgeMap edges;
+  RawObjectMap features;
+};
 
+S57Reader::CellPtr S57Reader::parsedCell(const QString& path) const {
 
-  };
+  QFileInfo info(path);
+  QString filter = QString("%1.[0-9][0-9][0-9]").arg(info.baseName());
+  QDir dir(info.path());
+  auto updates = dir.entryInfoList(QStringList {filter}, QDir::Files | QDir::Readable, QDir::Name);
+  if (updates.isEmpty()) {
+    throw ChartFileError(QString("%1 not found").arg(path));
+  }
+  if (updates.first().fileName() != info.fileName()) {
+    throw ChartFileError(QString("%1 is not a proper S57 chart file").arg(path));
+  }
 
-  bool done = false;
+  // the cell is reparsed if any of its update files is added, removed or changed
+  QString fingerprint;
+  for (const QFileInfo& update: updates) {
+    fingerprint += QString("%1:%2:%3;")
+        .arg(update.fileName())
+        .arg(update.size())
+        .arg(update.lastModified().toMSecsSinceEpoch());
+  }
 
-  while (!done) {
-    S57::Record* rec = source.nextRecord();
-    if (!rec) {
-      done = true;
-    } else {
-      if (!handlers.contains(rec->type().value)) {
-        done = true;
-      } else {
-        done = !(handlers[rec->type().value])->func(rec);
-      }
-      delete rec;
+  const QString key = info.absoluteFilePath();
+  {
+    QMutexLocker lock(&m_cellMutex);
+    auto cached = m_cells.object(key);
+    if (cached != nullptr && cached->fingerprint == fingerprint) {
+      return cached->cell;
     }
   }
 
-  qDeleteAll(handlers);
-  if (!ref.valid()) {
-    throw ChartFileError(QString("Invalid S57 header in %1").arg(path));
-  }
+  auto parsed = parseCell(updates);
 
-  auto gp = GeoProjection::CreateProjection(m_proj->className());
-  gp->setReference(ref);
-  return gp;
+  QMutexLocker lock(&m_cellMutex);
+  m_cells.insert(key, new CachedCell {fingerprint, parsed});
+
+  return parsed;
 }
 
+S57Reader::CellPtr S57Reader::parseCell(const QFileInfoList& updates) const {
 
-S57ChartOutline S57Reader::readOutline(const QString& path, const GeoProjection* gp) const {
+  auto cell = QSharedPointer<Cell>::create();
 
-  QDate pub;
-  QDate mod;
-  quint32 scale = 0;
-  quint32 mulfac = 0;
+  bool hasRef = false;
+  QPointF refPoint;
+  LexLevel attfLevel = LexLevel::N_A;
+  LexLevel natfLevel = LexLevel::N_A;
 
-  const quint32 m_covr = S52::FindCIndex("M_COVR");
-  const quint32 catcov = S52::FindCIndex("CATCOV");
-  bool inCov = false;
-
-  RawEdgeMap edges;
-  PointMap connected;
-  CovEdgeRefMap covRefs;
+  auto handleDS = [cell, &attfLevel, &natfLevel] (const S57::Record& rec) {
+    const S57::DSID dsid(rec.first());
+    if (dsid.issued.isValid()) {
+      cell->mod = dsid.issued;
+    }
+    if (dsid.updated.isValid()) {
+      cell->pub = dsid.updated;
+    }
+    auto dssi = rec.find(QLatin1String("DSSI"));
+    if (dssi != nullptr) {
+      const S57::DSSI d(*dssi);
+      attfLevel = d.attfLevel.value;
+      natfLevel = d.natfLevel.value;
+    }
+    return true;
+  };
 
-  const QMap<RT, Handler*> handlers {
+  auto handleDP = [cell] (const S57::Record& rec) {
+    const S57::DSPM dspm(rec.first());
+    if (dspm.scale != 0) {
+      cell->scale = dspm.scale;
+    }
+    if (dspm.coordFactor != 0) {
+      cell->mulfac = dspm.coordFactor;
+    }
+    return true;
+  };
 
-    {RT::DS, new Handler([&pub, &mod] (const S57::Record* rec) {
-        auto dsid = dynamic_cast<const S57::DSID*>(rec);
-        if (dsid->issued.isValid()) {
-          mod = dsid->issued;
-        }
-        if (dsid->updated.isValid()) {
-          pub = dsid->updated;
-        }
+  auto handleVI = [cell, &hasRef, &refPoint] (const S57::Record& rec) {
+    auto& isolated = cell->isolated;
+    auto& soundings = cell->soundings;
+    const S57::VRID vrid(rec.first());
+    const quint32 id = rec.id();
+    if (vrid.instruction.value == Instr::Delete) {
+      if (isolated.contains(id)) {
+        // qCDebug(CENC) << "removing isolated node" << id;
+        isolated.remove(id);
         return true;
-      })
-    },
-
-    {RT::DP, new Handler([&scale, &mulfac] (const S57::Record* rec) {
-        auto dspm = dynamic_cast<const S57::DSPM*>(rec);
-        if (dspm->scale != 0) {
-          scale = dspm->scale;
+      }
+      if (soundings.contains(id)) {
+        // qCDebug(CENC) << "removing soundings node" << id;
+        soundings.remove(id);
+        return true;
+      }
+      Q_ASSERT(false);
+    }
+    if (vrid.instruction.value == Instr::Insert) {
+      auto sg2dField = rec.find(QLatin1String("SG2D"));
+      if (sg2dField != nullptr) {
+        const S57::SG2D sg2d(*sg2dField);
+        Q_ASSERT(sg2d.size() == 1);
+        isolated[id] = sg2d.point(0);
+        if (!hasRef) {
+          refPoint = sg2d.point(0);
+          hasRef = true;
         }
-        if (dspm->coordFactor != 0) {
-          mulfac = dspm->coordFactor;
+        return true;
+      }
+      auto sg3dField = rec.find(QLatin1String("SG3D"));
+      if (sg3dField != nullptr) {
+        // qCDebug(CENC) << "inserting soundings node" << id;
+        const S57::SG3D sg3d(*sg3dField);
+        soundings[id] = sg3d.soundings();
+        if (!hasRef && sg3d.size() > 0) {
+          refPoint = sg3d.sounding(0).location;
+          hasRef = true;
         }
         return true;
-      })
-    },
+      }
+      Q_ASSERT(false);
+    }
+    // Modify
+    auto sgccField = rec.find(QLatin1String("SGCC"));
+    if (sgccField == nullptr) {
+      // cannot continue without sgcc
+      qCWarning(CENC) << "SGCC not found" << rec.records();
+      return true;
+    }
+    const S57::SGCC sgcc(*sgccField);
+    if (sgcc.instruction.value == Instr::Delete) {
+      Q_ASSERT(soundings.contains(id));
+      // qCDebug(CENC) << "removing soundings nodes" << id;
+      soundings[id].remove(sgcc.first - 1, sgcc.count);
+      return true;
+    }
+    if (sgcc.instruction.value == Instr::Insert) {
+      Q_ASSERT(soundings.contains(id));
+      // qCDebug(CENC) << "inserting soundings nodes" << id;
+      const S57::SG3D sg3d(*rec.find(QLatin1String("SG3D")));
+      for (int i = 0; i < sgcc.count; i++) {
+        soundings[id].insert(sgcc.first - 1, sg3d.sounding(sgcc.count - 1 - i));
+      }
+      return true;
+    }
+    // Modify
+    if (soundings.contains(id)) {
+      const S57::SG3D sg3d(*rec.find(QLatin1String("SG3D")));
+      for (int i = 0; i < sgcc.count; i++) {
+        soundings[id][sgcc.first - 1 + i] = sg3d.sounding(i);
+      }
+    } else {
+      Q_ASSERT(sgcc.first == 1 && sgcc.count == 1);
+      const S57::SG2D sg2d(*rec.find(QLatin1String("SG2D")));
+      isolated[id] = sg2d.point(0);
+    }
+    return true;
+  };
 
-    {RT::VI, new Handler([] (const S57::Record*) {
-        // skip isolated points
-        return true;
-      })
-    },
-
-    {RT::VC, new Handler([&connected] (const S57::Record* rec) {
-        auto vrid = dynamic_cast<const S57::VRID*>(rec);
-        if (vrid->instruction.value == Instr::Delete) {
-          // qCDebug(CENC) << "removing connected node" << vrid->id();
-          connected.remove(vrid->id());
-          return true;
-        }
-        if (vrid->instruction.value == Instr::Insert) {
-          auto sg2d = dynamic_cast<const S57::SG2D*>(vrid->find("SG2D"));
-          connected[vrid->id()] = sg2d->points.first();
-          return true;
-        }
-        // Modify: TODO
-        Q_ASSERT(false);
-        return false;
-      })
-    },
-
-    {RT::VE, new Handler([&edges] (const S57::Record* rec) {
-        auto vrid = dynamic_cast<const S57::VRID*>(rec);
-        if (vrid->instruction.value == Instr::Delete) {
-          // qCDebug(CENC) << "removing edge" << vrid->id();
-          edges.remove(vrid->id());
-          return true;
-        }
+  auto handleVC = [cell, &hasRef, &refPoint] (const S57::Record& rec) {
+    const S57::VRID vrid(rec.first());
+    if (vrid.instruction.value == Instr::Delete) {
+      // qCDebug(CENC) << "removing connected node" << rec.id();
+      cell->connected.remove(rec.id());
+      return true;
+    }
+    if (vrid.instruction.value == Instr::Insert) {
+      const S57::SG2D sg2d(*rec.find(QLatin1String("SG2D")));
+      Q_ASSERT(sg2d.size() == 1);
+      cell->connected[rec.id()] = sg2d.point(0);
+      if (!hasRef) {
+        refPoint = sg2d.point(0);
+        hasRef = true;
+      }
+      return true;
+    }
+    // Modify: TODO
+    Q_ASSERT(false);
+    return true;
+  };
 
-        if (vrid->instruction.value == Instr::Insert) {
-          auto vrpt = dynamic_cast<const S57::VRPT*>(vrid->find("VRPT"));
-          if (vrpt->pointers.size() != 2) {
-            return false;
-          }
-          RawEdge edge;
-          for (const S57::VRPT::PointerField& pf: vrpt->pointers) {
-            if (pf.type.value != RT::VC || pf.orient.value != Orient::N_A) {
-              return false;
-            }
-            if (pf.topind.value == TopInd::Begin) {
-              edge.begin = pf.id;
-            } else if (pf.topind.value == TopInd::End) {
-              edge.end = pf.id;
-            } else {
-              qCDebug(CENC) << "unhandled edge topology indicator" << pf.topind.print();
-              return false;
-            }
-          }
-          auto sg2d = dynamic_cast<const S57::SG2D*>(vrpt->find("SG2D"));
-          if (sg2d != nullptr) {
-            edge.points = sg2d->points;
-          }
-          edges[vrid->id()] = edge;
-          return true;
-        }
-        // Modify
-        auto vrpc = dynamic_cast<const S57::VRPC*>(vrid->find("VRPC"));
-        if (vrpc != nullptr) {
-          auto vrpt = dynamic_cast<const S57::VRPT*>(vrid->find("VRPT"));
-          Q_ASSERT(vrpc->instruction.value == Instr::Modify); // only modify makes sense
-          for (int i = 0; i < vrpc->count; i++) {
-            const S57::VRPT::PointerField pf = vrpt->pointers[i];
-            if (pf.topind.value == TopInd::Begin) {
-              qCDebug(CENC) << "replacing begin" << edges[vrid->id()].begin << pf.id;
-              edges[vrid->id()].begin = pf.id;
-            } else if (pf.topind.value == TopInd::End) {
-              qCDebug(CENC) << "replacing end" << edges[vrid->id()].end << pf.id;
-              edges[vrid->id()].end = pf.id;
-            } else {
-              qCDebug(CENC) << "unhandled edge topology indicator" << pf.topind.print();
-              return false;
-            }
-          }
-        }
-        auto sgcc = dynamic_cast<const S57::SGCC*>(vrid->find("SGCC"));
-        if (sgcc != nullptr) {
-          if (sgcc->instruction.value == Instr::Delete) {
-            edges[vrid->id()].points.remove(sgcc->first - 1, sgcc->count);
-            return true;
-          }
-          auto sg2d = dynamic_cast<const S57::SG2D*>(vrid->find("SG2D"));
-          if (sgcc->instruction.value == Instr::Insert) {
-            for (int i = 0; i < sgcc->count; i++) {
-              edges[vrid->id()].points.insert(sgcc->first - 1, sg2d->points[sgcc->count - 1 - i]);
-            }
-            return true;
-          }
-          // Modify
-          for (int i = 0; i < sgcc->count; i++) {
-            edges[vrid->id()].points[sgcc->first - 1 + i] = sg2d->points[i];
-          }
-        }
-        return true;
-      })
-    },
+  auto handleVE = [cell] (const S57::Record& rec) {
+    auto& edges = cell->edges;
+    const S57::VRID vrid(rec.first());
+    const quint32 id = rec.id();
+    if (vrid.instruction.value == Instr::Delete) {
+      // qCDebug(CENC) << "removing edge" << id;
+      edges.remove(id);
+      return true;
+    }
 
-    {RT::FE, new Handler([&inCov, &covRefs, m_covr, catcov] (const S57::Record* rec) {
-        auto frid = dynamic_cast<const S57::FRID*>(rec);
-        if (frid->code != m_covr) {
-          return !inCov;
-        }
-        inCov = true;
-        if (frid->instruction.value == Instr::Delete) {
-          covRefs.remove(frid->id());
-          return true;
-        }
-        if (frid->instruction.value == Instr::Insert) {
-          CovRefs crefs;
-          auto attf = dynamic_cast<const S57::ATTF*>(frid->find("ATTF"));
-          // coverage / no coverage
-          crefs.cov = attf->attributes[catcov].value().toUInt() == 1;
-          auto fspt = dynamic_cast<const S57::FSPT*>(frid->find("FSPT"));
-          for (const S57::FSPT::PointerField& pf: fspt->pointers) {
-            RawEdgeRef ref;
-            ref.id = pf.id;
-            ref.reversed = pf.orient.value == Orient::Reverse;
-            ref.inner = pf.boundary.value == Boundary::Interior;
-            crefs.refs.append(ref);
-          }
-          covRefs[frid->id()] = crefs;
-          return true;
+    if (vrid.instruction.value == Instr::Insert) {
+      const S57::VRPT vrpt(*rec.find(QLatin1String("VRPT")));
+      if (vrpt.size() != 2) {
+        return false;
+      }
+      RawEdge edge;
+      for (int i = 0; i < vrpt.size(); i++) {
+        const S57::VRPT::PointerField pf = vrpt.pointer(i);
+        if (pf.type.value != RT::VC || pf.orient.value != Orient::N_A) {
+          return false;
         }
-        // Modify
-        auto fspc = dynamic_cast<const S57::FSPC*>(frid->find("FSPC"));
-        if (fspc->instruction.value == Instr::Delete) {
-          covRefs[frid->id()].refs.remove(fspc->first - 1, fspc->count);
-          return true;
+        if (pf.topind.value == TopInd::Begin) {
+          edge.begin = pf.id;
+        } else if (pf.topind.value == TopInd::End) {
+          edge.end = pf.id;
+        } else {
+          qCDebug(CENC) << "unhandled edge topology indicator" << pf.topind.print();
+          return false;
         }
-        auto fspt = dynamic_cast<const S57::FSPT*>(frid->find("FSPT"));
-        if (fspc->instruction.value == Instr::Insert) {
-          for (int i = 0; i < fspc->count; i++) {
-            auto pf = fspt->pointers[fspc->count - 1 - i];
-            RawEdgeRef ref;
-            ref.id = pf.id;
-            ref.reversed = pf.orient.value == Orient::Reverse;
-            ref.inner = pf.boundary.value == Boundary::Interior;
-            covRefs[frid->id()].refs.insert(fspc->first - 1, ref);
-          }
-          return true;
+      }
+      auto sg2dField = rec.find(QLatin1String("SG2D"));
+      if (sg2dField != nullptr) {
+        edge.points = S57::SG2D(*sg2dField).points();
+      }
+      edges[id] = edge;
+      return true;
+    }
+    // Modify
+    auto vrpcField = rec.find(QLatin1String("VRPC"));
+    if (vrpcField != nullptr) {
+      const S57::VRPC vrpc(*vrpcField);
+      const S57::VRPT vrpt(*rec.find(QLatin1String("VRPT")));
+      Q_ASSERT(vrpc.instruction.value == Instr::Modify); // only modify makes sense
+      for (int i = 0; i < vrpc.count; i++) {
+        const S57::VRPT::PointerField pf = vrpt.pointer(i);
+        if (pf.topind.value == TopInd::Begin) {
+          // qCDebug(CENC) << "replacing begin" << edges[id].begin << pf.id;
+          edges[id].begin = pf.id;
+        } else if (pf.topind.value == TopInd::End) {
+          // qCDebug(CENC) << "replacing end" << edges[id].end << pf.id;
+          edges[id].end = pf.id;
+        } else {
+          qCDebug(CENC) << "unhandled edge topology indicator" << pf.topind.print();
+          return false;
         }
-        // Modify
-        for (int i = 0; i < fspc->count; i++) {
-          auto pf = fspt->pointers[i];
-          RawEdgeRef ref;
-          ref.id = pf.id;
-          ref.reversed = pf.orient.value == Orient::Reverse;
-          ref.inner = pf.boundary.value == Boundary::Interior;
-          covRefs[frid->id()].refs[fspc->first - 1 + i] = ref;
+      }
+    }
+    auto sgccField = rec.find(QLatin1String("SGCC"));
+    if (sgccField != nullptr) {
+      const S57::SGCC sgcc(*sgccField);
+      if (sgcc.instruction.value == Instr::Delete) {
+        edges[id].points.remove(sgcc.first - 1, sgcc.count);
+        return true;
+      }
+      const S57::SG2D sg2d(*rec.find(QLatin1String("SG2D")));
+      if (sgcc.instruction.value == Instr::Insert) {
+        for (int i = 0; i < sgcc.count; i++) {
+          edges[id].points.insert(sgcc.first - 1, sg2d.point(sgcc.count - 1 - i));
         }
         return true;
-      })
-    },
+      }
+      // Modify
+      for (int i = 0; i < sgcc.count; i++) {
+        edges[id].points[sgcc.first - 1 + i] = sg2d.point(i);
+      }
+    }
+    return true;
+  };
 
+  auto edgeRef = [] (const S57::FSPT::PointerField& pf) {
+    RawEdgeRef ref;
+    ref.id = pf.id;
+    ref.reversed = pf.orient.value == Orient::Reverse;
+    ref.inner = pf.boundary.value == Boundary::Interior;
+    return ref;
   };
 
-  QFileInfo info(path);
-  QString filter = QString("%1.[0-9][0-9][0-9]").arg(info.baseName());
-  QDir dir(info.path());
-  auto updates = dir.entryList(QStringList {filter}, QDir::Files | QDir::Readable, QDir::Name);
-  if (updates.isEmpty()) {
-    throw ChartFileError(QString("%1 not found").arg(path));
-  }
+  auto handleFE = [cell, &attfLevel, &natfLevel, &edgeRef] (const S57::Record& rec) {
+    auto& features = cell->features;
+    const S57::FRID frid(rec.first());
+    const quint32 id = rec.id();
+    if (frid.instruction.value == Instr::Delete) {
+      features.remove(id);
+      return true;
+    }
 
-  for (const QString& update: updates) {
+    auto attf = rec.find(QLatin1String("ATTF"));
+    auto natf = rec.find(QLatin1String("NATF"));
 
-    // qCDebug(CENC) << update;
+    if (frid.instruction.value == Instr::Insert) {
+      RawObject feature;
+      feature.geometry = static_cast<quint8>(frid.geom.value);
+      feature.code = frid.code;
 
-    const QString updpth = dir.absoluteFilePath(update);
-    QFile file(updpth);
-    if (!file.open(QFile::ReadOnly)) {
-      throw ChartFileError(QString("Cannot open %1 for reading").arg(updpth));
-    }
+      if (attf != nullptr) {
+        S57::DecodeAttributes(feature.attributes, *attf, attfLevel);
+      }
+      if (natf != nullptr) {
+        S57::DecodeAttributes(feature.attributes, *natf, natfLevel);
+      }
 
-    FieldSource source(&file, updpth);
+      auto fsptField = rec.find(QLatin1String("FSPT"));
+      if (fsptField != nullptr) {
+        const S57::FSPT fspt(*fsptField);
+        auto t = fspt.pointer(0).type.value;
+        feature.refType = static_cast<quint8>(t);
+        if (t != RT::VE) { // VI or VC
+          Q_ASSERT(fspt.size() == 1);
+          feature.pointRef = fspt.pointer(0).id;
+        } else {
+          feature.edgeRefs.reserve(fspt.size());
+          for (int i = 0; i < fspt.size(); i++) {
+            feature.edgeRefs.append(edgeRef(fspt.pointer(i)));
+          }
+        }
+      }
 
+      features[id] = feature;
+      return true;
+    }
+    // Modify
+    Q_ASSERT(features.contains(id));
 
-    bool done = false;
-    inCov = false;
+    S57::AttributeMap attributes;
+    if (attf != nullptr) {
+      S57::DecodeAttributes(attributes, *attf, attfLevel);
+    }
+    if (natf != nullptr) {
+      S57::DecodeAttributes(attributes, *natf, natfLevel);
+    }
+    for (S57::AttributeIterator it = attributes.cbegin(); it != attributes.cend(); ++it) {
+      if (it.value().type() == S57::AttributeType::Deleted) {
+        features[id].attributes.remove(it.key());
+      } else {
+        features[id].attributes[it.key()] = it.value();
+      }
+    }
 
-    while (!done) {
-      S57::Record* rec = source.nextRecord();
-      if (!rec) {
-        done = true;
+    auto fspcField = rec.find(QLatin1String("FSPC"));
+    if (fspcField == nullptr) {
+      // cannot modify without FSPC
+      return true;
+    }
+    const S57::FSPC fspc(*fspcField);
+    if (fspc.instruction.value == Instr::Delete) {
+      auto t = static_cast<RT>(features[id].refType);
+      if (t == RT::VE) {
+        features[id].edgeRefs.remove(fspc.first - 1, fspc.count);
       } else {
-        if (!handlers.contains(rec->type().value)) {
-          done = true;
-        } else {
-          done = !(handlers[rec->type().value])->func(rec);
-        }
-        delete rec;
+        Q_ASSERT(fspc.count == 1 && fspc.first == 1);
+        features[id].pointRef = 0;
       }
+      return true;
+    }
+    const S57::FSPT fspt(*rec.find(QLatin1String("FSPT")));
+    if (fspc.instruction.value == Instr::Insert) {
+      auto t = static_cast<RT>(features[id].refType);
+      Q_ASSERT(t == RT::VE);
+      for (int i = 0; i < fspc.count; i++) {
+        features[id].edgeRefs.insert(fspc.first - 1, edgeRef(fspt.pointer(fspc.count - 1 - i)));
+      }
+      return true;
+    }
+    // Modify
+    auto t = static_cast<RT>(features[id].refType);
+
+    if (t != RT::VE) { // VI or VC
+      Q_ASSERT(fspc.count == 1 && fspc.first == 1);
+      features[id].pointRef = fspt.pointer(0).id;
+    } else {
+      for (int i = 0; i < fspc.count; i++) {
+        features[id].edgeRefs[fspc.first - 1 + i] = edgeRef(fspt.pointer(i));
+      }
+    }
+    return true;
+  };
+
+  // stops at the first record without a handler
+  auto handle = [&] (const S57::Record& rec) {
+    switch (rec.type().value) {
+    case RT::DS: return handleDS(rec);
+    case RT::DP: return handleDP(rec);
+    case RT::VI: return handleVI(rec);
+    case RT::VC: return handleVC(rec);
+    case RT::VE: return handleVE(rec);
+    case RT::FE: return handleFE(rec);
+    default: return false;
+    }
+  };
+
+  for (const QFileInfo& update: updates) {
+
+    qCDebug(CENC) << update.fileName();
+
+    FieldSource source(update.absoluteFilePath());
+
+    attfLevel = LexLevel::N_A;
+    natfLevel = LexLevel::N_A;
+    ReadRecords(source, handle);
+
+    if (hasRef && !cell->ref.valid() && cell->mulfac != 0) {
+      const auto p0 = refPoint / cell->mulfac;
+      cell->ref = WGS84Point::fromLL(p0.x(), p0.y());
     }
   }
 
-  qDeleteAll(handlers);
+  return cell;
+}
+
+GeoProjection* S57Reader::configuredProjection(const QString& path) const {
+
+  auto parsed = parsedCell(path);
+
+  if (!parsed->ref.valid()) {
+    throw ChartFileError(QString("Invalid S57 header in %1").arg(path));
+  }
+
+  auto gp = GeoProjection::CreateProjection(m_proj->className());
+  gp->setReference(parsed->ref);
+  return gp;
+}
+
+
+S57ChartOutline S57Reader::readOutline(const QString& path, const GeoProjection* gp) const {
+
+  auto parsed = parsedCell(path);
+
+  const quint32 m_covr = S52::FindCIndex("M_COVR");
+  const quint32 catcov = S52::FindCIndex("CATCOV");
 
   RawEdgeRefVector cv;
-  for (CovEdgeRefIter it = covRefs.cbegin(); it != covRefs.cend(); ++it) {
-    // qCDebug(CENC) << "Coverage" << it.key() << it.value().cov;
-    if (it.value().cov) {
-      cv.append(it.value().refs);
+  for (ROMIter it = parsed->features.cbegin(); it != parsed->features.cend(); ++it) {
+    const RawObject& feature = it.value();
+    if (feature.code != m_covr) continue;
+    // coverage / no coverage
+    if (feature.attributes.value(catcov).value().toUInt() == 1) {
+      cv.append(feature.edgeRefs);
     }
   }
 
-
   PRegion pcov;
   PRegion pnocov;
-  createCoverage(pcov, pnocov, cv, edges, connected, mulfac, gp);
+  createCoverage(pcov, pnocov, cv, parsed->edges, parsed->connected, parsed->mulfac, gp);
   // qCDebug(CENC) << "nocov areas" << pnocov.size();
   // qCDebug(CENC) << "cov areas" << pcov.size();
 
   // qCDebug(CENC) << pub << mod << scale;
 
-  if (!pub.isValid() || !mod.isValid() || scale == 0 || pcov.isEmpty()) {
+  if (!parsed->pub.isValid() || !parsed->mod.isValid() || parsed->scale == 0 || pcov.isEmpty()) {
     throw ChartFileError(QString("Invalid S57 header in %1").arg(path));
   }
   Region nocov = transformCoverage(pnocov, gp, nullptr);
   WGS84Point corners[2];
   Region cov = transformCoverage(pcov, gp, corners);
 
-  return S57ChartOutline(corners[0], corners[1], cov, nocov, scale, pub, mod);
+  return S57ChartOutline(corners[0], corners[1], cov, nocov, parsed->scale, parsed->pub, parsed->mod);
 }
 
 
@@ -609,373 +684,28 @@ void S57Reader::readChart(GL::VertexVector& vertices,
                           const QString& path,
                           const GeoProjection* gp) const {
 
-  quint32 mulfac = 0;
-
-  PointMap isolated;
-  PointMap connected;
-  RawEdgeMap edges;
-  RawObjectMap features;
-
-  FieldSource* currentSource = nullptr;
-
-  using SoundingVector = QVector<S57::SG3D::Sounding>;
-  using SoundingMap = QMap<quint32, SoundingVector>;
+  auto parsed = parsedCell(path);
 
-  SoundingMap soundings;
-
-  const QMap<RT, Handler*> handlers {
-
-    {RT::DS, new Handler([&currentSource] (const S57::Record* rec) {
-        auto dssi = dynamic_cast<const S57::DSSI*>(rec->find("DSSI"));
-        if (dssi != nullptr) {
-          currentSource->setLexicalLevels(dssi->attfLevel.value, dssi->natfLevel.value);
-        }
-        return true;
-      })
-    },
-
-    {RT::DP, new Handler([&mulfac] (const S57::Record* rec) {
-        auto dspm = dynamic_cast<const S57::DSPM*>(rec);
-        if (dspm->coordFactor != 0) {
-          mulfac = dspm->coordFactor;
-        }
-        return true;
-      })
-    },
-
-    {RT::VI, new Handler([&isolated, &soundings] (const S57::Record* rec) {
-        auto vrid = dynamic_cast<const S57::VRID*>(rec);
-        if (vrid->instruction.value == Instr::Delete) {
-          if (isolated.contains(vrid->id())) {
-            // qCDebug(CENC) << "removing isolated node" << vrid->id();
-            isolated.remove(vrid->id());
-            return true;
-          }
-          if (soundings.contains(vrid->id())) {
-            // qCDebug(CENC) << "removing soundings node" << vrid->id();
-            soundings.remove(vrid->id());
-            return true;
-          }
-          Q_ASSERT(false);
-        }
-        if (vrid->instruction.value == Instr::Insert) {
-          auto sg2d = dynamic_cast<const S57::SG2D*>(vrid->find("SG2D"));
-          if (sg2d != nullptr) {
-            Q_ASSERT(sg2d->points.size() == 1);
-            isolated[vrid->id()] = sg2d->points.first();
-            return true;
-          }
-          auto sg3d = dynamic_cast<const S57::SG3D*>(vrid->find("SG3D"));
-          if (sg3d != nullptr) {
-            // qCDebug(CENC) << "inserting soundings node" << vrid->id();
-            soundings[vrid->id()] = sg3d->soundings;
-            return true;
-          }
-          Q_ASSERT(false);
-        }
-        // Modify
-        auto sgcc = dynamic_cast<const S57::SGCC*>(vrid->find("SGCC"));
-        if (sgcc == nullptr) {
-          // cannot continue without sgcc
-          qCWarning(CENC) << "SGCC not found" << rec->records();
-          return true;
-        }
-        if (sgcc->instruction.value == Instr::Delete) {
-          Q_ASSERT(soundings.contains(vrid->id()));
-          // qCDebug(CENC) << "removing soundings nodes" << vrid->id();
-          soundings[vrid->id()].remove(sgcc->first - 1, sgcc->count);
-          return true;
-        }
-        if (sgcc->instruction.value == Instr::Insert) {
-          Q_ASSERT(soundings.contains(vrid->id()));
-          // qCDebug(CENC) << "inserting soundings nodes" << vrid->id();
-          auto sg3d = dynamic_cast<const S57::SG3D*>(vrid->find("SG3D"));
-          for (int i = 0; i < sgcc->count; i++) {
-            soundings[vrid->id()].insert(sgcc->first - 1, sg3d->soundings[sgcc->count - 1 - i]);
-          }
-          return true;
-        }
-        // Modify
-        if (soundings.contains(vrid->id())) {
-          auto sg3d = dynamic_cast<const S57::SG3D*>(vrid->find("SG3D"));
-          for (int i = 0; i < sgcc->count; i++) {
-            soundings[vrid->id()][sgcc->first - 1 + i] = sg3d->soundings[i];
-          }
-        } else {
-          Q_ASSERT(sgcc->first == 1 && sgcc->count == 1);
-          auto sg2d = dynamic_cast<const S57::SG2D*>(vrid->find("SG2D"));
-          isolated[vrid->id()] = sg2d->points.first();
-        }
-        return true;
-      })
-    },
-
-    {RT::VC, new Handler([&connected] (const S57::Record* rec) {
-        auto vrid = dynamic_cast<const S57::VRID*>(rec);
-        if (vrid->instruction.value == Instr::Delete) {
-          // qCDebug(CENC) << "removing connected node" << vrid->id();
-          connected.remove(vrid->id());
-          return true;
-        }
-        if (vrid->instruction.value == Instr::Insert) {
-          auto sg2d = dynamic_cast<const S57::SG2D*>(vrid->find("SG2D"));
-          Q_ASSERT(sg2d->points.size() == 1);
-          connected[vrid->id()] = sg2d->points.first();
-          return true;
-        }
-        // Modify: TODO
-        Q_ASSERT(false);
-        return true;
-      })
-    },
-
-    {RT::VE, new Handler([&edges] (const S57::Record* rec) {
-        auto vrid = dynamic_cast<const S57::VRID*>(rec);
-        if (vrid->instruction.value == Instr::Delete) {
-          // qCDebug(CENC) << "removing edge" << vrid->id();
-          edges.remove(vrid->id());
-          return true;
-        }
-
-        if (vrid->instruction.value == Instr::Insert) {
-          auto vrpt = dynamic_cast<const S57::VRPT*>(vrid->find("VRPT"));
-          if (vrpt->pointers.size() != 2) {
-            return false;
-          }
-          RawEdge edge;
-          for (const S57::VRPT::PointerField& pf: vrpt->pointers) {
-            if (pf.type.value != RT::VC || pf.orient.value != Orient::N_A) {
-              return false;
-            }
-            if (pf.topind.value == TopInd::Begin) {
-              edge.begin = pf.id;
-            } else if (pf.topind.value == TopInd::End) {
-              edge.end = pf.id;
-            } else {
-              qCDebug(CENC) << "unhandled edge topology indicator" << pf.topind.print();
-              return false;
-            }
-          }
-          auto sg2d = dynamic_cast<const S57::SG2D*>(vrpt->find("SG2D"));
-          if (sg2d != nullptr) {
-            edge.points = sg2d->points;
-          }
-          edges[vrid->id()] = edge;
-          return true;
-        }
-        // Modify
-        auto vrpc = dynamic_cast<const S57::VRPC*>(vrid->find("VRPC"));
-        if (vrpc != nullptr) {
-          auto vrpt = dynamic_cast<const S57::VRPT*>(vrid->find("VRPT"));
-          Q_ASSERT(vrpc->instruction.value == Instr::Modify); // only modify makes sense
-          for (int i = 0; i < vrpc->count; i++) {
-            const S57::VRPT::PointerField pf = vrpt->pointers[i];
-            if (pf.topind.value == TopInd::Begin) {
-              // qCDebug(CENC) << "replacing begin" << edges[vrid->id()].begin << pf.id;
-              edges[vrid->id()].begin = pf.id;
-            } else if (pf.topind.value == TopInd::End) {
-              // qCDebug(CENC) << "replacing end" << edges[vrid->id()].end << pf.id;
-              edges[vrid->id()].end = pf.id;
-            } else {
-              qCDebug(CENC) << "unhandled edge topology indicator" << pf.topind.print();
-              return false;
-            }
-          }
-        }
-        auto sgcc = dynamic_cast<const S57::SGCC*>(vrid->find("SGCC"));
-        if (sgcc != nullptr) {
-          if (sgcc->instruction.value == Instr::Delete) {
-            edges[vrid->id()].points.remove(sgcc->first - 1, sgcc->count);
-            return true;
-          }
-          auto sg2d = dynamic_cast<const S57::SG2D*>(vrid->find("SG2D"));
-          if (sgcc->instruction.value == Instr::Insert) {
-            for (int i = 0; i < sgcc->count; i++) {
-              edges[vrid->id()].points.insert(sgcc->first - 1, sg2d->points[sgcc->count - 1 - i]);
-            }
-            return true;
-          }
-          // Modify
-          for (int i = 0; i < sgcc->count; i++) {
-            edges[vrid->id()].points[sgcc->first - 1 + i] = sg2d->points[i];
-          }
-        }
-        return true;
-      })
-    },
-
-    {RT::FE, new Handler([&features] (const S57::Record* rec) {
-        auto frid = dynamic_cast<const S57::FRID*>(rec);
-        if (frid->instruction.value == Instr::Delete) {
-          features.remove(frid->id());
-          return true;
-        }
-        if (frid->instruction.value == Instr::Insert) {
-          RawObject feature;
-          feature.geometry = static_cast<quint8>(frid->geom.value);
-          feature.code = frid->code;
-
-          auto attf = dynamic_cast<const S57::ATTF*>(frid->find("ATTF"));
-          if (attf != nullptr) {
-            for (auto it = attf->attributes.cbegin(); it != attf->attributes.cend(); ++it) {
-              feature.attributes.insert(it.key(), it.value());
-            }
-          }
-          auto natf = dynamic_cast<const S57::NATF*>(frid->find("NATF"));
-          if (natf != nullptr) {
-            for (auto it = natf->attributes.cbegin(); it != natf->attributes.cend(); ++it) {
-              feature.attributes.insert(it.key(), it.value());
-            }
-          }
-
-          auto fspt = dynamic_cast<const S57::FSPT*>(frid->find("FSPT"));
-          if (fspt != nullptr) {
-            auto t = fspt->pointers.first().type.value;
-            feature.refType = static_cast<quint8>(t);
-            if (t != RT::VE) { // VI or VC
-              Q_ASSERT(fspt->pointers.size() == 1);
-              feature.pointRef = fspt->pointers.first().id;
-            } else {
-              for (const S57::FSPT::PointerField& pf: fspt->pointers) {
-                RawEdgeRef ref;
-                ref.id = pf.id;
-                ref.reversed = pf.orient.value == Orient::Reverse;
-                ref.inner = pf.boundary.value == Boundary::Interior;
-                feature.edgeRefs.append(ref);
-              }
-            }
-          }
-
-          features[frid->id()] = feature;
-          return true;
-        }
-        // Modify
-        Q_ASSERT(features.contains(frid->id()));
-
-        S57::AttributeMap attributes;
-        auto attf = dynamic_cast<const S57::ATTF*>(frid->find("ATTF"));
-        if (attf != nullptr) {
-          for (auto it = attf->attributes.cbegin(); it != attf->attributes.cend(); ++it) {
-            attributes.insert(it.key(), it.value());
-          }
-        }
-        auto natf = dynamic_cast<const S57::NATF*>(frid->find("NATF"));
-        if (natf != nullptr) {
-          for (auto it = natf->attributes.cbegin(); it != natf->attributes.cend(); ++it) {
-            attributes.insert(it.key(), it.value());
-          }
-        }
-        for (S57::AttributeIterator it = attributes.cbegin(); it != attributes.cend(); ++it) {
-          if (it.value().type() == S57::AttributeType::Deleted) {
-            features[frid->id()].attributes.remove(it.key());
-          } else {
-            features[frid->id()].attributes[it.key()] = it.value();
-          }
-        }
-
-        auto fspc = dynamic_cast<const S57::FSPC*>(frid->find("FSPC"));
-        if (fspc == nullptr) {
-          // cannot modify without FSPC
-          return true;
-        }
-        if (fspc->instruction.value == Instr::Delete) {
-          auto t = static_cast<RT>(features[frid->id()].refType);
-          if (t == RT::VE) {
-            features[frid->id()].edgeRefs.remove(fspc->first - 1, fspc->count);
-          } else {
-            Q_ASSERT(fspc->count == 1 && fspc->first == 1);
-            features[frid->id()].pointRef = 0;
-          }
-          return true;
-        }
-        auto fspt = dynamic_cast<const S57::FSPT*>(frid->find("FSPT"));
-        if (fspc->instruction.value == Instr::Insert) {
-          auto t = static_cast<RT>(features[frid->id()].refType);
-          Q_ASSERT(t == RT::VE);
-          for (int i = 0; i < fspc->count; i++) {
-            auto pf = fspt->pointers[fspc->count - 1 - i];
-            RawEdgeRef ref;
-            ref.id = pf.id;
-            ref.reversed = pf.orient.value == Orient::Reverse;
-            ref.inner = pf.boundary.value == Boundary::Interior;
-            features[frid->id()].edgeRefs.insert(fspc->first - 1, ref);
-          }
-          return true;
-        }
-        // Modify
-        auto t = static_cast<RT>(features[frid->id()].refType);
-
-        if (t != RT::VE) { // VI or VC
-          Q_ASSERT(fspc->count == 1 && fspc->first == 1);
-          features[frid->id()].pointRef = fspt->pointers.first().id;
-        } else {
-          for (int i = 0; i < fspc->count; i++) {
-            auto pf = fspt->pointers[i];
-            RawEdgeRef ref;
-            ref.id = pf.id;
-            ref.reversed = pf.orient.value == Orient::Reverse;
-            ref.inner = pf.boundary.value == Boundary::Interior;
-            features[frid->id()].edgeRefs[fspc->first - 1 + i] = ref;
-          }
-        }
-        return true;
-      })
-    },
-
-  };
-
-  QFileInfo info(path);
-  QString filter = QString("%1.[0-9][0-9][0-9]").arg(info.baseName());
-  QDir dir(info.path());
-  auto updates = dir.entryList(QStringList {filter}, QDir::Files | QDir::Readable, QDir::Name);
-  if (updates.isEmpty()) {
-    throw ChartFileError(QString("%1 not found").arg(path));
-  }
-
-  for (const QString& update: updates) {
-
-    qCDebug(CENC) << update;
-
-    const QString updpth = dir.absoluteFilePath(update);
-    QFile file(updpth);
-    if (!file.open(QFile::ReadOnly)) {
-      throw ChartFileError(QString("Cannot open %1 for reading").arg(updpth));
-    }
-
-    FieldSource source(&file, updpth);
-
-    bool done = false;
-    currentSource = &source;
-
-    while (!done) {
-      S57::Record* rec = source.nextRecord();
-      if (!rec) {
-        done = true;
-      } else {
-        if (!handlers.contains(rec->type().value)) {
-          done = true;
-        } else {
-          done = !(handlers[rec->type().value])->func(rec);
-        }
-        delete rec;
-      }
-    }
-  }
-  qDeleteAll(handlers);
+  const quint32 mulfac = parsed->mulfac;
+  const PointMap& isolated = parsed->isolated;
+  const PointMap& connected = parsed->connected;
+  const Cell::SoundingMap& soundings = parsed->soundings;
+  const RawEdgeMap& edges = parsed->edges;
+  const RawObjectMap& features = parsed->features;
 
   S57::ObjectBuilder helper;
 
-  auto getIso = [isolated, mulfac, gp] (quint32 id) {
+  auto getIso = [&isolated, mulfac, gp] (quint32 id) {
     const QPointF ll = isolated[id] / mulfac;
     return gp->fromWGS84(WGS84Point::fromLL(ll.x(), ll.y()));
   };
 
-  auto getConn = [connected, mulfac, gp] (quint32 id) {
+  auto getConn = [&connected, mulfac, gp] (quint32 id) {
     const QPointF ll = connected[id] / mulfac;
     return gp->fromWGS84(WGS84Point::fromLL(ll.x(), ll.y()));
   };
 
-  auto getSnd = [soundings, mulfac, gp] (quint32 id) {
+  auto getSnd = [&soundings, mulfac, gp] (quint32 id) {
     GL::VertexVector ps;
     for (const S57::SG3D::Sounding& s: soundings[id]) {
       const QPointF ll = s.location / mulfac;
@@ -1026,8 +756,8 @@ void S57Reader::readChart(GL::VertexVector& vertices,
     }
     pedges[it.key()] = e;
   }
-  // not needed anymore
-  edges.clear();
+
+  AreaTriangulator triangulator;
 
   for (ROMIter it = features.cbegin(); it != features.cend(); ++it) {
     const RawObject& feature = it.value();
@@ -1069,19 +799,7 @@ void S57Reader::readChart(GL::VertexVector& vertices,
       auto bbox = computeBBox(lines, vertices, indices);
 
       if (geom == Geom::Area) {
-        S57::ElementDataVector triangles;
-        triangulate(triangles, indices, vertices, lines);
-
-        auto center = computeAreaCenterAndBboxes(triangles, vertices, indices);
-        helper.s57SetGeometry(obj,
-                              new S57::Geometry::Area(lines,
-                                                      center,
-                                                      triangles,
-                                                      0,
-                                                      true,
-                                                      gp),
-                              bbox);
-
+        triangulator.add(obj, lines, bbox);
       } else {
         auto center = computeLineCenter(lines, vertices, indices);
         helper.s57SetGeometry(obj,
@@ -1094,6 +812,10 @@ void S57Reader::readChart(GL::VertexVector& vertices,
     }
   }
 
+  triangulator.triangulate(indices, vertices, gp,
+                           [&helper] (S57::Object* obj, S57::Geometry::Base* g, const QRectF& bb) {
+    helper.s57SetGeometry(obj, g, bb);
+  });
 }
 
 void S57Reader::createCoverage(PRegion &cov, PRegion &nocov,
@@ -20,6 +20,10 @@
 #pragma once
 
 #include "chartfilereader.h"
+#include <QSharedPointer>
+#include <QCache>
+#include <QMutex>
+#include <QFileInfo>
 
 class S57ReaderFactory;
 class GeoProjection;
@@ -90,6 +94,13 @@ private:
   using RawObjectMap = QMap<quint32, RawObject>;
   using ROMIter = RawObjectMap::const_iterator;
 
+  struct Cell;
+  using CellPtr = QSharedPointer<const Cell>;
+
+  // returns the cell at path with the updates applied, parses the cell
+  // only if it is not cached or if its update files have changed
+  CellPtr parsedCell(const QString& path) const;
+  CellPtr parseCell(const QFileInfoList& updates) const;
 
 
   bool checkCoverage(const PRegion& cov,
@@ -116,6 +127,19 @@ private:
 
   GeoProjection* m_proj;
 
+  struct CachedCell {
+    QString fingerprint;
+    CellPtr cell;
+  };
+  using CellCache = QCache<QString, CachedCell>;
+
+  // typically the projection is configured and the outline or the chart
+  // is read right after that
+  static const int maxCachedCells = 4;
+
+  mutable QMutex m_cellMutex;
+  mutable CellCache m_cells;
+
 };
 
 class S57ReaderFactory: public QObject, public ChartFileReaderFactory {
@@ -5,7 +5,7 @@ const float MITER_LIMIT = .75;
 
 uniform float depth;
 uniform uint vertexOffset;
-uniform uint indexOffset;
+uniform uint startParity; // parity of the first segment of the element
 uniform float lineWidth; // the line width in display (mm) units
 uniform mat4 m_model;
 uniform mat4 m_p;
@@ -25,9 +25,9 @@ void main() {
 
   const float HW = .5 * lineWidth / windowScale;
 
-  const uint i0 = vertexOffset + indexBufferIn.data[indexOffset + gl_VertexID / 2];
-  const uint i1 = vertexOffset + indexBufferIn.data[indexOffset + gl_VertexID / 2 + 1];
-  const uint i2 = vertexOffset + indexBufferIn.data[indexOffset + gl_VertexID / 2 + 2];
+  const uint i0 = vertexOffset + indexBufferIn.data[gl_VertexID / 2];
+  const uint i1 = vertexOffset + indexBufferIn.data[gl_VertexID / 2 + 1];
+  const uint i2 = vertexOffset + indexBufferIn.data[gl_VertexID / 2 + 2];
 
   const vec4 p0 = m_model * vec4(vertexBufferIn.data[i0], depth, 1.);
   const vec4 p1 = m_model * vec4(vertexBufferIn.data[i1], depth, 1.);
@@ -63,7 +63,7 @@ void main() {
     }
   }
 
-  if ((gl_VertexID / 2) % 2 == 1) {
+  if ((uint(gl_VertexID / 2) + startParity) % 2U == 1U) {
     // texCoord = length(m_p * (p2 - p1));
     texCoord = length(p2.xy - p1.xy) * windowScale;
   } else {
@@ -5,6 +5,7 @@ const float MITER_LIMIT = .75;
 
 uniform float depth;
 uniform uint vertexOffset;
+uniform uint startParity; // parity of the first segment of the element
 uniform float lineWidth; // the line width in display (mm) units
 uniform mat4 m_model;
 uniform mat4 m_p;
@@ -54,7 +55,7 @@ void main() {
     }
   }
 
-  if ((gl_VertexID / 2) % 2 == 1) {
+  if ((index + startParity) % 2U == 1U) {
     texCoord = length(p2.xy - p1.xy) * windowScale;
   } else {
     texCoord = 0.;
@@ -5,7 +5,7 @@ const float MITER_LIMIT = .75;
 
 uniform float depth;
 uniform uint vertexOffset;
-uniform uint indexOffset;
+uniform uint startParity; // parity of the first segment of the element
 uniform float lineWidth; // the line width in display (mm) units
 uniform mat4 m_model;
 uniform mat4 m_p;
@@ -26,9 +26,9 @@ void main() {
   float HW = lineWidth / windowScale;
 
   uint index = uint(gl_VertexID / 2);
-  uint i0 = vertexOffset + indexBufferIn.data[indexOffset + index];
-  uint i1 = vertexOffset + indexBufferIn.data[indexOffset + index + 1U];
-  uint i2 = vertexOffset + indexBufferIn.data[indexOffset + index + 2U];
+  uint i0 = vertexOffset + indexBufferIn.data[index];
+  uint i1 = vertexOffset + indexBufferIn.data[index + 1U];
+  uint i2 = vertexOffset + indexBufferIn.data[index + 2U];
 
   vec4 p0 = m_model * vec4(vertexBufferIn.data[i0], depth, 1.);
   vec4 p1 = m_model * vec4(vertexBufferIn.data[i1], depth, 1.);
@@ -64,7 +64,7 @@ void main() {
     }
   }
 
-  if ((gl_VertexID / 2) % 2 == 1) {
+  if ((index + startParity) % 2U == 1U) {
     texCoord = length(p2.xy - p1.xy) * windowScale;
   } else {
     texCoord = 0.;
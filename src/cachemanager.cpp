@@ -0,0 +1,192 @@
+/* -*- coding: utf-8-unix -*-
+ *
+ * File: src/cachemanager.cpp
+ *
+ * Copyright (C) 2021 Jukka Sirkka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cachemanager.h"
+#include "cachereader.h"
+#include "conf_mainwindow.h"
+#include "logging.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDataStream>
+#include <QMutexLocker>
+
+CacheManager* CacheManager::instance() {
+  static CacheManager* m = new CacheManager();
+  return m;
+}
+
+CacheManager::CacheManager()
+  : m_budget(static_cast<qint64>(Conf::MainWindow::ChartCacheSize()) * 1024 * 1024)
+  , m_size(0)
+  , m_hits(0)
+  , m_misses(0)
+  , m_evictions(0)
+  , m_invalidations(0)
+{
+  load();
+  QMutexLocker lock(&m_mutex);
+  evict(QByteArray());
+}
+
+QString CacheManager::indexPath() const {
+  return QString("%1/%2").arg(CacheReader::CacheDir()).arg(indexName);
+}
+
+void CacheManager::load() {
+  QMutexLocker lock(&m_mutex);
+
+  // saved access times
+  QHash<QByteArray, qint64> accessed;
+  QFile file(indexPath());
+  if (file.open(QFile::ReadOnly)) {
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream >> accessed;
+    if (stream.status() != QDataStream::Ok) {
+      qCWarning(CMGR) << "Corrupted cache index" << file.fileName();
+      accessed.clear();
+    }
+    file.close();
+  }
+
+  // actual entries
+  const QDir dir(CacheReader::CacheDir());
+  const auto infos = dir.entryInfoList(QDir::Files | QDir::Readable);
+  for (const QFileInfo& info: infos) {
+    if (info.fileName() == indexName) continue;
+    const QByteArray id = info.fileName().toUtf8();
+    const qint64 t = accessed.contains(id) ?
+          accessed[id] : info.lastModified().toMSecsSinceEpoch();
+    m_entries[id] = Entry(info.size(), t);
+    m_size += info.size();
+  }
+  qCDebug(CMGR) << "Chart cache:" << m_entries.size() << "entries," << m_size << "bytes";
+}
+
+void CacheManager::save() const {
+  QMutexLocker lock(&m_mutex);
+
+  QHash<QByteArray, qint64> accessed;
+  for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+    accessed[it.key()] = it.value().lastAccess;
+  }
+
+  if (!QDir().mkpath(CacheReader::CacheDir())) return;
+  QFile file(indexPath());
+  if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+    qCWarning(CMGR) << "Cannot write cache index" << file.fileName();
+    return;
+  }
+  QDataStream stream(&file);
+  stream.setVersion(QDataStream::Qt_5_6);
+  stream << accessed;
+  file.close();
+
+  qCDebug(CMGR) << "Chart cache: hits" << m_hits << ", misses" << m_misses
+                << ", evictions" << m_evictions << ", invalidations" << m_invalidations
+                << "," << m_entries.size() << "entries," << m_size << "bytes";
+}
+
+void CacheManager::setBudget(qint64 bytes) {
+  QMutexLocker lock(&m_mutex);
+  m_budget = bytes;
+  evict(QByteArray());
+}
+
+qint64 CacheManager::budget() const {
+  QMutexLocker lock(&m_mutex);
+  return m_budget;
+}
+
+void CacheManager::hit(const QString& path) {
+  QMutexLocker lock(&m_mutex);
+  m_hits += 1;
+  const auto id = CacheReader::CacheId(path);
+  if (!m_entries.contains(id)) {
+    // written by another instance
+    const QFileInfo info(CacheReader::CachePath(path));
+    m_entries[id] = Entry(info.size(), 0);
+    m_size += info.size();
+  }
+  m_entries[id].lastAccess = QDateTime::currentMSecsSinceEpoch();
+}
+
+void CacheManager::miss() {
+  QMutexLocker lock(&m_mutex);
+  m_misses += 1;
+}
+
+void CacheManager::invalidate(const QString& path) {
+  QMutexLocker lock(&m_mutex);
+  const auto id = CacheReader::CacheId(path);
+  if (!QFile::remove(CacheReader::CachePath(path))) return;
+  m_invalidations += 1;
+  if (m_entries.contains(id)) {
+    m_size -= m_entries[id].size;
+    m_entries.remove(id);
+  }
+  qCDebug(CMGR) << "Invalidated cached" << path;
+}
+
+void CacheManager::insert(const QString& path) {
+  QMutexLocker lock(&m_mutex);
+  const auto id = CacheReader::CacheId(path);
+  if (m_entries.contains(id)) {
+    m_size -= m_entries[id].size;
+  }
+  const QFileInfo info(CacheReader::CachePath(path));
+  m_entries[id] = Entry(info.size(), QDateTime::currentMSecsSinceEpoch());
+  m_size += info.size();
+
+  evict(id);
+}
+
+void CacheManager::evict(const QByteArray& keep) {
+  // Note: called with m_mutex locked
+  while (m_size > m_budget && m_entries.size() > 1) {
+    auto oldest = m_entries.end();
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+      if (it.key() == keep) continue;
+      if (oldest == m_entries.end() || it.value().lastAccess < oldest.value().lastAccess) {
+        oldest = it;
+      }
+    }
+    if (oldest == m_entries.end()) break;
+    // Note: removing a file mapped by a chart worker is safe
+    QFile::remove(QString("%1/%2").arg(CacheReader::CacheDir()).arg(QString(oldest.key())));
+    m_size -= oldest.value().size;
+    m_evictions += 1;
+    m_entries.erase(oldest);
+  }
+}
+
+CacheManager::Statistics CacheManager::statistics() const {
+  QMutexLocker lock(&m_mutex);
+  Statistics s;
+  s.hits = m_hits;
+  s.misses = m_misses;
+  s.evictions = m_evictions;
+  s.invalidations = m_invalidations;
+  s.size = m_size;
+  s.entries = m_entries.size();
+  return s;
+}
@@ -0,0 +1,93 @@
+/* -*- coding: utf-8-unix -*-
+ *
+ * File: src/cachemanager.h
+ *
+ * Copyright (C) 2021 Jukka Sirkka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+// Keeps the on-disk chart cache within a size budget by evicting the least
+// recently used entries. Entries are keyed by CacheReader::CacheId. The
+// access times are stored in an index file in the cache directory.
+class CacheManager {
+
+public:
+
+  struct Statistics {
+    quint32 hits;
+    quint32 misses;
+    quint32 evictions;
+    quint32 invalidations;
+    qint64 size;
+    int entries;
+  };
+
+  static CacheManager* instance();
+
+  void setBudget(qint64 bytes);
+  qint64 budget() const;
+
+  // chart path found in cache
+  void hit(const QString& path);
+  // chart path not found in cache
+  void miss();
+  // cache entry of chart path is obsolete: remove it
+  void invalidate(const QString& path);
+  // new cache entry for chart path written
+  void insert(const QString& path);
+
+  Statistics statistics() const;
+
+  void save() const;
+
+  ~CacheManager() = default;
+
+private:
+
+  struct Entry {
+    Entry() = default;
+    Entry(qint64 sz, qint64 t)
+      : size(sz)
+      , lastAccess(t) {}
+    qint64 size;
+    qint64 lastAccess; // msecs since epoch
+  };
+
+  using EntryHash = QHash<QByteArray, Entry>;
+
+  CacheManager();
+  CacheManager(const CacheManager&) = delete;
+  CacheManager& operator=(const CacheManager&) = delete;
+
+  void load();
+  void evict(const QByteArray& keep);
+  QString indexPath() const;
+
+  static const inline QString indexName = "cache.idx";
+
+  mutable QMutex m_mutex;
+  EntryHash m_entries;
+  qint64 m_budget;
+  qint64 m_size;
+  quint32 m_hits;
+  quint32 m_misses;
+  quint32 m_evictions;
+  quint32 m_invalidations;
+};
@@ -23,6 +23,11 @@
 #include <QFile>
 #include <QDate>
 #include <QDataStream>
+#include <QScopedPointer>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include "cachemanager.h"
 
 const GeoProjection* CacheReader::geoprojection() const {
   return m_proj;
@@ -33,73 +38,95 @@ CacheReader::CacheReader()
   , m_proj(GeoProjection::CreateProjection("SimpleMercator"))
 {}
 
-GeoProjection* CacheReader::configuredProjection(const QString &path) const {
-  auto id = CacheId(path);
-  const auto base = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+CacheReader::Header CacheReader::LittleEndian(const Header& h) {
+  Header r = h;
+  r.magic = LittleEndian(h.magic);
+  r.version = LittleEndian(h.version);
+  r.lng = LittleEndian(h.lng);
+  r.lat = LittleEndian(h.lat);
+  r.source = LittleEndian(h.source);
+  r.vertexOffset = LittleEndian(h.vertexOffset);
+  r.vertexCount = LittleEndian(h.vertexCount);
+  r.indexOffset = LittleEndian(h.indexOffset);
+  r.indexCount = LittleEndian(h.indexCount);
+  r.objectTableOffset = LittleEndian(h.objectTableOffset);
+  r.objectCount = LittleEndian(h.objectCount);
+  r.objectDataOffset = LittleEndian(h.objectDataOffset);
+  r.objectDataSize = LittleEndian(h.objectDataSize);
+  return r;
+}
+
+CacheReader::Header CacheReader::ReadHeader(QFile& file, const QString& path, bool* stale) {
+  Header h;
+  if (file.read(reinterpret_cast<char*>(&h), sizeof(Header)) != sizeof(Header)) {
+    throw ChartFileError(QString("%1 is not a proper cached chart file").arg(file.fileName()));
+  }
+  h = LittleEndian(h);
+  // Note: the id is written last: files being written are rejected here
+  if (QByteArray(h.id, 8) != CacheId(path)) {
+    throw ChartFileError(QString("%1 is not a proper cached chart file").arg(file.fileName()));
+  }
+  if (h.magic != Magic || h.version != Version) {
+    if (stale != nullptr) *stale = true;
+    throw ChartFileError(QString("%1 has an obsolete format").arg(file.fileName()));
+  }
+  if (h.source != SourceStamp(path)) {
+    if (stale != nullptr) *stale = true;
+    throw ChartFileError(QString("%1 is out of date").arg(file.fileName()));
+  }
 
-  const auto cachePath = QString("%1/%2/%3").arg(base).arg(baseAppName()).arg(QString(id));
+  auto inside = [&file] (quint64 offset, quint64 len) {
+    return offset % sizeof(quint32) == 0 &&
+        offset + len <= static_cast<quint64>(file.size());
+  };
+
+  if (!inside(h.vertexOffset, sizeof(GLfloat) * h.vertexCount) ||
+      !inside(h.indexOffset, sizeof(GLuint) * h.indexCount) ||
+      !inside(h.objectTableOffset, sizeof(quint32) * (static_cast<quint64>(h.objectCount) + 1)) ||
+      !inside(h.objectDataOffset, h.objectDataSize)) {
+    if (stale != nullptr) *stale = true;
+    throw ChartFileError(QString("%1 is truncated").arg(file.fileName()));
+  }
+  return h;
+}
+
+GeoProjection* CacheReader::configuredProjection(const QString &path) const {
+  const auto cachePath = CachePath(path);
 
   QFile file(cachePath);
   if (!file.open(QFile::ReadOnly)) {
+    CacheManager::instance()->miss();
     throw ChartFileError(QString("Cannot open %1 for reading").arg(cachePath));
   }
-  QDataStream stream(&file);
-
-  stream.setVersion(QDataStream::Qt_5_6);
-  stream.setByteOrder(QDataStream::LittleEndian);
-  QByteArray magic(8, '0');
-  stream.readRawData(magic.data(), 8);
-  if (magic != id) {
-    throw ChartFileError(QString("%1 is not a proper cached chart file").arg(cachePath));
+  Header h;
+  bool stale = false;
+  try {
+    h = ReadHeader(file, path, &stale);
+  } catch (ChartFileError&) {
+    file.close();
+    CacheManager::instance()->miss();
+    if (stale) {
+      CacheManager::instance()->invalidate(path);
+    }
+    throw;
   }
-
-  stream.setFloatingPointPrecision(QDataStream::DoublePrecision);
-
-  // header
-  double lng;
-  stream >> lng;
-  double lat;
-  stream >> lat;
-  auto ref = WGS84Point::fromLL(lng , lat);
-
   file.close();
 
   auto gp = GeoProjection::CreateProjection(m_proj->className());
-  gp->setReference(ref);
+  gp->setReference(WGS84Point::fromLL(h.lng, h.lat));
   return gp;
 
 }
 
 
 S57ChartOutline CacheReader::readOutline(const QString &path, const GeoProjection*) const {
-  auto id = CacheId(path);
-  const auto base = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
-
-  const auto cachePath = QString("%1/%2/%3").arg(base).arg(baseAppName()).arg(QString(id));
+  const auto cachePath = CachePath(path);
 
   QFile file(cachePath);
   if (!file.open(QFile::ReadOnly)) {
     throw ChartFileError(QString("Cannot open %1 for reading").arg(cachePath));
   }
-  QDataStream stream(&file);
-
-  stream.setVersion(QDataStream::Qt_5_6);
-  stream.setByteOrder(QDataStream::LittleEndian);
-  QByteArray magic(8, '0');
-  stream.readRawData(magic.data(), 8);
-  if (magic != id) {
-    throw ChartFileError(QString("%1 is not a proper cached chart file").arg(cachePath));
-  }
-
-  stream.setFloatingPointPrecision(QDataStream::DoublePrecision);
-
-  // header
-  double lng;
-  stream >> lng;
-  double lat;
-  stream >> lat;
-  auto ref = WGS84Point::fromLL(lng , lat);
-
+  const Header h = ReadHeader(file, path);
   file.close();
 
   // Only reference point needed
@@ -107,78 +134,95 @@ S57ChartOutline CacheReader::readOutline(const QString &path, const GeoProjectio
                          WGS84Point(),
                          S57ChartOutline::Region(),
                          S57ChartOutline::Region(),
-                         ref,
+                         WGS84Point::fromLL(h.lng, h.lat),
                          QSizeF(1., 1.),
                          1,
                          QDate(),
                          QDate());
 }
 
-void CacheReader::readChart(GL::VertexVector& vertices,
-                            GL::IndexVector& indices,
-                            S57::ObjectVector& objects,
-                            const QString& path,
-                            const GeoProjection*) const {
+CacheReader::MappedChart* CacheReader::mapChart(S57::ObjectVector& objects,
+                                                const QString& path) const {
 
-  auto id = CacheId(path);
-  const auto base = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+  const auto cachePath = CachePath(path);
 
-  const auto cachePath = QString("%1/%2/%3").arg(base).arg(baseAppName()).arg(QString(id));
+  QScopedPointer<MappedChart> chart(new MappedChart);
+  chart->m_file = new QFile(cachePath);
 
-  QFile file(cachePath);
+  QFile& file = *chart->m_file;
   if (!file.open(QFile::ReadOnly)) {
     throw ChartFileError(QString("Cannot open %1 for reading").arg(cachePath));
   }
-  QDataStream stream(&file);
-
-  stream.setVersion(QDataStream::Qt_5_6);
-  stream.setByteOrder(QDataStream::LittleEndian);
-  QByteArray magic(8, '0');
-  stream.readRawData(magic.data(), 8);
-  if (magic != id) {
-    throw ChartFileError(QString("%1 is not a proper cached chart file").arg(cachePath));
-  }
-
-  stream.setFloatingPointPrecision(QDataStream::DoublePrecision);
-
-  // header
-  double dummy;
-  stream >> dummy; // ref
-  stream >> dummy;
 
-  stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+  const Header h = ReadHeader(file, path);
 
-  // vertices
-  int Nc;
-  stream >> Nc;
-
-  GLfloat v;
-  for (int n = 0; n < Nc; n++) {
-    stream >> v;
-    vertices << v;
-    stream >> v;
-    vertices << v;
+  const uchar* data = file.map(0, file.size());
+  if (data == nullptr) {
+    throw ChartFileError(QString("Cannot map %1").arg(cachePath));
   }
 
-  // indices
-  int Ni;
-  stream >> Ni;
-
-  GLuint k;
-  for (int n = 0; n < Ni; n++) {
-    stream >> k;
-    indices << k;
+  chart->m_vertexCount = h.vertexCount;
+  chart->m_indexCount = h.indexCount;
+  auto vertices = reinterpret_cast<const GLfloat*>(data + h.vertexOffset);
+  auto indices = reinterpret_cast<const GLuint*>(data + h.indexOffset);
+
+  if (QSysInfo::ByteOrder == QSysInfo::LittleEndian) {
+    chart->m_vertices = vertices;
+    chart->m_indices = indices;
+  } else {
+    chart->m_vertexData.reserve(h.vertexCount);
+    for (quint32 i = 0; i < h.vertexCount; i++) {
+      chart->m_vertexData << LittleEndian(vertices[i]);
+    }
+    chart->m_indexData.reserve(h.indexCount);
+    for (quint32 i = 0; i < h.indexCount; i++) {
+      chart->m_indexData << LittleEndian(indices[i]);
+    }
+    chart->m_vertices = chart->m_vertexData.constData();
+    chart->m_indices = chart->m_indexData.constData();
   }
 
   // objects
-  int No;
-  stream >> No;
-
-  for (int n = 0; n < No; n++) {
+  auto table = reinterpret_cast<const quint32*>(data + h.objectTableOffset);
+  auto objectData = reinterpret_cast<const char*>(data + h.objectDataOffset);
+
+  objects.reserve(objects.size() + h.objectCount);
+  for (quint32 n = 0; n < h.objectCount; n++) {
+    const quint32 first = LittleEndian(table[n]);
+    const quint32 last = LittleEndian(table[n + 1]);
+    if (first > last || last > h.objectDataSize) {
+      throw ChartFileError(QString("%1: corrupted object table").arg(cachePath));
+    }
+    const auto bytes = QByteArray::fromRawData(objectData + first, last - first);
+    QDataStream stream(bytes);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
     objects.append(S57::Object::Decode(stream));
   }
 
-  file.close();
+  CacheManager::instance()->hit(path);
+
+  return chart.take();
+}
+
+CacheReader::MappedChart::~MappedChart() {
+  delete m_file;
+}
+
+void CacheReader::readChart(GL::VertexVector& vertices,
+                            GL::IndexVector& indices,
+                            S57::ObjectVector& objects,
+                            const QString& path,
+                            const GeoProjection*) const {
+
+  QScopedPointer<MappedChart> chart(mapChart(objects, path));
+
+  vertices.resize(chart->vertexCount());
+  std::copy(chart->vertices(), chart->vertices() + chart->vertexCount(), vertices.begin());
+
+  indices.resize(chart->indexCount());
+  std::copy(chart->indices(), chart->indices() + chart->indexCount(), indices.begin());
 }
 
 QByteArray CacheReader::CacheId(const QString& path) {
@@ -187,3 +231,46 @@ QByteArray CacheReader::CacheId(const QString& path) {
   // convert sha1 to base36 form and return first 8 bytes for use as string
   return QByteArray::number(*reinterpret_cast<const quint64*>(hash.result().constData()), 36).left(8);
 }
+
+QString CacheReader::CacheDir() {
+  const auto base = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+  return QString("%1/%2").arg(base).arg(baseAppName());
+}
+
+QString CacheReader::CachePath(const QString& path) {
+  return QString("%1/%2").arg(CacheDir()).arg(QString(CacheId(path)));
+}
+
+bool CacheReader::IsCached(const QString& path) {
+  QFile file(CachePath(path));
+  if (!file.open(QFile::ReadOnly)) return false;
+  try {
+    ReadHeader(file, path);
+  } catch (ChartFileError&) {
+    return false;
+  }
+  return true;
+}
+
+quint64 CacheReader::SourceStamp(const QString& path) {
+  const QFileInfo info(path);
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  auto add = [&hash] (const QFileInfo& f) {
+    hash.addData(f.fileName().toUtf8());
+    hash.addData(QByteArray::number(f.size()));
+    hash.addData(QByteArray::number(f.lastModified().toMSecsSinceEpoch()));
+  };
+
+  add(info);
+
+  // update files
+  const QStringList filters {QString("%1.[0-9][0-9][0-9]").arg(info.completeBaseName())};
+  auto updates = info.dir().entryInfoList(filters, QDir::Files, QDir::Name);
+  for (const QFileInfo& f: updates) {
+    if (f.fileName() == info.fileName()) continue;
+    add(f);
+  }
+
+  return *reinterpret_cast<const quint64*>(hash.result().constData());
+}
@@ -20,12 +20,76 @@
 #pragma once
 
 #include "chartfilereader.h"
+#include <QtEndian>
+#include <algorithm>
 
+class QFile;
 
 class CacheReader: public ChartFileReader {
 
 public:
 
+  // Cache file layout, all values little-endian:
+  //
+  //   header        72 bytes
+  //   vertices      vertexCount x GLfloat
+  //   indices       indexCount x GLuint
+  //   object table  (objectCount + 1) x quint32, offsets relative to object data
+  //   object data   S57::Object::encode'd objects
+  //
+  // Blocks start at 16 byte boundaries so that the vertex and index blocks can
+  // be used directly from the mapped file.
+  struct Header {
+    char id[8]; // CacheId, written last
+    quint32 magic;
+    quint32 version;
+    double lng; // reference point
+    double lat;
+    quint64 source; // SourceStamp of the chart file
+    quint32 vertexOffset;
+    quint32 vertexCount;
+    quint32 indexOffset;
+    quint32 indexCount;
+    quint32 objectTableOffset;
+    quint32 objectCount;
+    quint32 objectDataOffset;
+    quint32 objectDataSize;
+  };
+
+  static const quint32 Magic = 0x4343514e; // "NQCC"
+  static const quint32 Version = 3;
+  static const quint32 Alignment = 16;
+
+  // Memory mapped cache file. Vertices and indices point directly to the
+  // mapping on little-endian hosts.
+  class MappedChart {
+  public:
+
+    const GLfloat* vertices() const {return m_vertices;}
+    int vertexCount() const {return m_vertexCount;}
+    const GLuint* indices() const {return m_indices;}
+    int indexCount() const {return m_indexCount;}
+
+    ~MappedChart();
+
+  private:
+
+    friend class CacheReader;
+
+    MappedChart() = default;
+    MappedChart(const MappedChart&) = delete;
+    MappedChart& operator=(const MappedChart&) = delete;
+
+    QFile* m_file = nullptr;
+    const GLfloat* m_vertices = nullptr;
+    int m_vertexCount = 0;
+    const GLuint* m_indices = nullptr;
+    int m_indexCount = 0;
+    // byte order converted copies on big-endian hosts
+    GL::VertexVector m_vertexData;
+    GL::IndexVector m_indexData;
+  };
+
   CacheReader();
 
   const GeoProjection* geoprojection() const override;
@@ -39,15 +103,46 @@ public:
                  const QString& path,
                  const GeoProjection* proj) const override;
 
+  // Maps the cached chart and decodes its objects. Caller owns the result.
+  MappedChart* mapChart(S57::ObjectVector& objects, const QString& path) const;
 
   static QByteArray CacheId(const QString& path);
+  static QString CacheDir();
+  static QString CachePath(const QString& path);
+  // true if the cache file of chart path exists, has the current format
+  // and is up to date with respect to the chart file and its updates
+  static bool IsCached(const QString& path);
+  // fingerprint of the sizes and modification times of the chart file
+  // and its update files (.001, .002, ...)
+  static quint64 SourceStamp(const QString& path);
+
+  static quint32 Aligned(quint32 offset) {
+    return (offset + Alignment - 1) / Alignment * Alignment;
+  }
+
+  // Swaps bytes on big-endian hosts, noop otherwise
+  template <typename T>
+  static T LittleEndian(T v) {
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    auto b = reinterpret_cast<uchar*>(&v);
+    std::reverse(b, b + sizeof(T));
+#endif
+    return v;
+  }
+
+  static Header LittleEndian(const Header& h);
 
 private:
 
+  // stale is set if the file is a cache file of path, but has an old format
+  // or is out of date
+  static Header ReadHeader(QFile& file, const QString& path, bool* stale = nullptr);
+
   GeoProjection* m_proj;
 
 };
 
+static_assert(sizeof(CacheReader::Header) == 72, "Unexpected cache header size");
 
 
 
@@ -372,6 +372,14 @@ QPointF ChartDisplay::position(qreal lng, qreal lat) const {
   return position(WGS84Point::fromLL(lng, lat));
 }
 
+void ChartDisplay::setCourse(qreal degrees) {
+  ChartManager::instance()->setCourse(Angle::fromDegrees(degrees));
+}
+
+void ChartDisplay::clearCourse() {
+  ChartManager::instance()->setCourse(Angle());
+}
+
 QPointF ChartDisplay::advance(qreal lng, qreal lat, qreal distance, qreal heading) const {
   const auto wp = WGS84Point::fromLL(lng, lat) + WGS84Bearing::fromMeters(distance, Angle::fromDegrees(heading));
   return position(wp);
@@ -525,6 +533,8 @@ void ChartDisplay::updateChartDB(bool fullUpdate) {
 
 void ChartDisplay::requestChartDBUpdate() {
   m_updater->sync(Conf::MainWindow::ChartFolders());
+  // keep the database in sync with the chart folders
+  m_updater->watch(Conf::MainWindow::ChartFolders());
 }
 
 
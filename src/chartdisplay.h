@@ -113,6 +113,8 @@ public:
   Q_INVOKABLE QPointF position(qreal lng, qreal lat) const;
   Q_INVOKABLE QPointF advance(qreal lng, qreal lat, qreal distance, qreal heading) const;
   Q_INVOKABLE void updateChartDB(bool fullUpdate);
+  Q_INVOKABLE void setCourse(qreal degrees);
+  Q_INVOKABLE void clearCourse();
 
   Q_PROPERTY(QStringList chartSets
              READ chartSets
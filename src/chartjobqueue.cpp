@@ -0,0 +1,140 @@
+/* -*- coding: utf-8-unix -*-
+ *
+ * File: src/chartjobqueue.cpp
+ *
+ * Copyright (C) 2021 Jukka Sirkka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "chartjobqueue.h"
+#include <QMutexLocker>
+
+ChartJobQueue::ChartJobQueue(int numWorkers)
+  : m_deques(numWorkers)
+  , m_idle(numWorkers, true)
+  , m_generation(0)
+{}
+
+int ChartJobQueue::reset(const JobVector& jobs) {
+  QMutexLocker lock(&m_mutex);
+
+  const int cancelled = pending();
+  for (Deque& deque: m_deques) deque.clear();
+
+  m_generation += 1;
+
+  JobVector sorted(jobs);
+  std::stable_sort(sorted.begin(), sorted.end(), Before);
+
+  // deal the jobs round robin: every deque stays sorted and
+  // gets its share of the high priority jobs
+  for (int i = 0; i < sorted.size(); i++) {
+    ChartData job = sorted[i];
+    job.generation = m_generation;
+    m_deques[i % m_deques.size()].append(job);
+  }
+
+  return cancelled;
+}
+
+void ChartJobQueue::append(const ChartData& d) {
+  QMutexLocker lock(&m_mutex);
+
+  ChartData job(d);
+  job.generation = m_generation;
+
+  auto deque = std::min_element(m_deques.begin(), m_deques.end(), [] (const Deque& a, const Deque& b) {
+    return a.size() < b.size();
+  });
+  auto it = std::upper_bound(deque->begin(), deque->end(), job, Before);
+  deque->insert(it, job);
+}
+
+bool ChartJobQueue::take(quint32 worker, ChartData& job) {
+  QMutexLocker lock(&m_mutex);
+
+  if (takeFrom(m_deques[worker], job)) return true;
+
+  // steal from the longest deque
+  QVector<int> victims;
+  for (int i = 0; i < m_deques.size(); i++) {
+    if (i == static_cast<int>(worker) || m_deques[i].isEmpty()) continue;
+    victims.append(i);
+  }
+  std::sort(victims.begin(), victims.end(), [this] (int a, int b) {
+    return m_deques[a].size() > m_deques[b].size();
+  });
+  for (int victim: victims) {
+    if (takeFrom(m_deques[victim], job)) return true;
+  }
+
+  m_idle[worker] = true;
+  return false;
+}
+
+bool ChartJobQueue::takeFrom(Deque& deque, ChartData& job) {
+  for (auto it = deque.begin(); it != deque.end(); ++it) {
+    if (m_busy.contains(it->id)) continue;
+    job = *it;
+    deque.erase(it);
+    m_busy.insert(job.id);
+    return true;
+  }
+  return false;
+}
+
+void ChartJobQueue::finish(quint32 chartId) {
+  QMutexLocker lock(&m_mutex);
+  m_busy.remove(chartId);
+}
+
+ChartJobQueue::WorkerVector ChartJobQueue::wake() {
+  QMutexLocker lock(&m_mutex);
+
+  WorkerVector workers;
+  int count = pending();
+  for (int i = 0; i < m_idle.size() && count > 0; i++) {
+    if (!m_idle[i]) continue;
+    m_idle[i] = false;
+    workers.append(i);
+    count -= 1;
+  }
+  return workers;
+}
+
+bool ChartJobQueue::isBusy(quint32 chartId) const {
+  QMutexLocker lock(&m_mutex);
+  return m_busy.contains(chartId);
+}
+
+bool ChartJobQueue::hasPending() const {
+  QMutexLocker lock(&m_mutex);
+  return pending() > 0;
+}
+
+bool ChartJobQueue::isIdle() const {
+  QMutexLocker lock(&m_mutex);
+  return pending() == 0 && m_busy.isEmpty();
+}
+
+quint32 ChartJobQueue::generation() const {
+  QMutexLocker lock(&m_mutex);
+  return m_generation;
+}
+
+int ChartJobQueue::pending() const {
+  int count = 0;
+  for (const Deque& deque: m_deques) count += deque.size();
+  return count;
+}
@@ -0,0 +1,81 @@
+/* -*- coding: utf-8-unix -*-
+ *
+ * File: src/chartjobqueue.h
+ *
+ * Copyright (C) 2021 Jukka Sirkka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <QMutex>
+#include <QVector>
+#include <QList>
+#include <QSet>
+#include "chartupdater.h"
+
+//
+// Pending chart jobs of the chart updaters. Each worker owns a deque
+// ordered by priority and steals from the longest deque of the others
+// when its own runs dry. At most one job per chart is running at a time.
+//
+// A new viewport replaces the pending jobs (the running ones cannot be
+// cancelled) and bumps the generation, which is stamped on the jobs so
+// that obsolete results can be recognized.
+//
+class ChartJobQueue {
+public:
+
+  using JobVector = QVector<ChartData>;
+  using WorkerVector = QVector<quint32>;
+
+  ChartJobQueue(int numWorkers);
+
+  // Cancels pending jobs and queues the given ones in a new generation.
+  // Returns the number of cancelled jobs.
+  int reset(const JobVector& jobs);
+  // Queues an additional job in the current generation
+  void append(const ChartData& job);
+
+  // Called by the workers. Returns false and marks the worker idle
+  // if there's nothing to do.
+  bool take(quint32 worker, ChartData& job);
+  // Releases the chart of a completed job
+  void finish(quint32 chartId);
+  // Idle workers that should be woken up to process pending jobs. The
+  // returned workers are marked busy.
+  WorkerVector wake();
+
+  bool isBusy(quint32 chartId) const;
+  bool hasPending() const;
+  bool isIdle() const;
+  quint32 generation() const;
+
+private:
+
+  using Deque = QList<ChartData>;
+
+  static bool Before(const ChartData& a, const ChartData& b) {
+    return a.priority < b.priority;
+  }
+
+  bool takeFrom(Deque& deque, ChartData& job);
+  int pending() const;
+
+  mutable QMutex m_mutex;
+  QVector<Deque> m_deques;
+  QVector<bool> m_idle;
+  QSet<quint32> m_busy;
+  quint32 m_generation;
+};
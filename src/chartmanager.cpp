@@ -36,9 +36,11 @@
 #include <QPluginLoader>
 #include <QLibraryInfo>
 #include "cachereader.h"
+#include "cachemanager.h"
 #include "dbupdater_interface.h"
 #include "gnuplot.h"
 #include "conf_mainwindow.h"
+#include "chartjobqueue.h"
 
 ChartManager* ChartManager::instance() {
   static ChartManager* m = new ChartManager();
@@ -49,6 +51,7 @@ ChartManager::ChartManager(QObject *parent)
   : QObject(parent)
   , m_db()
   , m_workers({nullptr}) // temporary, to be replaced in createThreads
+  , m_jobs(nullptr)
   , m_transactionCounter(0)
   , m_reader(nullptr)
   , m_updater(new UpdaterInterface(this))
@@ -164,6 +167,8 @@ void ChartManager::setChartSet(const QString &name, const GeoProjection* vproj,
   m_reader = m_readers[m_chartSets[name]];
   m_outlines.clear();
   m_scales.clear();
+  m_prefetchCandidates.clear();
+  m_prefetched.clear();
 
   m_ref = vproj->reference();
 
@@ -215,12 +220,12 @@ void ChartManager::createThreads(QOpenGLContext* ctx) {
   const int numThreads = qMax(1, QThread::idealThreadCount() - 1);
   qCDebug(CMGR) << "number of chart updaters =" << numThreads;
   m_workers.clear(); // remove the temporary setting in ctor
+  m_jobs = new ChartJobQueue(numThreads);
   for (int i = 0; i < numThreads; ++i) {
     qCDebug(CMGR) << "creating thread" << i;
     auto thread = new GL::Thread(ctx);
     qCDebug(CMGR) << "creating worker" << i;
-    auto worker = new ChartUpdater(m_workers.size());
-    m_idleStack.push(worker->id());
+    auto worker = new ChartUpdater(m_workers.size(), m_jobs);
     qCDebug(CMGR) << "moving worker to thread" << i;
     worker->moveToThread(thread);
     connect(thread, &QThread::finished, worker, &QObject::deleteLater);
@@ -236,6 +241,9 @@ void ChartManager::createThreads(QOpenGLContext* ctx) {
   m_cacheWorker = new ChartUpdater(m_workers.size());
   m_cacheWorker->moveToThread(m_cacheThread);
   connect(m_cacheThread, &QThread::finished, m_cacheWorker, &QObject::deleteLater);
+  for (auto worker: m_workers) {
+    connect(worker, &ChartUpdater::created, m_cacheWorker, &ChartUpdater::storeChart);
+  }
   m_cacheThread->start();
   qCDebug(CMGR) << "threads started";
 }
@@ -246,6 +254,7 @@ ChartManager::~ChartManager() {
     thread->wait();
   }
   qDeleteAll(m_threads);
+  delete m_jobs;
 
   // Cache charts before quitting
   for (auto chart: m_charts) {
@@ -258,6 +267,8 @@ ChartManager::~ChartManager() {
   m_cacheThread->wait();
   delete m_cacheThread;
 
+  CacheManager::instance()->save();
+
   qDeleteAll(m_readers);
 }
 
@@ -268,6 +279,15 @@ const ChartCover* ChartManager::getCover(quint32 chart_id,
                                          const WGS84Point &ne,
                                          const GeoProjection *p) {
   if (!m_coverCache.contains(chart_id)) {
+    // precomputed by the updater
+    QSqlQuery r0 = m_db.prepare("select cover from m.charts where chart_id=?");
+    r0.bindValue(0, chart_id);
+    m_db.exec(r0);
+    if (r0.first() && ChartCover::IsValid(r0.value(0).toByteArray())) {
+      m_coverCache.insert(chart_id, new ChartCover(r0.value(0).toByteArray(), sw, ne, p));
+      return m_coverCache[chart_id];
+    }
+
     QSqlQuery r = m_db.prepare("select c.id, c.type_id, p.x, p.y "
                                "from m.polygons p "
                                "join m.coverage c on p.cov_id = c.id "
@@ -311,10 +331,14 @@ const ChartCover* ChartManager::getCover(quint32 chart_id,
 
 void ChartManager::updateCharts(const Camera *cam, quint32 flags) {
 
-  if (m_idleStack.size() != m_workers.size()) return;
+  if (m_jobs == nullptr) return;
 
-  m_viewport = m_viewport.translated(cam->geoprojection()->fromWGS84(m_ref));
+  const QPointF shift = cam->geoprojection()->fromWGS84(m_ref);
+  m_viewport = m_viewport.translated(shift);
   m_ref = cam->eye();
+  if (!shift.isNull()) {
+    m_motion = - shift;
+  }
 
   const QRectF vp = cam->boundingBox();
   // qCDebug(CMGR) << "ChartManager::updateCharts" << vp;
@@ -338,6 +362,7 @@ void ChartManager::updateCharts(const Camera *cam, quint32 flags) {
     m_viewArea.setHeight(m_viewArea.width() / cam->aspect());
   }
   m_viewArea.moveCenter(QPointF(0., 0.));
+  m_viewAreaCenter = cam->geoprojection()->toWGS84(m_viewArea.center());
 
   // sort available scales
   m_scale = cam->scale();
@@ -380,39 +405,58 @@ void ChartManager::updateCharts(const Camera *cam, quint32 flags) {
   const auto totarea = remainingArea.area();
   qreal noncov = 100;
 
-  for (quint32 selectedScale: scaleCandidates) {
-
-    // select charts
-    QSqlQuery r = m_db.prepare("select chart_id, swx, swy, nex, ney, path "
-                               "from m.charts "
-                               "where scale = ? and "
-                               "      swx < ? and swy < ? and "
-                               "      nex > ? and ney > ?");
-    r.bindValue(0, selectedScale);
-    r.bindValue(1, ne0.lng(sw0));
-    r.bindValue(2, ne0.lat());
-    r.bindValue(3, sw0.lng());
-    r.bindValue(4, sw0.lat());
+  // select charts
+  const auto candidates = m_db.selectCharts(scaleCandidates,
+                                            sw0.lng(), sw0.lat(),
+                                            ne0.lng(sw0), ne0.lat());
+
+  for (const ChartDatabase::ChartBox& candidate: candidates) {
+    if (noncov < .1) break;
+    const quint32 id = candidate.id;
+    auto sw = WGS84Point::fromLL(candidate.swx, candidate.swy);
+    auto ne = WGS84Point::fromLL(candidate.nex, candidate.ney);
+    auto c = getCover(id, sw, ne, cam->geoprojection());
+    auto reg = c->region(cam->geoprojection()) & remainingArea;
+    if (reg.isValid()) {
+      remainingArea -= reg;
+      noncov = remainingArea.area() / totarea * 100;
+      regions[id] = reg;
+      covers[id] = c->region(cam->geoprojection());
+      qCDebug(CMGR) << "chart" << id << candidate.scale << ", covers" << reg.area() / totarea * 100
+               << ", remaining" << noncov;
+    }
+  }
 
-    m_db.exec(r);
-    while (r.next() && noncov >= .1) {
-      quint32 id = r.value(0).toUInt();
-      auto sw = WGS84Point::fromLL(r.value(1).toDouble(), r.value(2).toDouble());
-      auto ne = WGS84Point::fromLL(r.value(3).toDouble(), r.value(4).toDouble());
-      auto c = getCover(id, sw, ne, cam->geoprojection());
-      auto reg = c->region(cam->geoprojection()) & remainingArea;
-      if (reg.isValid()) {
-        remainingArea -= reg;
-        noncov = remainingArea.area() / totarea * 100;
-        regions[id] = reg;
-        covers[id] = c->region(cam->geoprojection());
-        qCDebug(CMGR) << "chart" << id << selectedScale << ", covers" << reg.area() / totarea * 100
-                 << ", remaining" << noncov;
-      }
+  // prefetch candidates: the area ahead and the neighbouring scale bands
+  m_prefetchCandidates.clear();
+  if (!scaleCandidates.isEmpty()) {
+    QPointF dir = m_motion;
+    if (m_course.valid()) {
+      dir = QPointF(m_course.sin(), m_course.cos());
     }
-    if (noncov < .1) {
-      break;
+    const qreal len = std::sqrt(QPointF::dotProduct(dir, dir));
+    if (len > 0.) {
+      ScaleVector scales;
+      for (const ChartDatabase::ChartBox& candidate: candidates) {
+        if (regions.contains(candidate.id) && !scales.contains(candidate.scale)) {
+          scales << candidate.scale;
+        }
+      }
+      const QRectF ahead = m_viewArea.translated(dir.x() / len * m_viewArea.width(),
+                                                 dir.y() / len * m_viewArea.height());
+      const WGS84Point sw1 = cam->geoprojection()->toWGS84(ahead.topLeft());
+      const WGS84Point ne1 = cam->geoprojection()->toWGS84(ahead.bottomRight());
+      m_prefetchCandidates << m_db.selectCharts(scales,
+                                                sw1.lng(), sw1.lat(),
+                                                ne1.lng(sw1), ne1.lat());
     }
+    const int index = m_scales.indexOf(scaleCandidates.first());
+    ScaleVector bands;
+    if (index > 0) bands << m_scales[index - 1];
+    if (index >= 0 && index < m_scales.size() - 1) bands << m_scales[index + 1];
+    m_prefetchCandidates << m_db.selectCharts(bands,
+                                              sw0.lng(), sw0.lat(),
+                                              ne0.lng(sw0), ne0.lat());
   }
 
   // chartmanager::tognuplot(regions, m_viewArea, "regions");
@@ -423,12 +467,30 @@ void ChartManager::updateCharts(const Camera *cam, quint32 flags) {
 
 
 
+  m_chartCovers.clear();
+  for (auto it = regions.constBegin(); it != regions.constEnd(); ++it) {
+    // Note: inverted y-axis
+    m_chartCovers[it.key()] = it.value().toWGS84(cam->geoprojection());
+  }
+
+  // charts closest to the center of the view first
+  auto priority = [&regions] (quint32 id) {
+    const KV::Region& reg = regions[id];
+    if (reg.contains(QPointF(0., 0.))) return 0.;
+    return reg.boundingRect().center().manhattanLength();
+  };
+
   IDVector newCharts;
+  int creating = 0;
   for (auto id: regions.keys()) {
-    if (!m_chartIds.contains(id)) {
-      newCharts.append(id);
-    } else {
+    if (m_chartIds.contains(id)) {
       m_chartIds.remove(id);
+    } else if (m_jobs->isBusy(id)) {
+      // already being created or updated for a previous viewport,
+      // manageThreads takes care of it
+      creating += 1;
+    } else {
+      newCharts.append(id);
     }
   }
 
@@ -450,14 +512,15 @@ void ChartManager::updateCharts(const Camera *cam, quint32 flags) {
   }
   m_charts = charts;
 
-  bool noCharts = m_charts.isEmpty() && newCharts.isEmpty();
-  // create pending chart update data
+  bool noCharts = m_charts.isEmpty() && newCharts.isEmpty() && creating == 0;
+
+  ChartJobQueue::JobVector jobs;
+  // create chart update jobs
   for (S57Chart* c: m_charts) {
-    // Note: inverted y-axis
-    m_pendingStack.push(ChartData(c, m_scale, regions[c->id()].toWGS84(cam->geoprojection()),
-                        (flags & UpdateLookups) != 0));
+    jobs.append(ChartData(c, m_scale, m_chartCovers[c->id()],
+                          (flags & UpdateLookups) != 0, priority(c->id())));
   }
-  // create pending chart creation data
+  // create chart creation jobs
   if (!newCharts.isEmpty()) {
     QString sql = "select id, path from charts where id in (";
     sql += QString("?,").repeated(newCharts.size());
@@ -471,23 +534,15 @@ void ChartManager::updateCharts(const Camera *cam, quint32 flags) {
       const quint32 id = r.value(0).toUInt();
       const auto path = r.value(1).toString();
       qCDebug(CMGR) << "New chart" << path;
-      m_pendingStack.push(ChartData(id, path, m_scale,
-                                    regions[id].toWGS84(cam->geoprojection())));
+      jobs.append(ChartData(id, path, m_scale, m_chartCovers[id], priority(id)));
     }
   }
 
-  while (!m_pendingStack.isEmpty() && !m_idleStack.isEmpty()) {
-    const ChartData d = m_pendingStack.pop();
-    const quint32 index = m_idleStack.pop();
-    ChartUpdater* dest = m_workers[index];
-    if (d.chart != nullptr) {
-      QMetaObject::invokeMethod(dest, "updateChart",
-                                Q_ARG(const ChartData&, d));
-    } else {
-      QMetaObject::invokeMethod(dest, "createChart",
-                                Q_ARG(const ChartData&, d));
-    }
+  const int cancelled = m_jobs->reset(jobs);
+  if (cancelled > 0) {
+    qCDebug(CMGR) << "cancelled" << cancelled << "obsolete jobs";
   }
+  dispatchJobs();
 
   if (noCharts) {
     // qCDebug(CMGR) << "ChartManager::updateCharts: idle";
@@ -495,41 +550,55 @@ void ChartManager::updateCharts(const Camera *cam, quint32 flags) {
   }
 }
 
+void ChartManager::dispatchJobs() {
+  for (quint32 index: m_jobs->wake()) {
+    QMetaObject::invokeMethod(m_workers[index], "processJobs");
+  }
+}
 
+void ChartManager::flushCacheQueue() {
+  ChartVector busy;
+  while (!m_cacheQueue.isEmpty()) {
+    auto chart = m_cacheQueue.takeFirst();
+    if (m_jobs->isBusy(chart->id())) {
+      // still being updated, cache when done
+      busy.append(chart);
+      continue;
+    }
+    QMetaObject::invokeMethod(m_cacheWorker, "cacheChart",
+                              Q_ARG(S57Chart*, chart));
+  }
+  m_cacheQueue = busy;
+}
 
-void ChartManager::manageThreads(S57Chart* chart) {
+void ChartManager::manageThreads(S57Chart* chart, quint32 id, quint32 generation) {
   // qCDebug(CMGR) << "chartmanager: manageThreads";
 
-  if (chart != nullptr) {
-    auto chartId = chart->id();
-    if (!m_chartIds.contains(chartId)) {
-      m_chartIds[chartId] = m_charts.size();
+  m_jobs->finish(id);
+
+  if (chart != nullptr && !m_chartIds.contains(id)) {
+    // a new chart or a chart dropped while it was being updated
+    m_cacheQueue.removeOne(chart);
+    if (m_chartCovers.contains(id)) {
+      m_chartIds[id] = m_charts.size();
       m_charts.append(chart);
+      if (generation != m_jobs->generation()) {
+        // created for a previous viewport, bring it up to date asap
+        m_jobs->append(ChartData(chart, m_scale, m_chartCovers[id], false));
+      }
+    } else {
+      m_cacheQueue.append(chart);
     }
   }
 
-  auto dest = qobject_cast<ChartUpdater*>(sender());
-  if (!m_pendingStack.isEmpty()) {
-    const ChartData d = m_pendingStack.pop();
-    if (d.chart != nullptr) {
-      QMetaObject::invokeMethod(dest, "updateChart",
-                                Q_ARG(const ChartData&, d));
+  dispatchJobs();
 
-    } else {
-      QMetaObject::invokeMethod(dest, "createChart",
-                                Q_ARG(const ChartData&, d));
-    }
-  } else {
-    m_idleStack.push(dest->id());
-    while (!m_cacheQueue.isEmpty()) {
-      auto chart = m_cacheQueue.takeFirst();
-      QMetaObject::invokeMethod(m_cacheWorker, "cacheChart",
-                                Q_ARG(S57Chart*, chart));
-    }
+  if (!m_jobs->hasPending()) {
+    flushCacheQueue();
   }
 
-
-  if (m_idleStack.size() == m_workers.size()) {
+  if (m_jobs->isIdle()) {
+    m_viewCenter = m_viewAreaCenter;
     if (!m_hadCharts) {
       qCDebug(CMGR) << "chartmanager: manageThreads: active";
       emit active();
@@ -537,6 +606,40 @@ void ChartManager::manageThreads(S57Chart* chart) {
       // qCDebug(CMGR) << "chartmanager: manageThreads: charts updated";
       emit chartsUpdated(m_viewArea);
     }
+    prefetchCharts();
+  }
+}
+
+void ChartManager::prefetchCharts() {
+  IDVector ids;
+  for (const ChartDatabase::ChartBox& candidate: m_prefetchCandidates) {
+    if (ids.size() == maxPrefetch) break;
+    if (m_chartIds.contains(candidate.id)) continue;
+    if (m_prefetched.contains(candidate.id)) continue;
+    if (ids.contains(candidate.id)) continue;
+    ids.append(candidate.id);
+  }
+  // once per viewport update
+  m_prefetchCandidates.clear();
+
+  if (ids.isEmpty()) return;
+
+  QString sql = "select id, path from charts where id in (";
+  sql += QString("?,").repeated(ids.size());
+  sql = sql.replace(sql.length() - 1, 1, ")");
+  QSqlQuery r = m_db.prepare(sql);
+  for (int i = 0; i < ids.size(); i++) {
+    r.bindValue(i, QVariant::fromValue(ids[i]));
+  }
+  m_db.exec(r);
+  while (r.next()) {
+    const quint32 id = r.value(0).toUInt();
+    const auto path = r.value(1).toString();
+    qCDebug(CMGR) << "Prefetch chart" << path;
+    m_prefetched.insert(id);
+    QMetaObject::invokeMethod(m_cacheWorker, "prefetchChart",
+                              Q_ARG(quint32, id),
+                              Q_ARG(QString, path));
   }
 }
 
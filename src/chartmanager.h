@@ -24,7 +24,7 @@
 #include "geoprojection.h"
 #include <QRectF>
 #include <QMap>
-#include <QStack>
+#include <QSet>
 #include "chartdatabase.h"
 #include "chartcover.h"
 #include <QCache>
@@ -36,6 +36,7 @@ class S57ChartOutline;
 class QOpenGLContext;
 class ChartFileReader;
 class ChartFileReaderFactory;
+class ChartJobQueue;
 class UpdaterInterface;
 class QPainter;
 
@@ -66,6 +67,13 @@ public:
   const ChartVector& charts() const {return m_charts;}
   const GL::VertexVector& outlines() const {return m_outlines;}
   const ChartReaderVector& readers() const {return m_readers;}
+  // area covered by the paint data of the current charts
+  const QRectF& viewArea() const {return m_viewArea;}
+  // location of the centre of the view area as of the last chartsUpdated
+  const WGS84Point& viewCenter() const {return m_viewCenter;}
+
+  // course over ground for prefetching, invalid angle when not tracking
+  void setCourse(const Angle& course) {m_course = course;}
 
   // flags for updateCharts
   static const quint32 Force = 1;
@@ -89,18 +97,19 @@ public slots:
 
 private slots:
 
-  void manageThreads(S57Chart* chart);
+  void manageThreads(S57Chart* chart, quint32 id, quint32 generation);
   void manageInfoResponse(const S57::InfoType& info, quint32 tid);
   void updateChartSets();
 
 private:
 
-  using ChartDataStack = QStack<ChartData>;
-  using IDStack = QStack<quint32>;
   using UpdaterVector = QVector<ChartUpdater*>;
   using ThreadVector = QVector<GL::Thread*>;
 
   void createOutline(const WGS84Point& sw, const WGS84Point& ne);
+  void dispatchJobs();
+  void flushCacheQueue();
+  void prefetchCharts();
   void loadPlugins();
   const ChartCover* getCover(quint32 chart_id,
                              const WGS84Point& sw,
@@ -110,12 +119,14 @@ private:
 
   using IDVector = QVector<quint32>;
   using IDMap = QMap<quint32, quint32>;
+  using CoverMap = QMap<quint32, WGS84PointVector>;
   using ScaleVector = QVector<quint32>;
 
   static constexpr float viewportFactor = 1.9;
   static constexpr float marginFactor = 1.08;
   static constexpr float maxScaleRatio = 32;
   static constexpr float maxScale = 25000000;
+  static const inline int maxPrefetch = 8;
 
   ChartManager(QObject *parent = nullptr);
   ChartManager(const ChartManager&) = delete;
@@ -127,14 +138,23 @@ private:
   WGS84Point m_ref;
   QRectF m_viewport;
   QRectF m_viewArea;
+  // centre of m_viewArea, published as m_viewCenter when the charts are updated
+  WGS84Point m_viewAreaCenter;
+  WGS84Point m_viewCenter;
   quint32 m_scale;
   IDMap m_chartIds;
+  // covers of the charts wanted in the current viewport
+  CoverMap m_chartCovers;
+
+  Angle m_course;
+  QPointF m_motion;
+  ChartDatabase::ChartBoxVector m_prefetchCandidates;
+  QSet<quint32> m_prefetched;
   ScaleVector m_scales;
 
   UpdaterVector m_workers;
   ThreadVector m_threads;
-  IDStack m_idleStack;
-  ChartDataStack m_pendingStack;
+  ChartJobQueue* m_jobs;
 
   QMap<quint32, quint8> m_transactions;
   quint32 m_transactionCounter;
@@ -28,21 +28,31 @@
 #include "shader.h"
 #include <QOpenGLFramebufferObject>
 #include <QVector>
+#include <utility>
+#include <cmath>
+#include <algorithm>
 #include "orthocam.h"
 #include "platform.h"
+#include "textmanager.h"
 
 ChartPainter::ChartPainter(QObject* parent)
   : Drawable(parent)
   , m_manager(ChartManager::instance())
   , m_initialized(false)
   , m_bufSize()
+  , m_bufScale(0.)
+  , m_bufState()
+  , m_bufCam(nullptr)
   , m_fbo(nullptr)
+  , m_backFbo(nullptr)
   , m_coordBuffer(QOpenGLBuffer::VertexBuffer)
   , m_indexBuffer(QOpenGLBuffer::IndexBuffer)
 {}
 
 ChartPainter::~ChartPainter() {
   delete m_fbo;
+  delete m_backFbo;
+  delete m_bufCam;
 }
 
 void ChartPainter::initializeGL() {
@@ -113,29 +123,134 @@ void ChartPainter::paintGL(const Camera *cam) {
   funcs->glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 }
 
+// The part of a buffer drawn with bufCam that lies inside the view area
+// centred at center, i.e. where the charts have paint data. The view area
+// is axis-aligned in the chart projection, so a rotated buffer gets the
+// largest centred rectangle inside it.
+static QRect CoverRect(const Camera* bufCam, const QSize& bufSize, qreal scale,
+                       const QRectF& viewArea, const WGS84Point& center) {
+  if (!center.valid() || viewArea.isEmpty()) return QRect();
+
+  const QPointF c = bufCam->position(center);
+  const QPointF p(.5 * (c.x() + 1.) * bufSize.width(),
+                  .5 * (c.y() + 1.) * bufSize.height());
+
+  const qreal a = .5 * viewArea.width() * scale;
+  const qreal b = .5 * viewArea.height() * scale;
+  const qreal cs = qAbs(bufCam->northAngle().cos());
+  const qreal sn = qAbs(bufCam->northAngle().sin());
+  const qreal t = std::min(a / (a * cs + b * sn), b / (a * sn + b * cs));
+
+  // leave a pixel for the differences between the projections
+  const qreal w = t * a - 1.;
+  const qreal h = t * b - 1.;
+  if (w <= 0. || h <= 0.) return QRect();
+
+  return QRect(QPoint(std::ceil(p.x() - w), std::ceil(p.y() - h)),
+               QPoint(std::floor(p.x() + w) - 1, std::floor(p.y() + h) - 1));
+}
+
 void ChartPainter::updateCharts(const Camera* cam, const QRectF& viewArea) {
 
-  m_ref = cam->eye();
   m_viewArea = viewArea;
 
-  auto bufCam = createBufferCamera(cam, viewArea.size());
-  qreal scale = .5 * bufCam->heightMM() * dots_per_mm_y() * bufCam->projection()(1, 1);
+  auto bufCam = createBufferCamera(cam, cam->eye(), viewArea.size());
+  const qreal scale = .5 * bufCam->heightMM() * dots_per_mm_y() * bufCam->projection()(1, 1);
+
+  const QSize bufSize = QSizeF(viewArea.width() * scale, viewArea.height() * scale).toSize();
+  const BufferState state = bufferState(cam);
+
+  // Reuse the previous contents if only the eye has moved: snap the new eye
+  // to whole pixels of the previous buffer camera so that the contents can
+  // be scrolled without resampling.
+  bool reuse = m_fbo != nullptr &&
+      m_bufSize == bufSize &&
+      state == m_bufState &&
+      qAbs(scale - m_bufScale) * viewArea.width() < .5;
+
+  const QRect full(QPoint(0, 0), bufSize);
+
+  // Only the pixels drawn inside the cover of the paint data are kept: the
+  // eye may have moved away from the cover while the charts were updated.
+  QPoint shift;
+  QRegion retained;
+  if (reuse) {
+    const QPointF c = m_bufCam->position(cam->eye());
+    shift = QPoint(qRound(.5 * c.x() * bufSize.width()),
+                   qRound(.5 * c.y() * bufSize.height()));
+    retained = m_bufValid.translated(- shift) & full;
+    reuse = !retained.isEmpty();
+  }
 
-  const QSizeF bufSize(viewArea.width() * scale, viewArea.height() * scale);
-  if (m_bufSize != bufSize) {
-    m_bufSize = bufSize;
-    delete m_fbo;
-    QOpenGLFramebufferObjectFormat fmt;
-    fmt.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
-    m_fbo = new QOpenGLFramebufferObject(bufSize.toSize(), fmt);
+  if (reuse && shift.isNull() && retained == QRegion(full)) {
+    // nothing to update
+    delete bufCam;
+    return;
+  }
+
+  if (reuse) {
+    const QPointF c(2. * shift.x() / bufSize.width(), 2. * shift.y() / bufSize.height());
+    delete bufCam;
+    bufCam = createBufferCamera(cam, m_bufCam->location(c), viewArea.size());
   }
 
-  // qCDebug(CDPY) << "updateCharts:" << bufSize << viewArea.size();
+  m_ref = bufCam->eye();
 
-  m_fbo->bind();
+  const QRect cover = CoverRect(bufCam, bufSize, scale, viewArea, m_manager->viewCenter()) & full;
+
+  QOpenGLFramebufferObjectFormat fmt;
+  fmt.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+  if (m_fbo == nullptr || m_fbo->size() != bufSize) {
+    delete m_fbo;
+    m_fbo = new QOpenGLFramebufferObject(bufSize, fmt);
+  }
+  if (reuse && !shift.isNull() && (m_backFbo == nullptr || m_backFbo->size() != bufSize)) {
+    delete m_backFbo;
+    m_backFbo = new QOpenGLFramebufferObject(bufSize, fmt);
+  }
+
+  // qCDebug(CDPY) << "updateCharts:" << bufSize << viewArea.size() << shift;
 
   auto f = QOpenGLContext::currentContext()->extraFunctions();
 
+  // exposed areas in pixels
+  QRegion exposed;
+
+  if (reuse) {
+    if (!shift.isNull()) {
+      const QRect target = full & full.translated(- shift);
+      const QRect source = target.translated(shift);
+
+      f->glBindFramebuffer(GL_READ_FRAMEBUFFER, m_fbo->handle());
+      f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_backFbo->handle());
+      f->glBlitFramebuffer(source.x(), source.y(),
+                           source.x() + source.width(), source.y() + source.height(),
+                           target.x(), target.y(),
+                           target.x() + target.width(), target.y() + target.height(),
+                           GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+      std::swap(m_fbo, m_backFbo);
+    }
+    exposed = QRegion(full) - retained;
+    // every rectangle is a pass over all the charts
+    const int maxExposedRects = 4;
+    if (exposed.rectCount() > maxExposedRects) {
+      exposed = exposed.boundingRect();
+    }
+  } else {
+    exposed = full;
+  }
+
+  m_bufValid = (retained - exposed) + (exposed & cover);
+
+  delete m_bufCam;
+  m_bufCam = bufCam;
+  m_bufSize = bufSize;
+  m_bufScale = scale;
+  m_bufState = state;
+
+  m_fbo->bind();
+
   f->glEnable(GL_DEPTH_TEST);
   f->glDisable(GL_STENCIL_TEST);
   f->glDisable(GL_CULL_FACE);
@@ -143,7 +258,6 @@ void ChartPainter::updateCharts(const Camera* cam, const QRectF& viewArea) {
   f->glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
   f->glClearColor(.7, .7, .7, 1.);
-  f->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
   f->glViewport(0, 0, bufSize.width(), bufSize.height());
 
@@ -151,60 +265,164 @@ void ChartPainter::updateCharts(const Camera* cam, const QRectF& viewArea) {
     chart->updateModelTransform(bufCam);
   }
 
+  // Gather the non-empty (chart, priority, shader) combinations in drawing
+  // order: priority, then shader & texture, then chart buffers.
+  DrawPacketVector opaque;
   // draw opaque objects nearest (highest priority) first
   for (int i = S52::Lookup::PriorityCount - 1; i >= 0; i--) {
-    m_vectorShader->initializePaint();
-    for (S57Chart* chart: m_manager->charts()) {
-      chart->drawVectorSymbols(bufCam, i);
-    }
-    m_areaShader->initializePaint();
-    for (S57Chart* chart: m_manager->charts()) {
-      chart->drawAreas(bufCam, i);
-    }
+    appendPackets(opaque, Stage::VectorSymbols, i);
+    appendPackets(opaque, Stage::Areas, i);
   }
 
-  f->glEnable(GL_BLEND);
-
+  DrawPacketVector translucent;
   // draw translucent objects farthest first
   for (int i = 0; i < S52::Lookup::PriorityCount; i++) {
-    m_rasterShader->initializePaint();
-    for (S57Chart* chart: m_manager->charts()) {
-      chart->drawRasterSymbols(bufCam, i);
-    }
-    m_lineElemShader->initializePaint();
-    for (S57Chart* chart: m_manager->charts()) {
-      chart->drawLineElems(bufCam, i);
-    }
-    m_lineArrayShader->initializePaint();
-    for (S57Chart* chart: m_manager->charts()) {
-      chart->drawLineArrays(bufCam, i);
-    }
-    m_textShader->initializePaint();
-    for (S57Chart* chart: m_manager->charts()) {
-      chart->drawText(bufCam, i);
-    }
+    appendPackets(translucent, Stage::RasterSymbols, i);
+    appendPackets(translucent, Stage::LineElems, i);
+    appendPackets(translucent, Stage::LineArrays, i);
+    appendPackets(translucent, Stage::Text, i);
   }
 
-  // draw stencilled objects
-  for (S57Chart* chart: m_manager->charts()) {
-    chart->drawRasterPatterns(bufCam);
-    chart->drawVectorPatterns(bufCam);
+  f->glEnable(GL_SCISSOR_TEST);
+  for (const QRect& r: exposed.rects()) {
+    f->glScissor(r.x(), r.y(), r.width(), r.height());
+    f->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    drawCharts(bufCam, opaque, translucent);
   }
-
-  f->glDisable(GL_BLEND);
+  f->glDisable(GL_SCISSOR_TEST);
 
   m_fbo->bindDefault();
 
   f->glViewport(0, 0,
                 cam->heightMM() * cam->aspect() * dots_per_mm_x(),
                 cam->heightMM() * dots_per_mm_y());
+}
+
+void ChartPainter::drawCharts(const Camera* cam,
+                              const DrawPacketVector& opaque,
+                              const DrawPacketVector& translucent) const {
+
+  auto f = QOpenGLContext::currentContext()->extraFunctions();
+
+  drawPackets(cam, opaque);
+
+  f->glEnable(GL_BLEND);
+
+  drawPackets(cam, translucent);
 
-  delete bufCam;
+  // draw stencilled objects
+  for (S57Chart* chart: m_manager->charts()) {
+    chart->drawRasterPatterns(cam);
+    chart->drawVectorPatterns(cam);
+  }
+
+  f->glDisable(GL_BLEND);
+  f->glDisable(GL_STENCIL_TEST);
+}
+
+ChartPainter::BufferState ChartPainter::bufferState(const Camera* cam) const {
+  BufferState state;
+  for (const S57Chart* chart: m_manager->charts()) {
+    state.charts << chart->id();
+  }
+  state.scale = cam->scale();
+  state.northAngle = cam->northAngle().degrees();
+  state.presentation = S52::PresentationGeneration();
+  state.text = TextManager::instance()->generation();
+  return state;
+}
+
+void ChartPainter::appendPackets(DrawPacketVector& queue, Stage stage, int prio) const {
+  for (S57Chart* chart: m_manager->charts()) {
+    bool visible = false;
+    switch (stage) {
+    case Stage::VectorSymbols:
+      visible = chart->hasPaintData(prio, S57::PaintData::Type::VectorSymbols);
+      break;
+    case Stage::Areas:
+      visible = chart->hasPaintData(prio, S57::PaintData::Type::TriangleArrays) ||
+          chart->hasPaintData(prio, S57::PaintData::Type::TriangleElements);
+      break;
+    case Stage::RasterSymbols:
+      visible = chart->hasPaintData(prio, S57::PaintData::Type::RasterSymbols);
+      break;
+    case Stage::LineElems:
+      visible = chart->hasPaintData(prio, S57::PaintData::Type::LineElements);
+      break;
+    case Stage::LineArrays:
+      visible = chart->hasPaintData(prio, S57::PaintData::Type::LineArrays);
+      break;
+    case Stage::Text:
+      visible = chart->hasPaintData(prio, S57::PaintData::Type::TextElements);
+      break;
+    }
+    if (visible) {
+      queue.append(DrawPacket(stage, prio, chart));
+    }
+  }
+}
+
+void ChartPainter::initializeStage(Stage stage) const {
+  switch (stage) {
+  case Stage::VectorSymbols:
+    m_vectorShader->initializePaint();
+    break;
+  case Stage::Areas:
+    m_areaShader->initializePaint();
+    break;
+  case Stage::RasterSymbols:
+    m_rasterShader->initializePaint();
+    break;
+  case Stage::LineElems:
+    m_lineElemShader->initializePaint();
+    break;
+  case Stage::LineArrays:
+    m_lineArrayShader->initializePaint();
+    break;
+  case Stage::Text:
+    m_textShader->initializePaint();
+    TextManager::instance()->bind();
+    break;
+  }
+}
+
+void ChartPainter::drawPackets(const Camera* cam, const DrawPacketVector& queue) const {
+  bool first = true;
+  Stage stage = Stage::VectorSymbols;
+  for (const DrawPacket& p: queue) {
+    if (first || p.stage != stage) {
+      first = false;
+      stage = p.stage;
+      initializeStage(stage);
+    }
+    switch (stage) {
+    case Stage::VectorSymbols:
+      p.chart->drawVectorSymbols(cam, p.prio);
+      break;
+    case Stage::Areas:
+      p.chart->drawAreas(cam, p.prio);
+      break;
+    case Stage::RasterSymbols:
+      p.chart->drawRasterSymbols(cam, p.prio);
+      break;
+    case Stage::LineElems:
+      p.chart->drawLineElems(cam, p.prio);
+      break;
+    case Stage::LineArrays:
+      p.chart->drawLineArrays(cam, p.prio);
+      break;
+    case Stage::Text:
+      p.chart->drawText(cam, p.prio);
+      break;
+    }
+  }
 }
 
-Camera* ChartPainter::createBufferCamera(const Camera *cam, const QSizeF &vp) const {
+Camera* ChartPainter::createBufferCamera(const Camera *cam,
+                                        const WGS84Point& eye,
+                                        const QSizeF &vp) const {
   auto bufCam = new OrthoCam(vp,
-                             cam->eye(),
+                             eye,
                              cam->scale(),
                              GeoProjection::CreateProjection(cam->geoprojection()->className()));
 
@@ -21,6 +21,7 @@
 
 #include "drawable.h"
 #include <QOpenGLBuffer>
+#include <QRegion>
 #include <s57object.h>
 
 class S57Chart;
@@ -49,11 +50,63 @@ public:
   void initializeGL() override;
   void updateCharts(const Camera* cam, const QRectF& viewArea) override;
 
+  // forces the next updateCharts to redraw the whole backbuffer
+  void invalidate() {m_bufState = BufferState();}
+
   ~ChartPainter();
 
 private:
 
-  Camera* createBufferCamera(const Camera* cam, const QSizeF& vp) const;
+  Camera* createBufferCamera(const Camera* cam, const WGS84Point& eye, const QSizeF& vp) const;
+
+  // what the backbuffer contents depend on besides the buffer camera
+  struct BufferState {
+    QVector<quint32> charts;
+    quint32 scale = 0;
+    double northAngle = 0.;
+    int presentation = -1;
+    int text = -1;
+
+    bool operator== (const BufferState& other) const {
+      return charts == other.charts && scale == other.scale &&
+          northAngle == other.northAngle && presentation == other.presentation &&
+          text == other.text;
+    }
+  };
+
+  BufferState bufferState(const Camera* cam) const;
+
+  // shader passes in drawing order within a priority
+  enum class Stage: quint8 {
+    VectorSymbols,
+    Areas,
+    RasterSymbols,
+    LineElems,
+    LineArrays,
+    Text
+  };
+
+  struct DrawPacket {
+    DrawPacket(Stage s, int p, S57Chart* c)
+      : stage(s)
+      , prio(p)
+      , chart(c) {}
+
+    DrawPacket() = default;
+
+    Stage stage;
+    int prio;
+    S57Chart* chart;
+  };
+
+  using DrawPacketVector = QVector<DrawPacket>;
+
+  void appendPackets(DrawPacketVector& queue, Stage stage, int prio) const;
+  void initializeStage(Stage stage) const;
+  void drawPackets(const Camera* cam, const DrawPacketVector& queue) const;
+  void drawCharts(const Camera* cam,
+                  const DrawPacketVector& opaque,
+                  const DrawPacketVector& translucent) const;
 
   ChartManager* m_manager;
   GL::AreaShader* m_areaShader;
@@ -67,8 +120,15 @@ private:
   bool m_initialized;
   QRectF m_viewArea;
   WGS84Point m_ref;
-  QSizeF m_bufSize;
+  QSize m_bufSize;
+  qreal m_bufScale;
+  BufferState m_bufState;
+  // pixels of the backbuffer drawn inside the cover of the paint data
+  QRegion m_bufValid;
+  Camera* m_bufCam;
   QOpenGLFramebufferObject* m_fbo;
+  // previous contents are scrolled from m_fbo to m_backFbo when panning
+  QOpenGLFramebufferObject* m_backFbo;
 
   QOpenGLBuffer m_coordBuffer;
   QOpenGLBuffer m_indexBuffer;
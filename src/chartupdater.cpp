@@ -21,44 +21,71 @@
  */
 
 #include "chartupdater.h"
+#include "chartjobqueue.h"
 #include "s57chart.h"
 #include "cachereader.h"
-#include <QFileInfo>
+#include "cachemanager.h"
 #include <QDir>
 #include <QFile>
-#include <QStandardPaths>
+#include <QSaveFile>
 #include "logging.h"
 
-ChartData::ChartData(S57Chart* c, quint32 s, const WGS84PointVector& cs, bool upd)
+ChartData::ChartData(S57Chart* c, quint32 s, const WGS84PointVector& cs, bool upd,
+                     qreal prio)
   : chart(c)
-  , id(0)
+  , id(c->id())
   , path()
   , scale(s)
   , cover(cs)
   , updLup(upd)
+  , priority(prio)
+  , generation(0)
 {}
 
 ChartData::ChartData(quint32 i, const QString& pth,
-                     quint32 s, const WGS84PointVector& cs)
+                     quint32 s, const WGS84PointVector& cs, qreal prio)
   : chart(nullptr)
   , id(i)
   , path(pth)
   , scale(s)
   , cover(cs)
   , updLup(false)
+  , priority(prio)
+  , generation(0)
 {}
 
 
+void ChartUpdater::processJobs() {
+  ChartData d;
+  if (!m_jobs->take(m_id, d)) return;
+
+  if (d.chart != nullptr) {
+    updateChart(d);
+  } else {
+    createChart(d);
+  }
+  // one job at a time to let info requests through
+  QMetaObject::invokeMethod(this, "processJobs", Qt::QueuedConnection);
+}
+
+
 
 void ChartUpdater::createChart(const ChartData& d) {
   try {
     auto chart = new S57Chart(d.id, d.path);
     // qCDebug(CMGR) << "ChartUpdater::createChart";
     chart->updatePaintData(d.cover, d.scale);
-    emit done(chart);
+    if (!chart->fromCache()) {
+      // Persist the tessellated chart now instead of when it is dropped
+      // from the view. The cache thread encodes it from the geometry the
+      // chart kept. Charts are deleted on the cache thread, so emitting
+      // this before done keeps the chart alive until it is stored.
+      emit created(chart);
+    }
+    emit done(chart, d.id, d.generation);
   } catch (ChartFileError& e) {
     qWarning() << "Chart creation failed:" << e.msg();
-    emit done(nullptr);
+    emit done(nullptr, d.id, d.generation);
   }
 }
 
@@ -67,34 +94,51 @@ void ChartUpdater::updateChart(const ChartData& d) {
     d.chart->updateLookups();
   }
   d.chart->updatePaintData(d.cover, d.scale);
-  emit done(d.chart);
+  emit done(d.chart, d.id, d.generation);
 }
 
 void ChartUpdater::cacheChart(S57Chart *chart) {
   auto scoped = QScopedPointer<S57Chart>(chart);
+  storeChart(scoped.data());
+}
+
+void ChartUpdater::storeChart(S57Chart* chart) {
+  if (CacheReader::IsCached(chart->path())) return;
 
+  // not found or obsolete format - cache
+  if (!QDir().mkpath(CacheReader::CacheDir())) return;
+  // write to a temporary file and rename: a crash never leaves a
+  // partial cache file behind
+  QSaveFile file(CacheReader::CachePath(chart->path()));
+  if (!file.open(QFile::WriteOnly)) return;
+  chart->encode(file);
+  // write magic
   const auto id = CacheReader::CacheId(chart->path());
-  const auto base = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
-
-
-  const auto cacheDir = QString("%1/%2").arg(base).arg(baseAppName());
-  const auto cachePath = QString("%1/%2").arg(cacheDir).arg(QString(id));
-
-  if (!QFileInfo(cachePath).exists()) {
-    // not found - cache
-    if (!QDir().mkpath(cacheDir)) return;
-    QFile file(cachePath);
-    if (!file.open(QFile::WriteOnly)) return;
-    QDataStream stream(&file);
-    stream.setVersion(QDataStream::Qt_5_6);
-    stream.setByteOrder(QDataStream::LittleEndian);
-    // dummy magic - causes simultaneous read to fail
-    stream.writeRawData("00000000", 8);
-    scoped->encode(stream);
-    // write magic
-    file.seek(0);
-    stream.writeRawData(id.constData(), 8);
-    file.close();
+  file.seek(0);
+  file.write(id.constData(), 8);
+  if (!file.commit()) {
+    qCWarning(CMGR) << "Failed to write" << file.fileName();
+    return;
+  }
+
+  CacheManager::instance()->insert(chart->path());
+}
+
+void ChartUpdater::prefetchChart(quint32 id, const QString& path) {
+  if (CacheReader::IsCached(path)) {
+    // pull the cached chart into the page cache
+    QFile file(CacheReader::CachePath(path));
+    if (!file.open(QFile::ReadOnly)) return;
+    while (!file.atEnd()) {
+      file.read(1 << 16);
+    }
+    return;
+  }
+  // parse and cache
+  try {
+    cacheChart(new S57Chart(id, path));
+  } catch (ChartFileError& e) {
+    qWarning() << "Chart prefetch failed:" << e.msg();
   }
 }
 
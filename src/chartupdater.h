@@ -27,14 +27,17 @@
 #include "geoprojection.h"
 
 class S57Chart;
+class ChartJobQueue;
 
 struct ChartData {
 
   ChartData(S57Chart* c,
-            quint32 s, const WGS84PointVector& cover, bool upd);
+            quint32 s, const WGS84PointVector& cover, bool upd,
+            qreal prio = 0);
 
   ChartData(quint32 i, const QString& pth,
-            quint32 s, const WGS84PointVector& cover);
+            quint32 s, const WGS84PointVector& cover,
+            qreal prio = 0);
 
   S57Chart* chart;
   quint32 id;
@@ -42,6 +45,9 @@ struct ChartData {
   quint32 scale;
   WGS84PointVector cover;
   bool updLup;
+  // smaller is more urgent
+  qreal priority;
+  quint32 generation;
 
   ChartData() = default;
   ChartData(const ChartData&) = default;
@@ -54,7 +60,10 @@ class ChartUpdater: public QObject {
 
 public:
 
-  ChartUpdater(quint32 id): QObject(), m_id(id) {}
+  ChartUpdater(quint32 id, ChartJobQueue* jobs = nullptr)
+    : QObject()
+    , m_id(id)
+    , m_jobs(jobs) {}
 
   quint32 id() const {return m_id;}
 
@@ -62,14 +71,18 @@ public:
 
 public slots:
 
+  void processJobs();
   void updateChart(const ChartData& d);
   void createChart(const ChartData& d);
   void cacheChart(S57Chart* chart);
+  void storeChart(S57Chart* chart);
+  void prefetchChart(quint32 id, const QString& path);
   void requestInfo(S57Chart* chart, const WGS84Point& p, quint32 scale, quint32 tid);
 
 signals:
 
-  void done(S57Chart* chart);
+  void done(S57Chart* chart, quint32 id, quint32 generation);
+  void created(S57Chart* chart);
   void infoResponse(const S57::InfoType& info, quint32 tid);
 
 private:
@@ -78,6 +91,7 @@ private:
   ChartUpdater& operator=(const ChartUpdater&) = delete;
 
   quint32 m_id;
+  ChartJobQueue* m_jobs;
 
 };
 
@@ -31,6 +31,7 @@ Conf::MainWindow::MainWindow()
   m_defaults["window_geom"] = QSizeF(800, 600);
   m_defaults["last_geom"] = QSizeF(800, 600);
   m_defaults["full_screen"] = false;
+  m_defaults["chart_cache_size"] = 250;
   m_defaults["chart_folders"] = QVariantList();
 
   load();
@@ -34,6 +34,8 @@ public:
   CONF_DECL(WindowGeom, window_geom, QSizeF, toSizeF)
   CONF_DECL(LastGeom, last_geom, QSizeF, toSizeF)
   CONF_DECL(FullScreen, full_screen, bool, toBool)
+  // chart cache size budget in megabytes
+  CONF_DECL(ChartCacheSize, chart_cache_size, int, toInt)
 
   static void setChartFolders(const QStringList& v) {
     self()->m_chartFolders = v;
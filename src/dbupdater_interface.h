@@ -53,6 +53,10 @@ public slots:
     return asyncCall(QStringLiteral("fullSync"), paths);
   }
 
+  QDBusPendingReply<> watch(const QStringList& paths) {
+    return asyncCall(QStringLiteral("watch"), paths);
+  }
+
   QDBusReply<QString> ping() {
     return call(QStringLiteral("ping"));
   }
@@ -282,7 +282,7 @@ S57::PaintDataMap S52::PointSymbol::execute(const QVector<QVariant>& vals,
   QPointF loc = obj->geometry()->center();
   if (obj->geometry()->type() == S57::Geometry::Type::Point) {
     auto pt = dynamic_cast<const S57::Geometry::Point*>(obj->geometry());
-    if (pt->points().size() > 2) {
+    if (pt->points().size() > 2 && vals.size() > 2) {
       int i = vals[2].toInt();
       const auto ps = pt->points();
       loc = QPointF(ps[3 * i], ps[3 * i + 1]);
@@ -408,7 +408,7 @@ S57::PaintDataMap S52::Text::execute(const QVector<QVariant>& vals,
   QPointF loc = obj->geometry()->center();
   if (obj->geometry()->type() == S57::Geometry::Type::Point) {
     auto pt = dynamic_cast<const S57::Geometry::Point*>(obj->geometry());
-    if (pt->points().size() > 2) {
+    if (pt->points().size() > 2 && vals.size() > 9) {
       int i = vals[9].toInt();
       const auto ps = pt->points();
       loc = QPointF(ps[3 * i], ps[3 * i + 1]);
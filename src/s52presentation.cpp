@@ -20,187 +20,169 @@
 #include "s52presentation_p.h"
 #include "logging.h"
 #include <QDir>
+#include <QVarLengthArray>
+#include <cmath>
 #include <QStandardPaths>
 #include "s52names.h"
 
-S57::PaintDataMap S52::Lookup::execute(const S57::Object *obj) const {
+void S52::Lookup::compile() {
+  m_calls.clear();
 
-  int stackPos = 0;
   int immedPos = 0;
   int refPos = 0;
-
-  ValueStack stack(20);
-
-
-  S57::PaintDataMap paintData;
+  Call call;
+  call.function = nullptr;
 
   for (auto code: m_code) {
 
     switch (code) {
 
     case Code::Immed:
-      stack[stackPos++] = m_immed[immedPos++];
+      call.arguments.append(m_immed[immedPos++]);
       break;
 
-    case Code::Fun: {
-      auto fun = S52::FindFunction(m_references[refPos++]);
-      // qCDebug(CS52) << "function" << fun->name();
-      stackPos = 0;
-      paintData += fun->execute(stack, obj);
+    case Code::Fun:
+      call.function = S52::FindFunction(m_references[refPos++]);
+      if (call.arguments.size() < MinArguments) {
+        call.arguments.resize(MinArguments);
+      }
+      m_calls.append(call);
+      call.arguments.clear();
+      call.variables.clear();
       break;
-    }
 
     case Code::Var:
-      stack[stackPos++] = obj->attributeValue(m_references[refPos++]);
+      call.variables.append({call.arguments.size(), m_references[refPos++], false});
+      call.arguments.append(QVariant());
       break;
 
-    case Code::DefVar: {
-      QVariant v = obj->attributeValue(m_references[refPos++]);
-      QVariant d = m_immed[immedPos++];
-      if (v.isValid()) {
-        stack[stackPos++] = v;
-      } else {
-        stack[stackPos++] = d;
-      }
+    case Code::DefVar:
+      call.variables.append({call.arguments.size(), m_references[refPos++], true});
+      call.arguments.append(m_immed[immedPos++]);
       break;
-    }
+
     default:
       Q_ASSERT(false);
     }
   }
+}
+
+const S52::Lookup::ValueStack& S52::Lookup::arguments(const Call& call,
+                                                      const S57::Object* obj) const {
+  if (call.variables.isEmpty()) return call.arguments;
+
+  // One buffer per thread. QVector::resize keeps the capacity, so the
+  // buffer allocates only when a call needs more slots than any before.
+  thread_local ValueStack scratch(MinArguments);
+  scratch.resize(call.arguments.size());
+  std::copy(call.arguments.cbegin(), call.arguments.cend(), scratch.begin());
+  for (const Variable& v: call.variables) {
+    const QVariant value = obj->attributeValue(v.attribute);
+    if (value.isValid() || !v.hasDefault) {
+      scratch[v.position] = value;
+    }
+  }
+  return scratch;
+}
 
+S57::PaintDataMap S52::Lookup::execute(const S57::Object *obj) const {
+  S57::PaintDataMap paintData;
+  for (const Call& call: m_calls) {
+    paintData += call.function->execute(arguments(call, obj), obj);
+  }
   return paintData;
 }
 
 QString S52::Lookup::description(const S57::Object* obj) const {
-
-  // TODO: remove duplicate code: execute / description are almost identical
-  int stackPos = 0;
-  int immedPos = 0;
-  int refPos = 0;
-
-  ValueStack stack(20);
-
-
   QStringList descriptions;
-
-  for (auto code: m_code) {
-
-    switch (code) {
-
-    case Code::Immed:
-      stack[stackPos++] = m_immed[immedPos++];
-      break;
-
-    case Code::Fun: {
-      auto fun = S52::FindFunction(m_references[refPos++]);
-      // qCDebug(CS52) << "function" << fun->name();
-      stackPos = 0;
-      descriptions += fun->descriptions(stack, obj);
-      break;
-    }
-
-    case Code::Var:
-      stack[stackPos++] = obj->attributeValue(m_references[refPos++]);
-      break;
-
-    case Code::DefVar: {
-      QVariant v = obj->attributeValue(m_references[refPos++]);
-      QVariant d = m_immed[immedPos++];
-      if (v.isValid()) {
-        stack[stackPos++] = v;
-      } else {
-        stack[stackPos++] = d;
-      }
-      break;
-    }
-    default:
-      Q_ASSERT(false);
-    }
+  for (const Call& call: m_calls) {
+    descriptions += call.function->descriptions(arguments(call, obj), obj);
   }
-
   return descriptions.join("; ");
 }
 
-
 void S52::Lookup::paintIcon(QPainter& painter, const S57::Object* obj) const {
+  for (const Call& call: m_calls) {
+    call.function->paintIcon(painter, arguments(call, obj), obj);
+  }
+}
 
-  int stackPos = 0;
-  int immedPos = 0;
-  int refPos = 0;
-
-  ValueStack stack(20);
-
-
-  for (auto code: m_code) {
-
-    switch (code) {
-
-    case Code::Immed:
-      stack[stackPos++] = m_immed[immedPos++];
-      break;
-
-    case Code::Fun: {
-      auto fun = S52::FindFunction(m_references[refPos++]);
-      // qCDebug(CS52) << "function" << fun->name();
-      stackPos = 0;
-      fun->paintIcon(painter, stack, obj);
-      break;
-    }
-
-    case Code::Var:
-      stack[stackPos++] = obj->attributeValue(m_references[refPos++]);
-      break;
 
-    case Code::DefVar: {
-      QVariant v = obj->attributeValue(m_references[refPos++]);
-      QVariant d = m_immed[immedPos++];
-      if (v.isValid()) {
-        stack[stackPos++] = v;
-      } else {
-        stack[stackPos++] = d;
-      }
-      break;
-    }
-    default:
-      Q_ASSERT(false);
+static bool Matches(const S57::Attribute* a,
+                    const Private::Presentation::Constraint& c) {
+  using Type = S57::Attribute::Type;
+
+  if (a == nullptr) return false;
+  if (c.type == Type::Any) return a->type() != Type::None;
+  if (c.type == Type::None) return a->type() == Type::None;
+  if (a->type() != c.type) return false;
+
+  switch (c.type) {
+  case Type::Integer:
+    return a->value().toInt() == c.intValue;
+  case Type::Real:
+    return std::abs(a->value().toDouble() - c.realValue) < 1.e-6;
+  case Type::IntegerList: {
+    // exact match, not just up to constraint list size
+    const QVariantList values = a->value().toList();
+    if (values.size() != c.intValues.size()) return false;
+    for (int i = 0; i < values.size(); i++) {
+      if (values[i].toInt() != c.intValues[i]) return false;
     }
+    return true;
+  }
+  case Type::String:
+    return a->value().toString() == c.stringValue;
+  default:
+    return false;
   }
 }
 
-
 S52::Lookup* S52::FindLookup(const S57::Object* obj) {
   const quint32 code = obj->classCode();
   const Private::Presentation* p = Private::Presentation::instance();
-  const S52::Lookup::Type t = p->typeFilter(obj);
-
-  using LookupVector = QVector<Lookup*>;
-
-  // ordered by attribute count and rcid
-  const LookupVector lups = p->lookupTable[t][code];
-
-  for (Lookup* lup: lups) {
-    if (lup->attributes().isEmpty()) {
-      return lup;
+  const int t = static_cast<int>(p->typeFilter(obj));
+
+  const auto& classes = p->matchers[t];
+  const auto cl = classes.constFind(code);
+  if (cl != classes.cend()) {
+    const Private::Presentation::ClassMatcher& cm = cl.value();
+
+    // object attributes by slot
+    QVarLengthArray<const S57::Attribute*, 16> attrs(cm.attributes.size());
+    quint64 present = 0;
+    const S57::AttributeMap& objAttrs = obj->attributes();
+    for (int slot = 0; slot < cm.attributes.size(); slot++) {
+      const auto a = objAttrs.constFind(cm.attributes[slot]);
+      if (a == objAttrs.cend()) {
+        attrs[slot] = nullptr;
+        continue;
+      }
+      attrs[slot] = &a.value();
+      if (slot < 64) present |= static_cast<quint64>(1) << slot;
     }
-    bool match = true;
-    for (auto it = lup->attributes().constBegin(); it != lup->attributes().constEnd(); ++it) {
-      if (!obj->attributes().contains(it.key())) {
-        match = false;
-        break;
+
+    // ordered by attribute count and rcid
+    for (const Private::Presentation::Matcher& m: cm.matchers) {
+      if ((m.required & present) != m.required) continue;
+      bool match = true;
+      for (int i = m.first; match && i < m.first + m.count; i++) {
+        const Private::Presentation::Constraint& c = cm.constraints[i];
+        match = Matches(attrs[c.slot], c);
       }
-      if (!obj->attributes()[it.key()].matches(it.value())) {
-        match = false;
-        break;
+      if (match) {
+        return m.lookup;
       }
     }
-    if (match) {
-      return lup;
-    }
   }
   // symbology for unknowns
   qCDebug(CS52) << "No match for" << S52::GetClassInfo(code) << obj->name();
-  return p->lookupTable[t][p->names["######"]][0];
+  return p->unknownLookups[t];
+}
+
+int S52::PresentationGeneration() {
+  const Private::Presentation* p = Private::Presentation::instance();
+  return p->generation.loadAcquire();
 }
 
 S52::Function* S52::FindFunction(quint32 index) {
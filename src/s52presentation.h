@@ -86,6 +86,10 @@ public:
   // bytecode interface
   enum class Code: quint8 {Immed, Var, Fun, DefVar};
 
+  // Turns the parsed bytecode into function calls with resolved functions
+  // and prefilled immediate arguments. Called once after parsing.
+  void compile();
+
 private:
 
   Type m_type;
@@ -109,9 +113,36 @@ private:
   ValueStack m_immed;
   ReferenceStack m_references;
 
+  // compiled bytecode
+  struct Variable {
+    int position;
+    quint32 attribute;
+    bool hasDefault;
+  };
+
+  // Functions read optional trailing arguments, e.g. the point index
+  // of SY and TX. Pad the arguments like the old 20 slot value stack.
+  static const int MinArguments = 20;
+
+  struct Call {
+    Function* function;
+    ValueStack arguments; // immediates in place
+    QVector<Variable> variables;
+  };
+
+  using CallVector = QVector<Call>;
+
+  CallVector m_calls;
+
+  // The arguments of call with the variables filled in from obj. Valid
+  // until the next call on the same thread.
+  const ValueStack& arguments(const Call& call, const S57::Object* obj) const;
+
 };
 
 Lookup* FindLookup(const S57::Object* obj);
+// Changes when settings affecting the results of Lookup::execute change
+int PresentationGeneration();
 Function* FindFunction(quint32 index);
 Function* FindFunction(const QString& name);
 QColor GetColor(quint32 index);
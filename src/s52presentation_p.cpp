@@ -49,6 +49,10 @@ Private::Presentation::Presentation()
   readChartSymbols();
   connect(Settings::instance(), &Settings::colorTableChanged,
           this, &Presentation::setColorTable);
+  connect(Settings::instance(), &Settings::settingsChanged,
+          this, &Presentation::nextGeneration);
+  connect(Settings::instance(), &Settings::lookupUpdateNeeded,
+          this, &Presentation::nextGeneration);
 
   setColorTable(static_cast<quint8>(Conf::MarinerParams::ColorTable()));
 
@@ -66,8 +70,12 @@ void Private::Presentation::setColorTable(quint8 t) {
     {CType::Night, "NIGHT"},
   };
   currentColorTable = names[tables[static_cast<CType>(t)]];
+  nextGeneration();
 }
 
+void Private::Presentation::nextGeneration() {
+  generation.fetchAndAddOrdered(1);
+}
 
 Private::Presentation* Private::Presentation::instance() {
   static Presentation* p = new Presentation();
@@ -392,6 +400,8 @@ void Private::Presentation::init() {
 
   functions = new S52::Functions();
 
+  compileLookups();
+
   for (LUPTableIterator tables(lookupTable.cbegin()); tables != lookupTable.cend(); ++tables) {
     const LookupHash& classes = tables.value();
     for (LUPHashIterator cl(classes.cbegin()); cl != classes.cend(); ++cl) {
@@ -401,7 +411,64 @@ void Private::Presentation::init() {
         if (err != 0) {
           qCWarning(CS52) << "Error parsing" << lup->source();
         }
+        lup->compile();
       }
     }
   }
 }
+
+void Private::Presentation::compileLookups() {
+  const int typeCount = static_cast<int>(S52::Lookup::Type::SymbolizedBoundaries) + 1;
+  matchers = QVector<ClassMatcherHash>(typeCount);
+  unknownLookups = QVector<S52::Lookup*>(typeCount, nullptr);
+  const quint32 unknown = names["######"];
+
+  for (LUPTableIterator tables(lookupTable.cbegin()); tables != lookupTable.cend(); ++tables) {
+    const int t = static_cast<int>(tables.key());
+    const LookupHash& classes = tables.value();
+    for (LUPHashIterator cl(classes.cbegin()); cl != classes.cend(); ++cl) {
+      ClassMatcher cm;
+      for (S52::Lookup* lup: cl.value()) {
+        Matcher m;
+        m.lookup = lup;
+        m.first = cm.constraints.size();
+        m.count = lup->attributes().size();
+        for (auto it = lup->attributes().cbegin(); it != lup->attributes().cend(); ++it) {
+          int slot = cm.attributes.indexOf(it.key());
+          if (slot < 0) {
+            slot = cm.attributes.size();
+            cm.attributes.append(it.key());
+          }
+          Constraint c;
+          c.slot = slot;
+          c.type = it.value().type();
+          const QVariant& v = it.value().value();
+          switch (c.type) {
+          case S57::Attribute::Type::Integer:
+            c.intValue = v.toInt();
+            break;
+          case S57::Attribute::Type::Real:
+            c.realValue = v.toDouble();
+            break;
+          case S57::Attribute::Type::IntegerList:
+            for (const QVariant& e: v.toList()) c.intValues.append(e.toInt());
+            break;
+          case S57::Attribute::Type::String:
+            c.stringValue = v.toString();
+            break;
+          default:
+            break;
+          }
+          // even None constraints require the attribute to be present
+          if (slot < 64) m.required |= static_cast<quint64>(1) << slot;
+          cm.constraints.append(c);
+        }
+        cm.matchers.append(m);
+      }
+      matchers[t].insert(cl.key(), cm);
+    }
+    if (classes.contains(unknown) && !classes[unknown].isEmpty()) {
+      unknownLookups[t] = classes[unknown].first();
+    }
+  }
+}
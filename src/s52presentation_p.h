@@ -20,6 +20,7 @@
 
 #include <QXmlStreamReader>
 #include <QHash>
+#include <QAtomicInt>
 #include "s52presentation.h"
 #include "types.h"
 
@@ -76,12 +77,14 @@ private:
   void readSymbolNames(QXmlStreamReader& reader);
 
   int parseInstruction(S52::Lookup* lup);
+  void compileLookups();
 
   quint32 m_nextSymbolIndex;
 
 private slots:
 
   void setColorTable(quint8 t);
+  void nextGeneration();
 
 public:
 
@@ -134,7 +137,41 @@ public:
 
   LookupTable lookupTable;
 
+  // Lookup tables compiled for matching in S52::FindLookup: the distinct
+  // attribute codes of a class get slots, constraint values are converted
+  // to native types.
+  struct Constraint {
+    int slot = 0;
+    S57::Attribute::Type type = S57::Attribute::Type::Any;
+    int intValue = 0;
+    double realValue = 0.;
+    QVector<int> intValues;
+    QString stringValue;
+  };
+  using ConstraintVector = QVector<Constraint>;
+
+  struct Matcher {
+    S52::Lookup* lookup = nullptr;
+    quint64 required = 0; // bitmask of slots that must be present
+    int first = 0; // first constraint
+    int count = 0;
+  };
+  using MatcherVector = QVector<Matcher>;
+
+  struct ClassMatcher {
+    QVector<quint32> attributes; // slot -> attribute code
+    ConstraintVector constraints;
+    MatcherVector matchers; // in lookupTable order
+  };
+  using ClassMatcherHash = QHash<quint32, ClassMatcher>; // key: class code
+
+  QVector<ClassMatcherHash> matchers; // index: lookup type
+  QVector<S52::Lookup*> unknownLookups; // index: lookup type
+
   S52::Functions* functions;
+
+  // incremented when the results of the S52 instructions may change
+  QAtomicInt generation;
 };
 
 } // namespace Private
@@ -19,11 +19,14 @@
  */
 #include "s57chart.h"
 #include <functional>
+#include <algorithm>
 #include "geoprojection.h"
 #include "s57object.h"
 #include "s52presentation.h"
 #include "s52names.h"
 #include <QDate>
+#include <QScopedPointer>
+#include <QDataStream>
 #include "shader.h"
 #include <QOpenGLExtraFunctions>
 #include <QOpenGLContext>
@@ -34,10 +37,67 @@
 #include "chartfilereader.h"
 #include "camera.h"
 #include "chartmanager.h"
+#include "cachereader.h"
 #include "geomutils.h"
 #include "logging.h"
 
 
+namespace {
+
+using MultiDrawArrays = void (QOPENGLF_APIENTRYP)(GLenum mode,
+                                                   const GLint* first,
+                                                   const GLsizei* count,
+                                                   GLsizei drawcount);
+
+// glMultiDrawArrays is not part of OpenGL ES: nullptr there
+MultiDrawArrays multiDrawArrays() {
+  auto ctx = QOpenGLContext::currentContext();
+  if (ctx->isOpenGLES()) return nullptr;
+  return reinterpret_cast<MultiDrawArrays>(ctx->getProcAddress("glMultiDrawArrays"));
+}
+
+// Draws the elements of d as triangle strips, one glMultiDrawArrays call
+// for each start parity on desktop OpenGL and one draw per element on
+// OpenGL ES. The elements share the uniforms, so the drawing order within
+// d does not matter.
+void drawLineStrips(QOpenGLExtraFunctions* f,
+                    MultiDrawArrays multiDraw,
+                    const S57::LineData* d) {
+  if (multiDraw == nullptr) {
+    GLuint parity = 2;
+    for (const S57::ElementData& e: d->elements()) {
+      const GLint first = d->firstVertex(e.offset);
+      if (static_cast<GLuint>(first / 2) % 2 != parity) {
+        parity = static_cast<GLuint>(first / 2) % 2;
+        d->setStartParity(parity);
+      }
+      f->glDrawArrays(GL_TRIANGLE_STRIP, first, 2 * (e.count - 2));
+    }
+    return;
+  }
+
+  thread_local QVector<GLint> firsts[2];
+  thread_local QVector<GLsizei> counts[2];
+  for (GLuint parity = 0; parity < 2; parity++) {
+    firsts[parity].resize(0);
+    counts[parity].resize(0);
+  }
+  for (const S57::ElementData& e: d->elements()) {
+    const GLint first = d->firstVertex(e.offset);
+    const GLuint parity = static_cast<GLuint>(first / 2) % 2;
+    firsts[parity].append(first);
+    counts[parity].append(2 * (e.count - 2));
+  }
+  for (GLuint parity = 0; parity < 2; parity++) {
+    if (firsts[parity].isEmpty()) continue;
+    d->setStartParity(parity);
+    multiDraw(GL_TRIANGLE_STRIP, firsts[parity].constData(),
+              counts[parity].constData(), firsts[parity].size());
+  }
+}
+
+}
+
 //
 // S57Chart
 //
@@ -57,6 +117,9 @@ public:
                     S57::Object* underling) const {
     obj->m_underlings.append(underling);
   }
+  void decodeValidity(S57::Object* obj) const {
+    obj->decodeValidity();
+  }
 };
 
 }
@@ -68,6 +131,7 @@ S57Chart::S57Chart(quint32 id, const QString& path)
   , m_path(path)
   , m_coordBuffer(QOpenGLBuffer::VertexBuffer)
   , m_indexBuffer(QOpenGLBuffer::IndexBuffer)
+  , m_lineBuffer(QOpenGLBuffer::VertexBuffer)
   , m_pivotBuffer(QOpenGLBuffer::VertexBuffer)
   , m_transformBuffer(QOpenGLBuffer::VertexBuffer)
   , m_textTransformBuffer(QOpenGLBuffer::VertexBuffer)
@@ -114,10 +178,32 @@ S57Chart::S57Chart(quint32 id, const QString& path)
   }
 
   S57::ObjectVector objects;
-  GL::VertexVector vertices;
-  GL::IndexVector indices;
-
-  reader->readChart(vertices, indices, objects, path, m_nativeProj);
+  GL::VertexVector vertexData;
+  GL::IndexVector indexData;
+  // cached charts are used directly from the mapped cache file
+  QScopedPointer<CacheReader::MappedChart> mapped;
+
+  const GLfloat* vertices;
+  const GLuint* indices;
+
+  auto cache = dynamic_cast<const CacheReader*>(reader);
+  m_fromCache = cache != nullptr;
+  if (cache != nullptr) {
+    mapped.reset(cache->mapChart(objects, path));
+    vertices = mapped->vertices();
+    indices = mapped->indices();
+    m_staticVertexOffset = mapped->vertexCount() * sizeof(GLfloat);
+    m_staticElemOffset = mapped->indexCount() * sizeof(GLuint);
+  } else {
+    reader->readChart(vertexData, indexData, objects, path, m_nativeProj);
+    vertices = vertexData.constData();
+    indices = indexData.constData();
+    m_staticVertexOffset = vertexData.size() * sizeof(GLfloat);
+    m_staticElemOffset = indexData.size() * sizeof(GLuint);
+    // keep the geometry for encode: the chart is cached from these
+    // copies without reading back the buffers
+    m_encodeData.reset(new EncodeData {vertexData, indexData, objects});
+  }
   // Assume scaling has been applied in reader->readChart
   m_nativeProj->setScaling(QSizeF(1., 1.));
 
@@ -137,6 +223,7 @@ S57Chart::S57Chart(quint32 id, const QString& path)
     m_lookups.append(ObjectLookup(object, lp));
 
     builder.setOthers(object, &m_locations, &m_contours);
+    builder.decodeValidity(object);
     // sort point objects by their locations
     const WGS84Point p = object->geometry()->centerLL();
     if (p.valid()) {
@@ -154,6 +241,20 @@ S57Chart::S57Chart(quint32 id, const QString& path)
       underlings.append(object);
     }
   }
+  clearPrototypes();
+
+  KV::RTree::RectVector boxes;
+  for (int i = 0; i < m_lookups.size(); i++) {
+    const QRectF& bbox = m_lookups[i].object->boundingBox();
+    if (bbox.isValid()) {
+      boxes.append(bbox);
+      m_boxed.append(i);
+    } else {
+      m_unboxed.append(i);
+    }
+  }
+  m_objectTree.build(boxes);
+
   // Iterator constructors not yet supported in Qt 5.6.3
   // ContourVector sorted(contours.begin(), contours.end());
   ContourVector sorted;
@@ -162,40 +263,42 @@ S57Chart::S57Chart(quint32 id, const QString& path)
   m_contours.append(sorted);
 
   for (auto overling: overlings) {
-    findUnderling(overling, underlings, vertices, indices);
+    findUnderling(overling, underlings,
+                  reinterpret_cast<const glm::vec2*>(vertices), indices);
   }
 
-  // fill in the buffers
+  // fill in the buffers: chart geometry is static, the rest is streamed
+  // in updatePaintData
   if (!m_coordBuffer.create()) qFatal("No can do");
-  m_coordBuffer.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+  m_coordBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
   m_coordBuffer.bind();
-  m_staticVertexOffset = vertices.size() * sizeof(GLfloat);
-  // add 10% extra space for vertices added later
-  m_coordBuffer.allocate(m_staticVertexOffset + m_staticVertexOffset / 10);
-  m_coordBuffer.write(0, vertices.constData(), m_staticVertexOffset);
+  m_coordBuffer.allocate(vertices, m_staticVertexOffset);
 
   m_indexBuffer.create();
-  m_indexBuffer.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+  m_indexBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
   m_indexBuffer.bind();
-  m_staticElemOffset = indices.size() * sizeof(GLuint);
-  // add 10% extra space for elements added later
-  m_indexBuffer.allocate(m_staticElemOffset + m_staticElemOffset / 10);
-  m_indexBuffer.write(0, indices.constData(), m_staticElemOffset);
+  m_indexBuffer.allocate(indices, m_staticElemOffset);
+
+  m_lineBuffer.create();
+  m_lineBuffer.setUsagePattern(QOpenGLBuffer::StreamDraw);
+  m_lineBuffer.bind();
+  // add 10% of the static vertex space for lines generated later
+  m_lineBuffer.allocate(m_staticVertexOffset / 10 + sizeof(GLfloat));
 
   m_pivotBuffer.create();
-  m_pivotBuffer.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+  m_pivotBuffer.setUsagePattern(QOpenGLBuffer::StreamDraw);
   m_pivotBuffer.bind();
   // 5K raster symbol/pattern instances
   m_pivotBuffer.allocate(5000 * 2 * sizeof(GLfloat));
 
   m_transformBuffer.create();
-  m_transformBuffer.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+  m_transformBuffer.setUsagePattern(QOpenGLBuffer::StreamDraw);
   m_transformBuffer.bind();
   // 3K vector symbol/pattern instances
   m_transformBuffer.allocate(3000 * 4 * sizeof(GLfloat));
 
   m_textTransformBuffer.create();
-  m_textTransformBuffer.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+  m_textTransformBuffer.setUsagePattern(QOpenGLBuffer::StreamDraw);
   m_textTransformBuffer.bind();
   // 5K char instances
   m_textTransformBuffer.allocate(5000 * 10 * sizeof(GLfloat));
@@ -209,6 +312,48 @@ void S57Chart::updateLookups() {
     lookups.append(ObjectLookup(p.object, S52::FindLookup(p.object)));
   }
   m_lookups = lookups;
+  clearPrototypes();
+}
+
+void S57Chart::clearPrototypes() {
+  for (S57::PaintDataMap& d: m_prototypes) {
+    for (S57::PaintMutIterator it = d.begin(); it != d.end(); ++it) {
+      delete it.value();
+    }
+  }
+  m_prototypes = QVector<S57::PaintDataMap>(m_lookups.size());
+  m_hasPrototype = QBitArray(m_lookups.size());
+  m_prototypeGeneration = S52::PresentationGeneration();
+}
+
+S57Chart::IndexVector S57Chart::candidates(const QRectF& box, bool unboxed) const {
+  IndexVector boxed;
+  for (auto item: m_objectTree.intersecting(box)) {
+    boxed.append(m_boxed[item]);
+  }
+  // m_boxed is ascending: so are the mapped indices
+  if (!unboxed || m_unboxed.isEmpty()) return boxed;
+
+  IndexVector merged(boxed.size() + m_unboxed.size());
+  std::merge(boxed.cbegin(), boxed.cend(),
+             m_unboxed.cbegin(), m_unboxed.cend(),
+             merged.begin());
+  return merged;
+}
+
+S57::PaintDataMap S57Chart::execute(int index) {
+  // the instructions depend only on the object and the presentation
+  // settings: run them once and hand out copies
+  if (!m_hasPrototype.testBit(index)) {
+    const ObjectLookup& d = m_lookups[index];
+    m_prototypes[index] = d.lookup->execute(d.object);
+    m_hasPrototype.setBit(index);
+  }
+  S57::PaintDataMap pd = m_prototypes[index];
+  for (S57::PaintMutIterator it = pd.begin(); it != pd.end(); ++it) {
+    it.value() = it.value()->clone();
+  }
+  return pd;
 }
 
 
@@ -221,19 +366,16 @@ S57Chart::~S57Chart() {
       delete it.value();
     }
   }
+  for (S57::PaintDataMap& d: m_prototypes) {
+    for (S57::PaintMutIterator it = d.begin(); it != d.end(); ++it) {
+      delete it.value();
+    }
+  }
   delete m_nativeProj;
 }
 
 
-void S57Chart::encode(QDataStream& stream) {
-  stream.setFloatingPointPrecision(QDataStream::DoublePrecision);
-
-  // header
-  const auto ref = m_nativeProj->reference();
-  stream << ref.lng() << ref.lat();
-
-  // coordinates
-  stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+void S57Chart::encode(QIODevice& device) {
 
   using GForm = std::function<glm::vec2 (const glm::vec2&)>;
 
@@ -249,34 +391,6 @@ void S57Chart::encode(QDataStream& stream) {
     };
   }
 
-  // vertices
-  m_coordBuffer.bind();
-  auto vertices = reinterpret_cast<const glm::vec2*>(m_coordBuffer.mapRange(0, m_staticVertexOffset, QOpenGLBuffer::RangeRead));
-  const int Nc = m_staticVertexOffset / sizeof(GLfloat) / 2;
-
-  stream << Nc;
-
-  for (int n = 0; n < Nc; n++) {
-    const glm::vec2 v = gform(vertices[n]);
-    stream << v.x << v.y;
-  }
-  m_coordBuffer.unmap();
-  m_coordBuffer.release();
-
-  // indices
-  m_indexBuffer.bind();
-  auto indices = reinterpret_cast<const GLuint*>(m_indexBuffer.mapRange(0, m_staticElemOffset, QOpenGLBuffer::RangeRead));
-  const int Ni = m_staticElemOffset / sizeof(GLuint);
-
-  stream << Ni;
-
-  for (int n = 0; n < Ni; n++) {
-    stream << indices[n];
-  }
-  m_indexBuffer.unmap();
-  m_indexBuffer.release();
-
-  // objects
   S57::Transform transform;
   // TODO: only mercator transforms supported for now
   if (geoProjection()->className() == "CM93Mercator") {
@@ -289,13 +403,126 @@ void S57Chart::encode(QDataStream& stream) {
     };
   }
 
-  const int No = m_lookups.size();
-  stream << No;
+  // the geometry read at construction or the static parts of the buffers
+  QScopedPointer<EncodeData> data(m_encodeData.take());
+  const bool readBack = data.isNull();
+  if (readBack) {
+    data.reset(new EncodeData);
+    for (const ObjectLookup& lup: m_lookups) {
+      data->objects.append(lup.object);
+    }
+  }
+
+  // objects
+  QByteArray objectData;
+  QVector<quint32> objectTable;
+  {
+    QDataStream stream(&objectData, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    for (const S57::Object* object: data->objects) {
+      objectTable << CacheReader::LittleEndian(static_cast<quint32>(stream.device()->pos()));
+      object->encode(stream, transform);
+    }
+    objectTable << CacheReader::LittleEndian(static_cast<quint32>(stream.device()->pos()));
+  }
+
+  // layout
+  const quint32 Nc = m_staticVertexOffset / sizeof(GLfloat);
+  const quint32 Ni = m_staticElemOffset / sizeof(GLuint);
+
+  CacheReader::Header h;
+  std::fill(h.id, h.id + 8, '0'); // dummy id - causes simultaneous read to fail
+  h.magic = CacheReader::Magic;
+  h.version = CacheReader::Version;
+  const auto ref = m_nativeProj->reference();
+  h.lng = ref.lng();
+  h.lat = ref.lat();
+  h.source = CacheReader::SourceStamp(m_path);
+  h.vertexOffset = CacheReader::Aligned(sizeof(CacheReader::Header));
+  h.vertexCount = Nc;
+  h.indexOffset = CacheReader::Aligned(h.vertexOffset + Nc * sizeof(GLfloat));
+  h.indexCount = Ni;
+  h.objectTableOffset = CacheReader::Aligned(h.indexOffset + Ni * sizeof(GLuint));
+  h.objectCount = data->objects.size();
+  h.objectDataOffset = CacheReader::Aligned(h.objectTableOffset +
+                                            objectTable.size() * sizeof(quint32));
+  h.objectDataSize = objectData.size();
+
+  auto pad = [&device] (quint32 offset) {
+    const QByteArray zeros(offset - device.pos(), '\0');
+    device.write(zeros);
+  };
+
+  const CacheReader::Header hle = CacheReader::LittleEndian(h);
+  device.write(reinterpret_cast<const char*>(&hle), sizeof(CacheReader::Header));
 
-  for (const ObjectLookup& lup: m_lookups) {
-    lup.object->encode(stream, transform);
+  // vertices
+  pad(h.vertexOffset);
+  const glm::vec2* vertices;
+  if (readBack) {
+    m_coordBuffer.bind();
+    vertices = reinterpret_cast<const glm::vec2*>(m_coordBuffer.mapRange(0, m_staticVertexOffset, QOpenGLBuffer::RangeRead));
+  } else {
+    vertices = reinterpret_cast<const glm::vec2*>(data->vertices.constData());
   }
+  GL::VertexVector coords(Nc);
+  for (quint32 n = 0; n < Nc / 2; n++) {
+    const glm::vec2 v = gform(vertices[n]);
+    coords[2 * n] = CacheReader::LittleEndian(v.x);
+    coords[2 * n + 1] = CacheReader::LittleEndian(v.y);
+  }
+  if (readBack) {
+    m_coordBuffer.unmap();
+    m_coordBuffer.release();
+  }
+  device.write(reinterpret_cast<const char*>(coords.constData()), Nc * sizeof(GLfloat));
 
+  // indices
+  pad(h.indexOffset);
+  const GLuint* indices;
+  if (readBack) {
+    m_indexBuffer.bind();
+    indices = reinterpret_cast<const GLuint*>(m_indexBuffer.mapRange(0, m_staticElemOffset, QOpenGLBuffer::RangeRead));
+  } else {
+    indices = data->indices.constData();
+  }
+  if (QSysInfo::ByteOrder == QSysInfo::LittleEndian) {
+    device.write(reinterpret_cast<const char*>(indices), Ni * sizeof(GLuint));
+  } else {
+    GL::IndexVector elems(Ni);
+    for (quint32 n = 0; n < Ni; n++) {
+      elems[n] = CacheReader::LittleEndian(indices[n]);
+    }
+    device.write(reinterpret_cast<const char*>(elems.constData()), Ni * sizeof(GLuint));
+  }
+  if (readBack) {
+    m_indexBuffer.unmap();
+    m_indexBuffer.release();
+  }
+
+  // object table & data
+  pad(h.objectTableOffset);
+  device.write(reinterpret_cast<const char*>(objectTable.constData()),
+               objectTable.size() * sizeof(quint32));
+  pad(h.objectDataOffset);
+  device.write(objectData);
+}
+
+// Orphans the old store before writing, so that the driver can hand out
+// fresh memory instead of waiting for draws still using the previous
+// contents. The store grows geometrically to avoid reallocating on every
+// update when the data size hovers around the capacity.
+static void StreamData(QOpenGLBuffer& buffer, const GL::VertexVector& data) {
+  buffer.bind();
+  const int len = sizeof(GLfloat) * data.size();
+  int size = buffer.size();
+  if (len > size) {
+    size = qMax(len, 2 * size);
+  }
+  buffer.allocate(size);
+  buffer.write(0, data.constData(), len);
 }
 
 void S57Chart::updatePaintData(const WGS84PointVector& cs, quint32 scale) {
@@ -337,7 +564,7 @@ void S57Chart::updatePaintData(const WGS84PointVector& cs, quint32 scale) {
 
   auto handleLine = [this, sf, &vertices] (const S57::PaintMutIterator& it, int prio) {
     auto p = dynamic_cast<S57::Globalizer*>(it.value());
-    const auto off = m_staticVertexOffset + vertices.size() * sizeof(GLfloat);
+    const auto off = vertices.size() * sizeof(GLfloat);
     auto pn = p->globalize(off, sf);
     vertices += p->vertices(sf);
     delete p;
@@ -376,12 +603,62 @@ void S57Chart::updatePaintData(const WGS84PointVector& cs, quint32 scale) {
     }
   };
 
+  // merge adjacent areas and lines sharing uniforms to cut down the draw calls
+  MergedPriorityVector areaArrays(S52::Lookup::PriorityCount);
+  MergedPriorityVector areaElements(S52::Lookup::PriorityCount);
+
+  auto areaKey = [] (const S57::PaintData* p) {
+    auto a = dynamic_cast<const S57::TriangleData*>(p);
+    return AreaKey(a->color().rgba(), a->vertexOffset());
+  };
+
+  auto mergeAreas = [areaKey] (MergedPriorityVector& areas, S57::PaintMutIterator it, int prio) {
+    MergedVector& merged = areas[prio];
+    if (!merged.isEmpty() && areaKey(merged.last()) == areaKey(it.value())) {
+      auto a0 = dynamic_cast<S57::TriangleData*>(merged.last());
+      a0->merge(dynamic_cast<S57::TriangleData*>(it.value()));
+      delete it.value();
+    } else {
+      merged.append(it.value());
+    }
+  };
+
+  auto mergeAreaArrays = [&areaArrays, &mergeAreas] (S57::PaintMutIterator it, int prio) {
+    mergeAreas(areaArrays, it, prio);
+  };
+  auto mergeAreaElements = [&areaElements, &mergeAreas] (S57::PaintMutIterator it, int prio) {
+    mergeAreas(areaElements, it, prio);
+  };
+
+  MergedPriorityVector lineElements(S52::Lookup::PriorityCount);
+
+  auto lineKey = [] (const S57::PaintData* p) {
+    auto l = dynamic_cast<const S57::LineData*>(p);
+    return LineKey(AreaKey(l->color().rgba(), l->vertexOffset()),
+                   QPair<GLfloat, GLuint>(l->lineWidth(), l->pattern()));
+  };
+
+  auto mergeLineElements = [&lineElements, lineKey] (S57::PaintMutIterator it, int prio) {
+    MergedVector& merged = lineElements[prio];
+    if (!merged.isEmpty() && lineKey(merged.last()) == lineKey(it.value())) {
+      auto l0 = dynamic_cast<S57::LineData*>(merged.last());
+      l0->merge(dynamic_cast<S57::LineData*>(it.value()));
+      delete it.value();
+    } else {
+      merged.append(it.value());
+    }
+  };
 
   PaintPriorityVector updates(S52::Lookup::PriorityCount);
 
+  if (m_prototypeGeneration != S52::PresentationGeneration()) {
+    clearPrototypes();
+  }
+
 //  int areaCount = 0;
 //  int filteredAreaCount = 0;
-  for (ObjectLookup& d: m_lookups) {
+  for (auto index: candidates(cover.boundingRect(), true)) {
+    const ObjectLookup& d = m_lookups[index];
 
 //    if (d.object->geometry()->type() == S57::Geometry::Type::Area && !S52::IsMetaClass(d.object->classCode())) {
 //      areaCount += 1;
@@ -408,7 +685,7 @@ void S57Chart::updatePaintData(const WGS84PointVector& cs, quint32 scale) {
       }
     }
 
-    S57::PaintDataMap pd = d.lookup->execute(d.object);
+    S57::PaintDataMap pd = execute(index);
 
     int prio = d.lookup->priority();
     // check category overrides
@@ -468,6 +745,10 @@ void S57Chart::updatePaintData(const WGS84PointVector& cs, quint32 scale) {
     parseLocals(S57::PaintData::Type::VectorLineStyles, pd, prio, mergeVectorSymbols);
     // merge text
     parseLocals(S57::PaintData::Type::TextElements, pd, prio, mergeText);
+    // merge areas & lines
+    parseLocals(S57::PaintData::Type::TriangleArrays, pd, prio, mergeAreaArrays);
+    parseLocals(S57::PaintData::Type::TriangleElements, pd, prio, mergeAreaElements);
+    parseLocals(S57::PaintData::Type::LineElements, pd, prio, mergeLineElements);
 
     m_paintData[prio] += pd;
   }
@@ -487,6 +768,20 @@ void S57Chart::updatePaintData(const WGS84PointVector& cs, quint32 scale) {
   updatePaintDatamap(rastersymbols, pivots);
   updatePaintDatamap(vectorsymbols, transforms);
 
+  // move merged areas & lines to paintdatamap: insert puts the value
+  // before the equal keys, so go backwards to keep the merge order
+  auto insertMerged = [this] (const MergedVector& items, int prio) {
+    for (auto it = items.crbegin(); it != items.crend(); ++it) {
+      m_paintData[prio].insert((*it)->type(), *it);
+    }
+  };
+
+  for (int i = 0; i < S52::Lookup::PriorityCount; i++) {
+    insertMerged(areaArrays[i], i);
+    insertMerged(areaElements[i], i);
+    insertMerged(lineElements[i], i);
+  }
+
   // filter area elements
   auto filterAreaElements = [this, cover] (S57::PaintData::Type t) {
     for (int i = 0; i < S52::Lookup::PriorityCount; i++) {
@@ -529,20 +824,8 @@ void S57Chart::updatePaintData(const WGS84PointVector& cs, quint32 scale) {
     }
   }
 
-  // update vertex buffer
-  m_coordBuffer.bind();
-  GLsizei dataLen = m_staticVertexOffset + sizeof(GLfloat) * vertices.size();
-  if (dataLen > m_coordBuffer.size()) {
-    auto staticData = new uchar[m_staticVertexOffset];
-    auto coords = m_coordBuffer.map(QOpenGLBuffer::ReadOnly);
-    memcpy(staticData, coords, m_staticVertexOffset);
-    m_coordBuffer.unmap();
-    m_coordBuffer.allocate(dataLen);
-    m_coordBuffer.write(0, staticData, m_staticVertexOffset);
-    delete [] staticData;
-  }
-
-  m_coordBuffer.write(m_staticVertexOffset, vertices.constData(), dataLen - m_staticVertexOffset);
+  // update line buffer
+  StreamData(m_lineBuffer, vertices);
 
   // Symbolized line updates to the transform buffer
   for (int prio = 0; prio < S52::Lookup::PriorityCount; prio++) {
@@ -558,34 +841,10 @@ void S57Chart::updatePaintData(const WGS84PointVector& cs, quint32 scale) {
     }
   }
 
-  // update transform buffer
-  m_transformBuffer.bind();
-  dataLen = sizeof(GLfloat) * transforms.size();
-  if (dataLen > m_transformBuffer.size()) {
-    m_transformBuffer.allocate(dataLen);
-  }
-
-  m_transformBuffer.write(0, transforms.constData(), dataLen);
-
-  // update pivot buffer
-  m_pivotBuffer.bind();
-  dataLen = sizeof(GLfloat) * pivots.size();
-  if (dataLen > m_pivotBuffer.size()) {
-    m_pivotBuffer.allocate(dataLen);
-  }
-
-  m_pivotBuffer.write(0, pivots.constData(), dataLen);
-
-
-  // update text transform buffer
-  m_textTransformBuffer.bind();
-  dataLen = sizeof(GLfloat) * textTransforms.size();
-  if (dataLen > m_textTransformBuffer.size()) {
-    m_textTransformBuffer.allocate(dataLen);
-  }
-
-  m_textTransformBuffer.write(0, textTransforms.constData(), dataLen);
-
+  // update transform, pivot & text transform buffers
+  StreamData(m_transformBuffer, transforms);
+  StreamData(m_pivotBuffer, pivots);
+  StreamData(m_textTransformBuffer, textTransforms);
 }
 
 qreal S57Chart::scaleFactor(const QRectF& va, quint32 scale) const {
@@ -610,24 +869,21 @@ void S57Chart::updateModelTransform(const Camera *cam) {
 
 void S57Chart::findUnderling(S57::Object *overling,
                               const S57::ObjectVector &candidates,
-                              const GL::VertexVector &vertices,
-                              const GL::IndexVector &indices) {
+                              const glm::vec2* qs,
+                              const GLuint* is) {
   const QPointF p = overling->geometry()->center();
 
   auto inbox = [] (const S57::ElementData& elem, const QPointF& p) {
     return elem.bbox.contains(p);
   };
 
-  auto closed = [indices] (const S57::ElementData& elem) {
+  auto closed = [is] (const S57::ElementData& elem) {
     auto first = elem.offset / sizeof(GLuint);
     auto last = first + elem.count - 1;
     // Note: adjacency
-    return indices[first + 1] == indices[last - 1];
+    return is[first + 1] == is[last - 1];
   };
 
-  auto qs = reinterpret_cast<const glm::vec2*>(vertices.constData());
-  auto is = indices.constData();
-
   for (S57::Object* c: candidates) {
     auto geom = dynamic_cast<const S57::Geometry::Line*>(c->geometry());
     const S57::ElementDataVector elems = geom->lineElements();
@@ -699,8 +955,9 @@ void S57Chart::drawLineArrays(const Camera* cam, int prio) {
   prog->setDepth(prio);
 
   auto f = QOpenGLContext::currentContext()->extraFunctions();
+  const MultiDrawArrays multiDraw = multiDrawArrays();
 
-  f->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_coordBuffer.bufferId());
+  f->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_lineBuffer.bufferId());
 
   const S57::PaintIterator end = m_paintData[prio].constEnd();
 
@@ -709,10 +966,8 @@ void S57Chart::drawLineArrays(const Camera* cam, int prio) {
   while (arr != end && arr.key() == S57::PaintData::Type::LineArrays) {
     auto d = dynamic_cast<const S57::LineArrayData*>(arr.value());
     d->setUniforms();
-    for (const S57::ElementData& e: d->elements()) {
-      d->setStorageOffsets(e.offset);
-      f->glDrawArrays(GL_TRIANGLE_STRIP, 0, 2 * (e.count - 2));
-    }
+    d->setVertexOffset();
+    drawLineStrips(f, multiDraw, d);
     ++arr;
   }
 }
@@ -724,6 +979,7 @@ void S57Chart::drawLineElems(const Camera* cam, int prio) {
   prog->setDepth(prio);
 
   auto f = QOpenGLContext::currentContext()->extraFunctions();
+  const MultiDrawArrays multiDraw = multiDrawArrays();
 
   f->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_coordBuffer.bufferId());
   f->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_indexBuffer.bufferId());
@@ -734,18 +990,15 @@ void S57Chart::drawLineElems(const Camera* cam, int prio) {
   while (elem != end && elem.key() == S57::PaintData::Type::LineElements) {
     auto d = dynamic_cast<const S57::LineElemData*>(elem.value());
     d->setUniforms();
-    for (const S57::ElementData& e: d->elements()) {
-      d->setStorageOffsets(e.offset);
-      f->glDrawArrays(GL_TRIANGLE_STRIP, 0, 2 * (e.count - 2));
-    }
+    d->setVertexOffset();
+    drawLineStrips(f, multiDraw, d);
     ++elem;
   }
 }
 
 void S57Chart::drawText(const Camera* cam, int prio) {
 
-  TextManager::instance()->bind();
-
+  // glyph texture is bound by the caller
   auto prog = GL::TextShader::instance();
 
   prog->setGlobals(cam, m_modelMatrix);
@@ -1024,7 +1277,8 @@ S57::InfoTypeFull S57Chart::objectInfoFull(const WGS84Point& p, quint32 scale) {
                                              {S57::Geometry::Type::Meta, 1}};
   QVector<WrappedDesc> wrapper;
 
-  for (const ObjectLookup& p: m_lookups) {
+  for (auto index: candidates(box, false)) {
+    const ObjectLookup& p = m_lookups[index];
 
     if (handled.contains(p.object->classCode())) continue;
     if (S52::IsMetaClass(p.object->classCode())) continue;
@@ -1123,7 +1377,7 @@ S57::InfoType S57Chart::objectInfo(const WGS84Point& wp, quint32 scale) {
   const KV::Region cover(box);
 
 
-  for (int i = 0; i < m_lookups.size(); ++i) {
+  for (auto i: candidates(box, true)) {
 
     const ObjectLookup& p = m_lookups[i];
     if (S52::IsMetaClass(p.object->classCode())) continue;
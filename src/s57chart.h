@@ -21,10 +21,13 @@
 
 #include "types.h"
 #include <QObject>
+#include <QBitArray>
 #include "s57object.h"
 #include "s52presentation.h"
+#include "rtree.h"
 #include <QOpenGLBuffer>
 #include <QMatrix4x4>
+#include <QScopedPointer>
 
 
 
@@ -46,7 +49,11 @@ class S57Chart: public QObject {
 public:
 
   S57Chart(quint32 id, const QString& path);
-  void encode(QDataStream& stream);
+  // Writes the chart in the chart cache format. A chart read from the
+  // chart file keeps its geometry for the first encode, which can then
+  // run on another thread while the chart is being drawn or updated.
+  // Later encodes read the geometry back from the buffers.
+  void encode(QIODevice& device);
 
   void updateModelTransform(const Camera* cam);
 
@@ -59,10 +66,16 @@ public:
   void drawVectorPatterns(const Camera* cam);
   void drawRasterPatterns(const Camera* cam);
 
+  bool hasPaintData(int prio, S57::PaintData::Type t) const {
+    return m_paintData[prio].contains(t);
+  }
+
   const GeoProjection* geoProjection() const {return m_nativeProj;}
 
   quint32 id() const {return m_id;}
   const QString& path() {return m_path;}
+  // true if the chart was read from the chart cache
+  bool fromCache() const {return m_fromCache;}
 
   void updatePaintData(const WGS84PointVector& cover, quint32 scale);
   void updateLookups();
@@ -110,15 +123,43 @@ private:
   using TextColorMutIterator = TextColorMap::iterator;
   using TextColorPriorityVector = QVector<TextColorMap>;
 
+  // Merged paint data in the draw order. Overlapping areas of the same
+  // priority share the depth and the first one drawn wins, so only runs of
+  // adjacent items are merged.
+  using MergedVector = QVector<S57::PaintData*>;
+  using MergedPriorityVector = QVector<MergedVector>;
+
+  // color & vertex offset
+  using AreaKey = QPair<QRgb, GLsizei>;
+
+  // color & vertex offset, line width & pattern
+  using LineKey = QPair<AreaKey, QPair<GLfloat, GLuint>>;
+
   qreal scaleFactor(const QRectF& va, quint32 scale) const;
 
+  S57::PaintDataMap execute(int index);
+
+  using IndexVector = QVector<quint32>;
+  // Indices of the objects whose bounding box intersects box in ascending
+  // order. Objects without a bounding box are included if unboxed is true.
+  IndexVector candidates(const QRectF& box, bool unboxed) const;
+  void clearPrototypes();
+
   void findUnderling(S57::Object* overling,
                      const S57::ObjectVector& candidates,
-                     const GL::VertexVector& vertices,
-                     const GL::IndexVector& indices);
+                     const glm::vec2* vertices,
+                     const GLuint* indices);
 
   GeoProjection* m_nativeProj;
   ObjectLookupVector m_lookups;
+  // memoised results of m_lookups[i].lookup->execute
+  QVector<S57::PaintDataMap> m_prototypes;
+  QBitArray m_hasPrototype;
+  int m_prototypeGeneration;
+  // spatial index of the objects with a valid bounding box
+  KV::RTree m_objectTree;
+  IndexVector m_boxed; // tree item -> m_lookups index
+  IndexVector m_unboxed;
   LocationHash m_locations;
   ContourVector m_contours;
   PaintPriorityVector m_paintData;
@@ -126,14 +167,25 @@ private:
   QString m_path;
   QOpenGLBuffer m_coordBuffer;
   QOpenGLBuffer m_indexBuffer;
+  // vertices of the lines generated in updatePaintData
+  QOpenGLBuffer m_lineBuffer;
   QOpenGLBuffer m_pivotBuffer;
   QOpenGLBuffer m_transformBuffer;
   QOpenGLBuffer m_textTransformBuffer;
   GLsizei m_staticVertexOffset;
   GLsizei m_staticElemOffset;
+  bool m_fromCache;
 
   QMatrix4x4 m_modelMatrix;
 
+  // static geometry and objects in reading order for encode
+  struct EncodeData {
+    GL::VertexVector vertices;
+    GL::IndexVector indices;
+    S57::ObjectVector objects;
+  };
+  QScopedPointer<EncodeData> m_encodeData;
+
   const QVector<quint32> m_infoSkipList;
   const QVector<quint32> m_navaids;
   const quint32 m_light;
@@ -25,6 +25,7 @@
 #include "region.h"
 #include "textmanager.h"
 #include "gnuplot.h"
+#include <algorithm>
 
 //
 // Paintdata
@@ -85,6 +86,36 @@ static void filterElems(S57::ElementDataVector& elems, const KV::Region& cover)
 
 void S57::TriangleData::filterElements(const KV::Region& cover) {
   filterElems(m_elements, cover);
+
+  // coalesce adjacent triangle lists into single draw calls
+  if (m_elements.size() < 2) return;
+
+  std::sort(m_elements.begin(), m_elements.end(), [] (const ElementData& e1, const ElementData& e2) {
+    return e1.offset < e2.offset;
+  });
+
+  const uintptr_t unit = m_type == Type::TriangleElements ? sizeof(GLuint) : 1;
+
+  ElementDataVector elems;
+  for (const ElementData& e: m_elements) {
+    if (!elems.isEmpty()) {
+      ElementData& prev = elems.last();
+      if (e.mode == GL_TRIANGLES && prev.mode == GL_TRIANGLES &&
+          prev.offset + prev.count * unit == e.offset) {
+        prev.count += e.count;
+        prev.bbox |= e.bbox;
+        continue;
+      }
+    }
+    elems << e;
+  }
+  m_elements = elems;
+}
+
+void S57::TriangleData::merge(const TriangleData* other) {
+  Q_ASSERT(other->m_type == m_type);
+  Q_ASSERT(other->m_vertexOffset == m_vertexOffset);
+  m_elements += other->m_elements;
 }
 
 S57::TriangleArrayData::TriangleArrayData(const ElementDataVector& elem, GLsizei offset, const QColor& c)
@@ -114,8 +145,10 @@ void S57::LineData::filterElements(const KV::Region& cover) {
 }
 
 
-void S57::LineData::setVertexOffset() const {
-  // noop
+void S57::LineData::merge(const LineData* other) {
+  Q_ASSERT(other->m_type == m_type);
+  Q_ASSERT(other->m_vertexOffset == m_vertexOffset);
+  m_elements += other->m_elements;
 }
 
 
@@ -137,13 +170,21 @@ void S57::LineElemData::setUniforms() const {
 }
 
 
-void S57::LineElemData::setStorageOffsets(uintptr_t offset) const {
+void S57::LineElemData::setVertexOffset() const {
   auto prog = GL::LineElemShader::instance();
   auto f = QOpenGLContext::currentContext()->extraFunctions();
   f->glUniform1ui(prog->m_locations.vertexOffset,
                   static_cast<GLuint>(m_vertexOffset / 2 / sizeof(GLfloat)));
-  f->glUniform1ui(prog->m_locations.indexOffset,
-                  static_cast<GLuint>(offset / sizeof(GLuint)));
+}
+
+GLint S57::LineElemData::firstVertex(uintptr_t offset) const {
+  return 2 * static_cast<GLint>(offset / sizeof(GLuint));
+}
+
+void S57::LineElemData::setStartParity(GLuint parity) const {
+  auto prog = GL::LineElemShader::instance();
+  auto f = QOpenGLContext::currentContext()->extraFunctions();
+  f->glUniform1ui(prog->m_locations.startParity, parity);
 }
 
 S57::LineArrayData::LineArrayData(const ElementDataVector& elem,
@@ -164,11 +205,21 @@ void S57::LineArrayData::setUniforms() const {
   f->glUniform1ui(prog->m_locations.pattern, m_pattern);
 }
 
-void S57::LineArrayData::setStorageOffsets(uintptr_t offset) const {
+void S57::LineArrayData::setVertexOffset() const {
   auto prog = GL::LineArrayShader::instance();
   auto f = QOpenGLContext::currentContext()->extraFunctions();
   f->glUniform1ui(prog->m_locations.vertexOffset,
-                  static_cast<GLuint>(m_vertexOffset / 2 / sizeof(GLfloat) + offset));
+                  static_cast<GLuint>(m_vertexOffset / 2 / sizeof(GLfloat)));
+}
+
+GLint S57::LineArrayData::firstVertex(uintptr_t offset) const {
+  return 2 * static_cast<GLint>(offset);
+}
+
+void S57::LineArrayData::setStartParity(GLuint parity) const {
+  auto prog = GL::LineArrayShader::instance();
+  auto f = QOpenGLContext::currentContext()->extraFunctions();
+  f->glUniform1ui(prog->m_locations.startParity, parity);
 }
 
 
@@ -189,7 +240,15 @@ void S57::LineLocalData::setUniforms() const {
   // noop
 }
 
-void S57::LineLocalData::setStorageOffsets(uintptr_t) const {
+void S57::LineLocalData::setVertexOffset() const {
+  // noop
+}
+
+GLint S57::LineLocalData::firstVertex(uintptr_t) const {
+  return 0;
+}
+
+void S57::LineLocalData::setStartParity(GLuint) const {
   // noop
 }
 
@@ -332,6 +391,17 @@ S57::SymbolPaintDataBase::SymbolPaintDataBase(Type t,
   , m_instanceCount(1)
 {}
 
+S57::SymbolPaintDataBase::SymbolPaintDataBase(const SymbolPaintDataBase& other)
+  : PaintData(other)
+  , m_type(other.m_type)
+  , m_index(other.m_index)
+  , m_offset(other.m_offset)
+  , m_helper(other.m_helper->clone())
+  , m_pivotOffset(other.m_pivotOffset)
+  , m_pivots(other.m_pivots)
+  , m_instanceCount(other.m_instanceCount)
+{}
+
 S57::SymbolPaintDataBase::~SymbolPaintDataBase() {
   delete m_helper;
 }
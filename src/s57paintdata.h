@@ -48,6 +48,8 @@ public:
 
   virtual void setUniforms() const = 0;
   virtual void setVertexOffset() const = 0;
+  // a copy of unprocessed paint data
+  virtual PaintData* clone() const = 0;
   Type type() const {return m_type;}
 
   virtual ~PaintData() = default;
@@ -67,6 +69,7 @@ public:
   void setVertexOffset() const override {/* noop */}
 
   OverrideData(bool uw);
+  PaintData* clone() const override {return new OverrideData(*this);}
 
   bool override() const {return m_override;}
 
@@ -82,6 +85,7 @@ public:
   void setVertexOffset() const override {/* noop */}
 
   PriorityData(int prio);
+  PaintData* clone() const override {return new PriorityData(*this);}
 
   int priority() const {return m_priority;}
 
@@ -100,6 +104,11 @@ public:
   const ElementDataVector& elements() const {return m_elements;}
   void filterElements(const KV::Region& viewArea);
 
+  const QColor& color() const {return m_color;}
+  GLsizei vertexOffset() const {return m_vertexOffset;}
+  // appends the elements of other: color and vertex offset must match
+  void merge(const TriangleData* other);
+
 protected:
 
   TriangleData(Type t, const ElementDataVector& elems, GLsizei offset, const QColor& c);
@@ -113,11 +122,13 @@ protected:
 class TriangleArrayData: public TriangleData {
 public:
   TriangleArrayData(const ElementDataVector& elem, GLsizei offset, const QColor& c);
+  PaintData* clone() const override {return new TriangleArrayData(*this);}
 };
 
 class TriangleElemData: public TriangleData {
 public:
   TriangleElemData(const ElementDataVector& elem, GLsizei offset, const QColor& c);
+  PaintData* clone() const override {return new TriangleElemData(*this);}
 };
 
 
@@ -125,12 +136,23 @@ class LineData: public PaintData {
 public:
 
   const ElementDataVector& elements() const {return m_elements;}
-  void setVertexOffset() const override;
 
-  virtual void setStorageOffsets(uintptr_t offset) const = 0;
+  // first strip vertex of an element: the element offset reaches the
+  // shader through gl_VertexID
+  virtual GLint firstVertex(uintptr_t offset) const = 0;
+  // parity of the first segment of the elements drawn next: keeps the
+  // dash pattern phase independent of the element offset
+  virtual void setStartParity(GLuint parity) const = 0;
 
   void filterElements(const KV::Region& viewArea);
 
+  const QColor& color() const {return m_color;}
+  GLfloat lineWidth() const {return m_lineWidth;}
+  GLuint pattern() const {return m_pattern;}
+  GLsizei vertexOffset() const {return m_vertexOffset;}
+  // appends the elements of other: uniforms must match
+  void merge(const LineData* other);
+
 
 protected:
 
@@ -158,8 +180,11 @@ public:
                GLfloat lw,
                uint pattern);
 
+  PaintData* clone() const override {return new LineElemData(*this);}
   void setUniforms() const override;
-  void setStorageOffsets(uintptr_t offset) const override;
+  void setVertexOffset() const override;
+  GLint firstVertex(uintptr_t offset) const override;
+  void setStartParity(GLuint parity) const override;
 };
 
 class LineArrayData: public LineData {
@@ -170,8 +195,11 @@ public:
                 GLfloat lw,
                 uint pattern);
 
+  PaintData* clone() const override {return new LineArrayData(*this);}
   void setUniforms() const override;
-  void setStorageOffsets(uintptr_t offset) const override;
+  void setVertexOffset() const override;
+  GLint firstVertex(uintptr_t offset) const override;
+  void setStartParity(GLuint parity) const override;
 };
 
 class Globalizer {
@@ -194,9 +222,12 @@ public:
 
   PaintData* globalize(GLsizei offset, qreal scale) const override;
   GL::VertexVector vertices(qreal scale) override;
+  PaintData* clone() const override {return new LineLocalData(*this);}
 
   void setUniforms() const override;
-  void setStorageOffsets(uintptr_t offset) const override;
+  void setVertexOffset() const override;
+  GLint firstVertex(uintptr_t offset) const override;
+  void setStartParity(GLuint parity) const override;
 
 private:
   GL::VertexVector m_vertices;
@@ -213,6 +244,7 @@ public:
   TextElemData(const QPointF& pivot,
                int ticket,
                const QColor& c);
+  PaintData* clone() const override {return new TextElemData(*this);}
 
   void merge(const TextElemData* other);
   void getInstances(GL::VertexVector& instances);
@@ -239,6 +271,7 @@ public:
   virtual void setSymbolOffset(const QPointF& off) const = 0;
   virtual void setVertexBufferOffset(GLsizei off) const = 0;
   virtual void setColor(const QColor& color) const = 0;
+  virtual SymbolHelper* clone() const = 0;
   virtual ~SymbolHelper() = default;
 };
 
@@ -249,6 +282,7 @@ public:
   void setSymbolOffset(const QPointF& off) const override;
   void setVertexBufferOffset(GLsizei off) const override;
   void setColor(const QColor& color) const override;
+  SymbolHelper* clone() const override {return new RasterHelper;}
 };
 
 class VectorHelper: public SymbolHelper {
@@ -257,6 +291,7 @@ public:
   void setSymbolOffset(const QPointF& off) const override;
   void setVertexBufferOffset(GLsizei off) const override;
   void setColor(const QColor& color) const override;
+  SymbolHelper* clone() const override {return new VectorHelper;}
 };
 
 class SymbolPaintDataBase: public PaintData {
@@ -281,6 +316,9 @@ protected:
                       const QPointF& offset,
                       SymbolHelper* helper);
 
+  SymbolPaintDataBase(const SymbolPaintDataBase& other);
+  SymbolPaintDataBase& operator=(const SymbolPaintDataBase&) = delete;
+
   S52::SymbolType m_type;
   quint32 m_index;
 
@@ -316,6 +354,7 @@ public:
                         const QPointF& pivot,
                         const ElementData& elem);
 
+  PaintData* clone() const override {return new RasterSymbolPaintData(*this);}
   const ElementData& element() const {return m_elem;}
 
 private:
@@ -340,6 +379,7 @@ public:
                         const KV::ColorVector& colors,
                         const ElementDataVector& elems);
 
+  PaintData* clone() const override {return new VectorSymbolPaintData(*this);}
   const ColorElementVector& elements() const {return m_elems;}
   void setColor(const QColor& c) const;
 
@@ -399,6 +439,7 @@ public:
                          const PatternMMAdvance& advance,
                          const ElementData& elem);
 
+  PaintData* clone() const override {return new RasterPatternPaintData(*this);}
   const ElementData& element() const {return m_elem;}
 
 protected:
@@ -423,6 +464,7 @@ public:
                          const KV::ColorVector& colors,
                          const ElementDataVector& elems);
 
+  PaintData* clone() const override {return new VectorPatternPaintData(*this);}
   const ColorElementVector& elements() const {return m_elems;}
   void setColor(const QColor& c) const;
 
@@ -450,6 +492,7 @@ public:
                      const ElementDataVector& elems);
 
   void merge(const SymbolPaintDataBase* other, qreal scale, const KV::Region& va) override;
+  PaintData* clone() const override {return new LineStylePaintData(*this);}
 
   void createTransforms(GL::VertexVector& transforms,
                         const QOpenGLBuffer& coordBuffer,
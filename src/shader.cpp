@@ -106,7 +106,7 @@ GL::LineElemShader::LineElemShader()
   m_locations.base_color = m_program->uniformLocation("base_color");
   m_locations.pattern = m_program->uniformLocation("pattern");
   m_locations.vertexOffset = m_program->uniformLocation("vertexOffset");
-  m_locations.indexOffset = m_program->uniformLocation("indexOffset");
+  m_locations.startParity = m_program->uniformLocation("startParity");
 }
 
 GL::LineArrayShader* GL::LineArrayShader::instance() {
@@ -134,6 +134,7 @@ GL::LineArrayShader::LineArrayShader()
   m_locations.base_color = m_program->uniformLocation("base_color");
   m_locations.pattern = m_program->uniformLocation("pattern");
   m_locations.vertexOffset = m_program->uniformLocation("vertexOffset");
+  m_locations.startParity = m_program->uniformLocation("startParity");
 }
 
 GL::TextShader* GL::TextShader::instance() {
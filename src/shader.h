@@ -108,7 +108,7 @@ private:
     int base_color;
     int pattern;
     int vertexOffset;
-    int indexOffset;
+    int startParity;
   } m_locations;
 };
 
@@ -135,6 +135,7 @@ private:
     int base_color;
     int pattern;
     int vertexOffset;
+    int startParity;
   } m_locations;
 };
 
@@ -32,6 +32,8 @@ TextManager::TextManager()
   , m_worker(new TextShaper(&m_mutex))
   , m_glyphTexture(new QOpenGLTexture(QOpenGLTexture::Target2D))
   , m_shapeTimer(new QTimer(this))
+  , m_generation(0)
+  , m_pending(0)
 {
   m_worker->moveToThread(m_thread);
   connect(m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
@@ -101,9 +103,14 @@ void TextManager::handleShape(const TextKey& key,
   m_shapeData[m_tickets[key]] = mesh->vertices;
   delete mesh;
 
+  m_pending.deref();
   m_shapeTimer->start();
 }
 
+bool TextManager::busy() const {
+  return m_pending.load() > 0 || m_shapeTimer->isActive();
+}
+
 int TextManager::ticket(const QString& txt, TXT::Weight weight,
                         TXT::HJust hjust, TXT::VJust vjust,
                         quint8 bodySize, qint8 offsetX, qint8 offsetY) {
@@ -119,6 +126,7 @@ int TextManager::ticket(const QString& txt, TXT::Weight weight,
   m_tickets[key] = ret;
   m_shapeData << GL::VertexVector();
 
+  m_pending.ref();
   QMetaObject::invokeMethod(m_worker, "shape",
                             Q_ARG(const TextKey&, key));
 
@@ -127,6 +135,7 @@ int TextManager::ticket(const QString& txt, TXT::Weight weight,
 
 void TextManager::requestUpdate() {
   m_shapeTimer->stop();
+  m_generation.ref();
   emit newStrings();
 }
 
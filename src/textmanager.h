@@ -27,6 +27,7 @@
 #include <QOpenGLBuffer>
 #include <QMutex>
 #include <QSharedData>
+#include <QAtomicInt>
 
 class QThread;
 class TextShaper;
@@ -172,6 +173,12 @@ public:
 
   void bind();
 
+  // bumped each time new strings become available
+  int generation() const {return m_generation.load();}
+
+  // true while strings are being shaped or newStrings is due
+  bool busy() const;
+
   ~TextManager();
 
 
@@ -196,6 +203,8 @@ private:
   DataVector m_shapeData;
   QOpenGLTexture* m_glyphTexture;
   QTimer* m_shapeTimer;
+  QAtomicInt m_generation;
+  QAtomicInt m_pending; // strings sent to the shaper
 };
 
 
@@ -0,0 +1,156 @@
+/* -*- coding: utf-8-unix -*-
+ *
+ * test_rtree.cpp
+ *
+ * Copyright (C) 2021 Jukka Sirkka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtTest/QTest>
+#include "rtree.h"
+#include <random>
+#include <algorithm>
+
+class TestRTree: public QObject {
+
+  Q_OBJECT
+
+private slots:
+
+  void testEmpty();
+  void testTouching();
+  void testRandom_data();
+  void testRandom();
+
+private:
+
+  using RectVector = KV::RTree::RectVector;
+  using IndexVector = KV::RTree::IndexVector;
+
+  static IndexVector BruteForce(const RectVector& items, const QRectF& box);
+  static bool Ascending(const IndexVector& indices);
+};
+
+KV::RTree::IndexVector TestRTree::BruteForce(const RectVector& items, const QRectF& box) {
+  IndexVector result;
+  const QRectF q = box.normalized();
+  for (int i = 0; i < items.size(); i++) {
+    if (items[i].intersects(q)) {
+      result.append(i);
+    }
+  }
+  return result;
+}
+
+bool TestRTree::Ascending(const IndexVector& indices) {
+  return std::adjacent_find(indices.cbegin(), indices.cend(),
+                            [] (quint32 a, quint32 b) {return a >= b;}) == indices.cend();
+}
+
+void TestRTree::testEmpty() {
+  KV::RTree tree;
+  QVERIFY(tree.isEmpty());
+  QVERIFY(tree.intersecting(QRectF(0, 0, 1, 1)).isEmpty());
+
+  tree.build(RectVector());
+  QVERIFY(tree.isEmpty());
+  QVERIFY(tree.intersecting(QRectF(0, 0, 1, 1)).isEmpty());
+}
+
+void TestRTree::testTouching() {
+  // unit grid: neighbours share edges and corners
+  RectVector items;
+  for (int y = 0; y < 40; y++) {
+    for (int x = 0; x < 40; x++) {
+      items.append(QRectF(x, y, 1, 1));
+    }
+  }
+
+  KV::RTree tree;
+  tree.build(items);
+  QCOMPARE(tree.size(), items.size());
+
+  const QVector<QRectF> boxes {
+    QRectF(10, 10, 1, 1), // exact cell, touches eight neighbours
+    QRectF(10, 10, 5, 3),
+    QRectF(15, 0, 0.5, 40), // column, touches the cells on the left
+    QRectF(-1, -1, 1, 1), // touches the corner cell only
+    QRectF(40, 0, 1, 40), // touches the right edge only
+    QRectF(20.5, 20.5, -3, -3), // not normalized
+    QRectF(0, 0, 40, 40),
+  };
+
+  for (const QRectF& box: boxes) {
+    const IndexVector found = tree.intersecting(box);
+    QCOMPARE(found, BruteForce(items, box));
+    QVERIFY(Ascending(found));
+  }
+
+  // touching edges do not intersect, as in QRectF::intersects
+  QCOMPARE(tree.intersecting(QRectF(10, 10, 1, 1)), IndexVector {10 * 40 + 10});
+  QVERIFY(tree.intersecting(QRectF(-1, -1, 1, 1)).isEmpty());
+  QVERIFY(tree.intersecting(QRectF(40, 0, 1, 40)).isEmpty());
+}
+
+void TestRTree::testRandom_data() {
+  QTest::addColumn<int>("count");
+  QTest::addColumn<uint>("seed");
+
+  QTest::newRow("one") << 1 << 1u;
+  QTest::newRow("one node") << 16 << 2u;
+  QTest::newRow("two levels") << 200 << 3u;
+  QTest::newRow("three levels") << 5000 << 4u;
+}
+
+void TestRTree::testRandom() {
+  QFETCH(int, count);
+  QFETCH(uint, seed);
+
+  std::mt19937 gen(seed);
+  // integer coordinates so that plenty of boxes share edges
+  std::uniform_int_distribution<int> pos(0, 100);
+  std::uniform_int_distribution<int> size(-5, 10);
+
+  auto randomBox = [&] () {
+    return QRectF(pos(gen), pos(gen), size(gen), size(gen));
+  };
+
+  RectVector items;
+  for (int i = 0; i < count; i++) {
+    items.append(randomBox());
+  }
+
+  KV::RTree tree;
+  tree.build(items);
+  QCOMPARE(tree.size(), count);
+
+  for (int i = 0; i < 500; i++) {
+    const QRectF box = randomBox();
+    const IndexVector found = tree.intersecting(box);
+    QCOMPARE(found, BruteForce(items, box));
+    QVERIFY(Ascending(found));
+  }
+
+  // query with each item to hit touching and identical boxes
+  for (const QRectF& box: items) {
+    QCOMPARE(tree.intersecting(box), BruteForce(items, box));
+  }
+}
+
+
+QTEST_APPLESS_MAIN(TestRTree)
+
+
+#include "test_rtree.moc"
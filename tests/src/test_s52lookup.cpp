@@ -0,0 +1,206 @@
+/* -*- coding: utf-8-unix -*-
+ *
+ * test_s52lookup.cpp
+ *
+ * Copyright (C) 2021 Jukka Sirkka
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtTest/QTest>
+#include <QPluginLoader>
+#include <QFileInfo>
+#include <QtPlugin>
+#include "s52presentation.h"
+#include "s52presentation_p.h"
+#include "chartfilereader.h"
+#include "conf_marinerparams.h"
+#include "types.h"
+
+Q_IMPORT_PLUGIN(CM93ReaderFactory)
+Q_IMPORT_PLUGIN(S57ReaderFactory)
+Q_IMPORT_PLUGIN(OsencReaderFactory)
+Q_IMPORT_PLUGIN(OesencReaderFactory)
+
+//
+// Compares S52::FindLookup with the lookup matching it replaced and
+// benchmarks both over the objects of a chart file. The chart is given in
+// the QUTENAV_TEST_CHART environment variable, e.g. an S57 .000 cell.
+//
+class TestS52Lookup: public QObject {
+
+  Q_OBJECT
+
+private slots:
+
+  void initTestCase();
+  void cleanupTestCase();
+
+  void testEquivalence_data();
+  void testEquivalence();
+
+  void benchmarkCompiled();
+  void benchmarkReference();
+
+private:
+
+  void setFilters(bool plainBoundaries, bool simplifiedSymbols);
+
+  // S52::FindLookup before the lookup tables were compiled
+  static S52::Lookup* ReferenceLookup(const S57::Object* obj);
+
+  S57::ObjectVector m_objects;
+  // settings at the start, restored in cleanupTestCase if captured
+  bool m_filtersCaptured = false;
+  bool m_plainBoundaries = false;
+  bool m_simplifiedSymbols = false;
+};
+
+S52::Lookup* TestS52Lookup::ReferenceLookup(const S57::Object* obj) {
+  const quint32 code = obj->classCode();
+  const Private::Presentation* p = Private::Presentation::instance();
+  const S52::Lookup::Type t = p->typeFilter(obj);
+
+  using LookupVector = QVector<S52::Lookup*>;
+
+  // ordered by attribute count and rcid
+  const LookupVector lups = p->lookupTable[t][code];
+
+  for (S52::Lookup* lup: lups) {
+    if (lup->attributes().isEmpty()) {
+      return lup;
+    }
+    bool match = true;
+    for (auto it = lup->attributes().constBegin(); it != lup->attributes().constEnd(); ++it) {
+      if (!obj->attributes().contains(it.key())) {
+        match = false;
+        break;
+      }
+      if (!obj->attributes()[it.key()].matches(it.value())) {
+        match = false;
+        break;
+      }
+    }
+    if (match) {
+      return lup;
+    }
+  }
+  // symbology for unknowns
+  return p->lookupTable[t][p->names["######"]][0];
+}
+
+void TestS52Lookup::setFilters(bool plainBoundaries, bool simplifiedSymbols) {
+  Conf::MarinerParams::setPlainBoundaries(plainBoundaries);
+  Conf::MarinerParams::setSimplifiedSymbols(simplifiedSymbols);
+}
+
+void TestS52Lookup::initTestCase() {
+  const QString path = QString::fromLocal8Bit(qgetenv("QUTENAV_TEST_CHART"));
+  if (path.isEmpty()) {
+    QSKIP("Set QUTENAV_TEST_CHART to a chart file to run the lookup tests");
+  }
+  QVERIFY2(QFileInfo(path).isFile(), qPrintable(path + " is not a file"));
+
+  S52::InitPresentation();
+  m_plainBoundaries = Conf::MarinerParams::PlainBoundaries();
+  m_simplifiedSymbols = Conf::MarinerParams::SimplifiedSymbols();
+  m_filtersCaptured = true;
+
+  const QStringList folders {QFileInfo(path).absolutePath()};
+
+  const auto& staticFactories = QPluginLoader::staticInstances();
+  for (auto plugin: staticFactories) {
+    auto factory = qobject_cast<ChartFileReaderFactory*>(plugin);
+    if (!factory) continue;
+    QScopedPointer<ChartFileReader> reader(factory->loadReader(folders));
+    if (reader.isNull()) continue;
+
+    GeoProjection* proj;
+    try {
+      proj = reader->configuredProjection(path);
+    } catch (ChartFileError&) {
+      continue;
+    }
+
+    GL::VertexVector vertices;
+    GL::IndexVector indices;
+    try {
+      reader->readChart(vertices, indices, m_objects, path, proj);
+    } catch (ChartFileError& e) {
+      delete proj;
+      QFAIL(qPrintable(e.msg()));
+    }
+    delete proj;
+    break;
+  }
+
+  QVERIFY2(!m_objects.isEmpty(), qPrintable("No objects read from " + path));
+}
+
+void TestS52Lookup::cleanupTestCase() {
+  qDeleteAll(m_objects);
+  m_objects.clear();
+  if (m_filtersCaptured) {
+    setFilters(m_plainBoundaries, m_simplifiedSymbols);
+  }
+}
+
+void TestS52Lookup::testEquivalence_data() {
+  QTest::addColumn<bool>("plainBoundaries");
+  QTest::addColumn<bool>("simplifiedSymbols");
+
+  QTest::newRow("symbolized, paper chart") << false << false;
+  QTest::newRow("plain, simplified") << true << true;
+}
+
+void TestS52Lookup::testEquivalence() {
+  QFETCH(bool, plainBoundaries);
+  QFETCH(bool, simplifiedSymbols);
+
+  setFilters(plainBoundaries, simplifiedSymbols);
+
+  for (const S57::Object* obj: m_objects) {
+    const S52::Lookup* expected = ReferenceLookup(obj);
+    const S52::Lookup* lup = S52::FindLookup(obj);
+    QVERIFY2(lup == expected,
+             qPrintable(QString("%1: lookup %2, expected %3")
+                        .arg(obj->name())
+                        .arg(lup->rcid())
+                        .arg(expected->rcid())));
+  }
+}
+
+void TestS52Lookup::benchmarkCompiled() {
+  setFilters(m_plainBoundaries, m_simplifiedSymbols);
+  QBENCHMARK {
+    for (const S57::Object* obj: m_objects) {
+      S52::FindLookup(obj);
+    }
+  }
+}
+
+void TestS52Lookup::benchmarkReference() {
+  setFilters(m_plainBoundaries, m_simplifiedSymbols);
+  QBENCHMARK {
+    for (const S57::Object* obj: m_objects) {
+      ReferenceLookup(obj);
+    }
+  }
+}
+
+
+QTEST_MAIN(TestS52Lookup)
+
+
+#include "test_s52lookup.moc"